@@ -0,0 +1,514 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Benchmark of the atlas generation stages over sweeps of row height, SDF size,
+// glyph count and CPU thread count. Every configuration runs the GL pipeline
+// stage by stage, then the font loading and the CPU reference renderer with each thread count,
+// comparing its output with the GL atlas. Parabolic segment fragments and the share of them
+// rejected early by the segment hull bound are counted as well. Glyph decoding is timed twice,
+// with the sizes validated once per glyph (the default) and with every read checked.
+// Results go to CSV and JSON.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "../src/args_parser.h"
+#include "../src/font.h"
+#include "../src/sdf_atlas.h"
+#include "../src/sdf_gl.h"
+#include "../src/sdf_cpu.h"
+#include "../src/sdf_compute.h"
+#include "../src/sdf_edt.h"
+#include "../src/glyph_painter.h"
+#include "../src/image_writer.h"
+#include "../src/stats.h"
+
+
+struct BenchFont {
+    std::string label;
+    std::string filename;
+    std::string ranges;
+    std::vector<uint8_t>  data;
+    std::vector<uint32_t> codepoints;       // Requested code points present in the font
+};
+
+struct BenchResult {
+    std::string font;
+    int    glyphs = 0, row_height = 0, sdf_size = 0, threads = 0;
+    int    tex_width = 0, tex_height = 0;
+    double load_ms = 0, cmap_ms = 0, decode_ms = 0, decode_checked_ms = 0, packing_ms = 0, tessellation_ms = 0;
+    double render_ms = 0, readback_ms = 0, png_ms = 0, cpu_ms = 0, compute_ms = 0;
+    double gl_glyphs_per_s = 0, cpu_glyphs_per_s = 0;
+    double mean_err_px = 0, max_err_px = 0, sign_mismatch = 0;
+    double line_frags = 0, hull_skip = 0;
+    double edt_ms = 0, edt_mean_err_px = 0, edt_max_err_px = 0;
+};
+
+ArgsParser             args;
+SdfGl                  sdf_gl;
+SdfCompute             sdf_compute;
+bool                   compute_ready = false;     // Compute backend column is 0 without GL 4.3
+std::vector<BenchFont> fonts;
+std::vector<int>       row_heights { 32, 64 };
+std::vector<int>       sdf_sizes   { 4, 8 };
+std::vector<int>       glyph_counts { 64, 0 };
+std::vector<int>       thread_counts { 1, 0 };
+int                    tex_width = 1024;
+int                    repeats = 3;
+std::string            res_filename = "bench";
+
+
+std::string help = R"(Atlas generation benchmark.
+Usage: sdf_atlas_bench [options]
+Options:
+    -h                      this help
+    -font 'label' 'file' 'ranges'
+                            font to benchmark with unicode ranges (see sdf_atlas -ur),
+                            can be repeated, default is the bundled Latin and Cyrillic font
+    -rh 'list'              row heights, default 32,64
+    -bs 'list'              SDF sizes, default 4,8
+    -gc 'list'              glyph counts, 0 - all glyphs in ranges, default 64,0
+    -j 'list'               glyph decoding and CPU reference thread counts, 0 - number of cores, default 1,0
+    -tw 'size'              atlas width, default 1024
+    -n 'count'              repetitions, the fastest is reported, default 3
+    -o 'filename'           output file name without extension, default bench
+)";
+
+void show_help( ArgsParser* ) {
+    std::cout << help;
+    exit( 0 );
+}
+
+std::vector<int> parse_list( const std::string& str ) {
+    std::vector<int> res;
+    std::stringstream ss( str );
+    std::string item;
+    while ( std::getline( ss, item, ',' ) ) {
+        char *end = nullptr;
+        long v = strtol( item.c_str(), &end, 0 );
+        if ( end == item.c_str() || *end != 0 || v < 0 ) {
+            std::cerr << "Error reading list '" << str << "'" << std::endl;
+            exit( 1 );
+        }
+        res.push_back( v );
+    }
+    return res;
+}
+
+void read_font( ArgsParser *ap ) {
+    BenchFont bf;
+    bf.label    = ap->word();
+    bf.filename = ap->word();
+    bf.ranges   = ap->word();
+    fonts.push_back( bf );
+}
+
+void read_row_heights( ArgsParser *ap )   { row_heights   = parse_list( ap->word() ); }
+void read_sdf_sizes( ArgsParser *ap )     { sdf_sizes     = parse_list( ap->word() ); }
+void read_glyph_counts( ArgsParser *ap )  { glyph_counts  = parse_list( ap->word() ); }
+void read_thread_counts( ArgsParser *ap ) { thread_counts = parse_list( ap->word() ); }
+void read_tex_width( ArgsParser *ap )     { tex_width     = parse_list( ap->word() ).at( 0 ); }
+void read_repeats( ArgsParser *ap )       { repeats       = std::max( 1, parse_list( ap->word() ).at( 0 ) ); }
+void read_res_filename( ArgsParser *ap )  { res_filename  = ap->word(); }
+
+
+bool load_font( BenchFont& bf ) {
+    std::ifstream f( bf.filename, std::ios::binary );
+    if ( !f ) return false;
+    bf.data.assign( std::istreambuf_iterator<char>( f ), std::istreambuf_iterator<char>() );
+
+    Font font;
+    if ( !font.load_ttf_mem( bf.data.data(), bf.data.size() ) ) return false;
+
+    std::stringstream ss( bf.ranges );
+    std::string range;
+    while ( std::getline( ss, range, ',' ) ) {
+        size_t colon = range.find( ':' );
+        uint32_t start = strtoul( range.c_str(), nullptr, 0 );
+        uint32_t end   = colon == std::string::npos ? start : strtoul( range.c_str() + colon + 1, nullptr, 0 );
+        for ( uint32_t cp = start; cp <= end; ++cp ) {
+            if ( font.glyph_idx( cp ) > 0 ) bf.codepoints.push_back( cp );
+        }
+    }
+    return true;
+}
+
+double elapsed_ms( int64_t start_us ) {
+    return ( stats_time_us() - start_us ) * 1e-3;
+}
+
+double span_ms( const char *name ) {
+    for ( const Stats::Span& s : stats.spans ) {
+        if ( s.name == std::string( name ) ) return s.duration_us * 1e-3;
+    }
+    return 0.0;
+}
+
+// Counts the fragments of the parabolic segments in the SDF line pass and the fraction of them
+// rejected by the segment hull bound of line_fsh before the root solve. Rects are rasterized at texel
+// centers, parabola space coordinates are interpolated as in the shader.
+void line_fragments( const GlyphPainter& gp, BenchResult& r ) {
+    size_t frags = 0, skipped = 0;
+    const std::vector<SdfVertex>& vs = gp.lp.vertices;
+    for ( size_t i = 0; i + 6 <= vs.size(); i += 6 ) {
+        const SdfVertex& v0 = vs[i];
+        const SdfVertex& v1 = vs[i + 1];
+        const SdfVertex& v2 = vs[i + 2];
+        if ( v0.scale == 0.0f ) continue;   // Interior quad
+
+        float w = v1.pos.x - v0.pos.x, h = v2.pos.y - v1.pos.y;
+        if ( w <= 0.0f || h <= 0.0f ) continue;
+        F2 dpx = ( v1.par - v0.par ) / w;
+        F2 dpy = ( v2.par - v1.par ) / h;
+        float dist_scale = v0.scale / v0.line_width;
+        float lx = v0.limits.x, ly = v0.limits.y;
+        float ymin = lx > 0.0f ? lx * lx : ly < 0.0f ? ly * ly : 0.0f;
+        float ymax = std::max( lx * lx, ly * ly );
+
+        int x0 = (int) ceilf( v0.pos.x - 0.5f ), x1 = (int) ceilf( v2.pos.x - 0.5f );
+        int y0 = (int) ceilf( v0.pos.y - 0.5f ), y1 = (int) ceilf( v2.pos.y - 0.5f );
+        for ( int y = y0; y < y1; ++y ) {
+            for ( int x = x0; x < x1; ++x ) {
+                F2 par = v0.par + dpx * ( x + 0.5f - v0.pos.x ) + dpy * ( y + 0.5f - v0.pos.y );
+                float bx = std::max( 0.0f, std::max( lx - par.x, par.x - ly ) );
+                float by = std::max( 0.0f, std::max( ymin - par.y, par.y - ymax ) );
+                if ( sqrtf( bx * bx + by * by ) * dist_scale >= 1.0f ) skipped++;
+                frags++;
+            }
+        }
+    }
+    r.line_frags = frags;
+    r.hull_skip  = frags ? (double) skipped / frags : 0.0;
+}
+
+// Runs the GL pipeline for one configuration, returns the atlas read back (bottom to top)
+void bench_gl( const BenchFont& bf, int glyph_count, int row_height, int sdf_size,
+               SdfAtlas& atlas, Font& font, std::vector<uint8_t>& image, BenchResult& r ) {
+    r = BenchResult {};
+    r.font            = bf.label;
+    r.row_height      = row_height;
+    r.sdf_size        = sdf_size;
+    r.packing_ms      = r.tessellation_ms = 1e30;
+    r.render_ms       = r.readback_ms = r.png_ms = r.compute_ms = 1e30;
+
+    size_t count = glyph_count > 0 ? std::min<size_t>( glyph_count, bf.codepoints.size() ) : bf.codepoints.size();
+
+    for ( int irep = 0; irep < repeats; ++irep ) {
+        font = Font {};
+        font.pixel_height = row_height;
+        font.load_ttf_mem( bf.data.data(), bf.data.size() );
+
+        int64_t t = stats_time_us();
+        atlas.init( &font, tex_width, row_height, sdf_size );
+        for ( size_t i = 0; i < count; ++i ) atlas.allocate_codepoint( bf.codepoints[i] );
+        r.packing_ms = std::min( r.packing_ms, elapsed_ms( t ) );
+
+        GlyphPainter gp;
+        t = stats_time_us();
+        atlas.draw_glyphs( gp );
+        r.tessellation_ms = std::min( r.tessellation_ms, elapsed_ms( t ) );
+        line_fragments( gp, r );
+
+        int height = atlas.max_height;
+        r.glyphs     = atlas.glyph_count;
+        r.tex_width  = tex_width;
+        r.tex_height = height;
+
+        GLuint rb[2], fbo;
+        glGenRenderbuffers( 2, rb );
+        glBindRenderbuffer( GL_RENDERBUFFER, rb[0] );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_R8, tex_width, height );
+        glBindRenderbuffer( GL_RENDERBUFFER, rb[1] );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_STENCIL, tex_width, height );
+        glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+        glGenFramebuffers( 1, &fbo );
+        glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rb[0] );
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rb[1] );
+        glFinish();
+
+        t = stats_time_us();
+        glViewport( 0, 0, tex_width, height );
+        glClearColor( 0.0, 0.0, 0.0, 0.0 );
+        glClear( GL_COLOR_BUFFER_BIT );
+        sdf_gl.render_sdf( F2( tex_width, height ), gp.fp.vertices, gp.lp.vertices, gp.lp.straight_vertices, gp.batches );
+        glFinish();
+        r.render_ms = std::min( r.render_ms, elapsed_ms( t ) );
+
+        t = stats_time_us();
+        image.resize( (size_t) tex_width * height );
+        glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+        glReadPixels( 0, 0, tex_width, height, GL_RED, GL_UNSIGNED_BYTE, image.data() );
+        r.readback_ms = std::min( r.readback_ms, elapsed_ms( t ) );
+
+        glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+        glDeleteFramebuffers( 1, &fbo );
+        glDeleteRenderbuffers( 2, rb );
+
+        t = stats_time_us();
+        ImageWriter writer;
+        writer.open( res_filename + "_atlas.png", ImageFormat::Png, tex_width, height, 1 );
+        for ( int y = height - 1; y >= 0; --y ) writer.write_row( image.data() + (size_t) y * tex_width );
+        writer.close();
+        r.png_ms = std::min( r.png_ms, elapsed_ms( t ) );
+
+        if ( compute_ready ) {
+            std::vector<float> distances;
+            t = stats_time_us();
+            sdf_compute.render( atlas, tex_width, height, distances );
+            r.compute_ms = std::min( r.compute_ms, elapsed_ms( t ) );
+        }
+    }
+    if ( !compute_ready ) r.compute_ms = 0.0;
+
+    r.gl_glyphs_per_s = r.glyphs / ( ( r.tessellation_ms + r.render_ms ) * 1e-3 );
+}
+
+// Font loading with the glyph decoding threads of the row, once with the record sizes
+// validated per glyph and once with every glyph read checked
+void bench_decode( const BenchFont& bf, int row_height, int threads, BenchResult& r ) {
+    r.threads = threads > 0 ? threads : std::max( 1u, std::thread::hardware_concurrency() );
+    r.load_ms = r.cmap_ms = r.decode_ms = r.decode_checked_ms = 1e30;
+
+    for ( int irep = 0; irep < repeats; ++irep ) {
+        Font font;
+        font.pixel_height = row_height;
+        font.threads = threads;
+        stats.spans.clear();
+        int64_t t = stats_time_us();
+        font.load_ttf_mem( bf.data.data(), bf.data.size() );
+        r.load_ms = std::min( r.load_ms, elapsed_ms( t ) );
+        r.cmap_ms = std::min( r.cmap_ms, span_ms( "cmap fill" ) );
+        r.decode_ms = std::min( r.decode_ms, span_ms( "glyph decode" ) );
+
+        Font checked;
+        checked.pixel_height = row_height;
+        checked.threads = threads;
+        checked.checked_reads = true;
+        stats.spans.clear();
+        checked.load_ttf_mem( bf.data.data(), bf.data.size() );
+        r.decode_checked_ms = std::min( r.decode_checked_ms, span_ms( "glyph decode" ) );
+    }
+}
+
+// CPU reference render and its difference from the GL atlas inside glyph rects
+void bench_cpu( const SdfAtlas& atlas, const std::vector<uint8_t>& image, int threads, BenchResult& r ) {
+    SdfCpu sdf_cpu;
+    sdf_cpu.threads = threads;
+
+    std::vector<float> ref;
+    r.cpu_ms = 1e30;
+    for ( int irep = 0; irep < repeats; ++irep ) {
+        int64_t t = stats_time_us();
+        sdf_cpu.render( atlas, r.tex_width, r.tex_height, ref );
+        r.cpu_ms = std::min( r.cpu_ms, elapsed_ms( t ) );
+    }
+    r.cpu_glyphs_per_s = r.glyphs / ( r.cpu_ms * 1e-3 );
+
+    // Normalized distance to pixels
+    double px_scale = 2.0 * r.sdf_size;
+    double err_sum  = 0.0;
+    size_t texels   = 0, mismatches = 0;
+    r.max_err_px = 0.0;
+
+    for ( const GlyphRect& gr : atlas.glyph_rects ) {
+        int x0 = std::max( 0, (int) ceilf( gr.x0 - 0.5f ) );
+        int x1 = std::min( r.tex_width, (int) ceilf( gr.x1 - 0.5f ) );
+        int y0 = std::max( 0, (int) ceilf( gr.y0 - 0.5f ) );
+        int y1 = std::min( r.tex_height, (int) ceilf( gr.y1 - 0.5f ) );
+        for ( int y = y0; y < y1; ++y ) {
+            for ( int x = x0; x < x1; ++x ) {
+                size_t i = (size_t) y * r.tex_width + x;
+                double gl  = image[i] / 255.0;
+                double err = fabs( gl - ref[i] ) * px_scale;
+                err_sum += err;
+                r.max_err_px = std::max( r.max_err_px, err );
+                if ( ( image[i] >= 128 ) != ( ref[i] >= 0.5f ) ) mismatches++;
+                texels++;
+            }
+        }
+    }
+    r.mean_err_px   = texels ? err_sum / texels : 0.0;
+    r.sign_mismatch = texels ? (double) mismatches / texels : 0.0;
+
+    // Distance transform backend against the same reference
+    SdfEdt sdf_edt;
+    sdf_edt.threads = threads;
+    std::vector<float> edt;
+    r.edt_ms = 1e30;
+    for ( int irep = 0; irep < repeats; ++irep ) {
+        int64_t t = stats_time_us();
+        sdf_edt.render( atlas, r.tex_width, r.tex_height, edt );
+        r.edt_ms = std::min( r.edt_ms, elapsed_ms( t ) );
+    }
+
+    err_sum = 0.0;
+    r.edt_max_err_px = 0.0;
+    for ( const GlyphRect& gr : atlas.glyph_rects ) {
+        int x0 = std::max( 0, (int) ceilf( gr.x0 - 0.5f ) );
+        int x1 = std::min( r.tex_width, (int) ceilf( gr.x1 - 0.5f ) );
+        int y0 = std::max( 0, (int) ceilf( gr.y0 - 0.5f ) );
+        int y1 = std::min( r.tex_height, (int) ceilf( gr.y1 - 0.5f ) );
+        for ( int y = y0; y < y1; ++y ) {
+            for ( int x = x0; x < x1; ++x ) {
+                size_t i = (size_t) y * r.tex_width + x;
+                double err = fabs( edt[i] - ref[i] ) * px_scale;
+                err_sum += err;
+                r.edt_max_err_px = std::max( r.edt_max_err_px, err );
+            }
+        }
+    }
+    r.edt_mean_err_px = texels ? err_sum / texels : 0.0;
+}
+
+
+static const char *csv_header =
+    "font,glyphs,row_height,sdf_size,threads,tex_width,tex_height,"
+    "load_ms,cmap_ms,decode_ms,decode_checked_ms,packing_ms,tessellation_ms,render_ms,readback_ms,png_ms,cpu_ms,compute_ms,"
+    "gl_glyphs_per_s,cpu_glyphs_per_s,mean_err_px,max_err_px,sign_mismatch,line_frags,hull_skip,"
+    "edt_ms,edt_mean_err_px,edt_max_err_px";
+
+std::string csv_row( const BenchResult& r ) {
+    char buf[512];
+    snprintf( buf, sizeof( buf ),
+              "%s,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.0f,%.0f,%.4f,%.4f,%.6f,%.0f,%.4f,%.3f,%.4f,%.4f",
+              r.font.c_str(), r.glyphs, r.row_height, r.sdf_size, r.threads, r.tex_width, r.tex_height,
+              r.load_ms, r.cmap_ms, r.decode_ms, r.decode_checked_ms, r.packing_ms, r.tessellation_ms,
+              r.render_ms, r.readback_ms, r.png_ms, r.cpu_ms, r.compute_ms,
+              r.gl_glyphs_per_s, r.cpu_glyphs_per_s, r.mean_err_px, r.max_err_px, r.sign_mismatch,
+              r.line_frags, r.hull_skip, r.edt_ms, r.edt_mean_err_px, r.edt_max_err_px );
+    return buf;
+}
+
+std::string json_row( const BenchResult& r ) {
+    // Same fields as the CSV, header names as keys
+    std::stringstream names( csv_header );
+    std::stringstream values( csv_row( r ) );
+    std::string name, value, res = "{ ";
+    bool first = true;
+    while ( std::getline( names, name, ',' ) && std::getline( values, value, ',' ) ) {
+        if ( !first ) res += ", ";
+        res += "\"" + name + "\": ";
+        res += name == "font" ? "\"" + value + "\"" : value;
+        first = false;
+    }
+    return res + " }";
+}
+
+
+
+int main( int argc, char* argv[] ) {
+    args.commands["-h"]    = show_help;
+    args.commands["-font"] = read_font;
+    args.commands["-rh"]   = read_row_heights;
+    args.commands["-bs"]   = read_sdf_sizes;
+    args.commands["-gc"]   = read_glyph_counts;
+    args.commands["-j"]    = read_thread_counts;
+    args.commands["-tw"]   = read_tex_width;
+    args.commands["-n"]    = read_repeats;
+    args.commands["-o"]    = read_res_filename;
+    if ( !args.run( argc, argv ) ) exit( 1 );
+
+    if ( fonts.empty() ) {
+        fonts.push_back( BenchFont { "latin", "bench/fonts/DejaVuSans-LatinCyrillic.ttf", "0x20:0x24F" } );
+        fonts.push_back( BenchFont { "cyrillic", "bench/fonts/DejaVuSans-LatinCyrillic.ttf", "0x400:0x4FF" } );
+    }
+
+    for ( BenchFont& bf : fonts ) {
+        if ( !load_font( bf ) ) {
+            std::cerr << "Error reading font '" << bf.filename << "'" << std::endl;
+            exit( 1 );
+        }
+    }
+
+    if ( !glfwInit() ) {
+        std::cerr << "GLFW initailization error" << std::endl;
+        exit( 1 );
+    }
+    glfwWindowHint( GLFW_VISIBLE, GL_FALSE );
+    GLFWwindow *window = glfwCreateWindow( 1, 1, "sdf_atlas_bench", nullptr, nullptr );
+    if ( !window ) {
+        std::cerr << "GLFW error creating window" << std::endl;
+        glfwTerminate();
+        exit( 1 );
+    }
+    glfwMakeContextCurrent( window );
+    GLenum err = glewInit();
+    if ( err != GLEW_OK ) {
+        std::cerr << "GLEW init error: " << glewGetErrorString( err ) << std::endl;
+        exit( 1 );
+    }
+    sdf_gl.init();
+    compute_ready = sdf_compute.init();
+
+    std::vector<BenchResult> results;
+    std::cout << csv_header << std::endl;
+
+    for ( const BenchFont& bf : fonts ) {
+        for ( int glyph_count : glyph_counts ) {
+            for ( int row_height : row_heights ) {
+                for ( int sdf_size : sdf_sizes ) {
+                    Font font;
+                    SdfAtlas atlas;
+                    std::vector<uint8_t> image;
+                    BenchResult gl_result;
+                    bench_gl( bf, glyph_count, row_height, sdf_size, atlas, font, image, gl_result );
+
+                    for ( int threads : thread_counts ) {
+                        BenchResult r = gl_result;
+                        bench_decode( bf, row_height, threads, r );
+                        bench_cpu( atlas, image, threads, r );
+                        results.push_back( r );
+                        std::cout << csv_row( r ) << std::endl;
+                    }
+                }
+            }
+        }
+    }
+
+    std::ofstream csv( res_filename + ".csv" );
+    csv << csv_header << "\n";
+    for ( const BenchResult& r : results ) csv << csv_row( r ) << "\n";
+
+    std::ofstream json( res_filename + ".json" );
+    json << "[\n";
+    for ( size_t i = 0; i < results.size(); ++i ) {
+        json << "  " << json_row( results[i] ) << ( i + 1 < results.size() ? ",\n" : "\n" );
+    }
+    json << "]\n";
+
+    if ( !csv || !json ) {
+        std::cerr << "Error writing results" << std::endl;
+        exit( 1 );
+    }
+
+    glfwTerminate();
+    return 0;
+}
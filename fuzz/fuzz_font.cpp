@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// libFuzzer target for the font parsers: sfnt, collections, WOFF and WOFF2 containers,
+// "glyf" and CFF outlines, cmap, kerning and variation tables. Every face is loaded at
+// its default instance and at a variable instance, display list ranges are checked.
+//
+// make fuzz builds bin/sdf_atlas_fuzz with clang, run it on a corpus directory seeded with fuzz/corpus,
+// with memory limits so that allocations sized by the font data are reported:
+//     bin/sdf_atlas_fuzz -max_len=262144 -rss_limit_mb=2048 -malloc_limit_mb=1024 corpus_dir fuzz/corpus
+// Built with -DFUZZ_STANDALONE by any compiler, it runs the inputs given on the command line instead,
+// with the address space limited to fuzz_standalone_memory_mb.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#ifdef FUZZ_STANDALONE
+#include <sys/resource.h>
+#endif
+
+#include "../src/font.h"
+#include "../src/stats.h"
+
+// Faces of a collection to load per input
+static const int fuzz_max_faces = 4;
+
+static void check_font( const Font& font ) {
+    for ( const Glyph& g : font.glyphs ) {
+        if ( g.command_start < 0 || g.command_count < 0 ||
+             (size_t) g.command_start + g.command_count > font.glyph_commands.size() ) abort();
+        if ( g.point_start < 0 || g.point_count < 0 ||
+             (size_t) g.point_start + g.point_count > font.glyph_points.size() ) abort();
+
+        // Display list points match the commands
+        int point_count = 0;
+        for ( int ic = g.command_start; ic < g.command_start + g.command_count; ++ic ) {
+            point_count += command_points( font.glyph_commands[ ic ] );
+        }
+        if ( point_count != g.point_count ) abort();
+
+        // Contours lie within the display list
+        if ( g.contour_start < 0 || g.contour_count < 0 ||
+             (size_t) g.contour_start + g.contour_count > font.glyph_contours.size() ) abort();
+        for ( int ic = g.contour_start; ic < g.contour_start + g.contour_count; ++ic ) {
+            const GlyphContour& c = font.glyph_contours[ ic ];
+            if ( c.command_start < g.command_start || c.command_count < 0 ||
+                 c.command_start + c.command_count > g.command_start + g.command_count ) abort();
+            if ( c.point_start < g.point_start || c.point_count < 0 ||
+                 c.point_start + c.point_count > g.point_start + g.point_count ) abort();
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size ) {
+    stats.spans.clear();
+
+    FontFile file;
+    if ( !file.init( data, size ) ) return 0;
+
+    int face_count = std::min( file.face_count(), fuzz_max_faces );
+    for ( int face_index = 0; face_index < face_count; ++face_index ) {
+        Font font;
+        font.threads = 1;
+        if ( !font.load_face( file, face_index ) ) continue;
+        check_font( font );
+        font.kern_advance( 'A', 'V' );
+        font.glyph_kern_advance( 1, 2 );
+
+        Font instance;
+        instance.threads = 1;
+        instance.variations.push_back( VarAxisValue { ttf_u32( (const uint8_t*) "wght" ), 700.0f } );
+        if ( instance.load_face( file, face_index ) ) check_font( instance );
+    }
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+// Address space limit, an input allocating past it aborts with std::bad_alloc
+static const rlim_t fuzz_standalone_memory_mb = 2048;
+
+int main( int argc, char **argv ) {
+    struct rlimit limit;
+    limit.rlim_cur = limit.rlim_max = fuzz_standalone_memory_mb << 20;
+    if ( setrlimit( RLIMIT_AS, &limit ) != 0 ) perror( "setrlimit" );
+
+    for ( int iarg = 1; iarg < argc; ++iarg ) {
+        FILE *f = fopen( argv[ iarg ], "rb" );
+        if ( !f ) continue;
+        std::vector<uint8_t> data;
+        uint8_t buf[ 4096 ];
+        size_t read;
+        while ( ( read = fread( buf, 1, sizeof( buf ), f ) ) > 0 ) data.insert( data.end(), buf, buf + read );
+        fclose( f );
+        LLVMFuzzerTestOneInput( data.data(), data.size() );
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "atlas_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+
+void AtlasCache::add( const void *data, size_t size ) {
+    const uint8_t *p = (const uint8_t*) data;
+    for ( size_t i = 0; i < size; ++i ) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;                     // FNV-1a prime
+    }
+}
+
+void AtlasCache::add( const std::string& str ) {
+    // Length first, so that consecutive strings can't run into each other
+    add( (int64_t) str.size() );
+    add( str.data(), str.size() );
+}
+
+void AtlasCache::add( int64_t value ) {
+    uint8_t bytes[8];
+    for ( int i = 0; i < 8; ++i ) bytes[i] = ( (uint64_t) value >> ( i * 8 ) ) & 0xff;
+    add( bytes, 8 );
+}
+
+bool AtlasCache::add_file( const std::string& filename ) {
+    FILE *f = fopen( filename.c_str(), "rb" );
+    if ( !f ) return false;
+    uint8_t buf[65536];
+    size_t  total = 0;
+    size_t  n;
+    while ( ( n = fread( buf, 1, sizeof( buf ), f ) ) > 0 ) {
+        add( buf, n );
+        total += n;
+    }
+    bool res = !ferror( f );
+    fclose( f );
+    add( (int64_t) total );
+    return res;
+}
+
+std::string AtlasCache::key() const {
+    char buf[17];
+    snprintf( buf, sizeof( buf ), "%016llx", (unsigned long long) hash );
+    return buf;
+}
+
+
+
+static bool file_exists( const std::string& filename ) {
+    struct stat st;
+    return stat( filename.c_str(), &st ) == 0;
+}
+
+static bool make_dir( const std::string& dir ) {
+    if ( file_exists( dir ) ) return true;
+#ifdef _WIN32
+    return _mkdir( dir.c_str() ) == 0;
+#else
+    return mkdir( dir.c_str(), 0755 ) == 0;
+#endif
+}
+
+static bool copy_file( const std::string& from, const std::string& to ) {
+    FILE *src = fopen( from.c_str(), "rb" );
+    if ( !src ) return false;
+    FILE *dst = fopen( to.c_str(), "wb" );
+    if ( !dst ) {
+        fclose( src );
+        return false;
+    }
+
+    bool res = true;
+    uint8_t buf[65536];
+    size_t  n;
+    while ( res && ( n = fread( buf, 1, sizeof( buf ), src ) ) > 0 ) {
+        res = fwrite( buf, 1, n, dst ) == n;
+    }
+    res = res && !ferror( src );
+    fclose( src );
+    res = ( fclose( dst ) == 0 ) && res;
+    return res;
+}
+
+static bool link_file( const std::string& from, const std::string& to ) {
+    // Output may be a link to another cache entry, writing into it would change that entry
+    remove( to.c_str() );
+#ifdef _WIN32
+    if ( CreateHardLinkA( to.c_str(), from.c_str(), nullptr ) ) return true;
+#else
+    if ( link( from.c_str(), to.c_str() ) == 0 ) return true;
+#endif
+    return copy_file( from, to );
+}
+
+static void touch_file( const std::string& filename ) {
+    utime( filename.c_str(), nullptr );
+}
+
+struct CacheFile {
+    std::string name;
+    uint64_t    size;
+    time_t      mtime;
+};
+
+static std::vector<CacheFile> list_dir( const std::string& dir ) {
+    std::vector<CacheFile> res;
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA( ( dir + "\\*" ).c_str(), &fd );
+    if ( h == INVALID_HANDLE_VALUE ) return res;
+    do {
+        if ( fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) continue;
+        struct stat st;
+        if ( stat( ( dir + "/" + fd.cFileName ).c_str(), &st ) != 0 ) continue;
+        res.push_back( CacheFile { fd.cFileName, (uint64_t) st.st_size, st.st_mtime } );
+    } while ( FindNextFileA( h, &fd ) );
+    FindClose( h );
+#else
+    DIR *d = opendir( dir.c_str() );
+    if ( !d ) return res;
+    while ( dirent *e = readdir( d ) ) {
+        struct stat st;
+        if ( stat( ( dir + "/" + e->d_name ).c_str(), &st ) != 0 || !S_ISREG( st.st_mode ) ) continue;
+        res.push_back( CacheFile { e->d_name, (uint64_t) st.st_size, st.st_mtime } );
+    }
+    closedir( d );
+#endif
+    return res;
+}
+
+
+
+bool AtlasCache::fetch( const std::string& res_filename, const std::vector<std::string>& extensions ) {
+    std::string base = dir + "/" + key();
+    for ( const std::string& ext : extensions ) {
+        if ( !file_exists( base + ext ) ) return false;
+    }
+    for ( const std::string& ext : extensions ) {
+        if ( !link_file( base + ext, res_filename + ext ) ) return false;
+        touch_file( base + ext );
+    }
+    return true;
+}
+
+bool AtlasCache::store( const std::string& res_filename, const std::vector<std::string>& extensions ) {
+    if ( !make_dir( dir ) ) return false;
+
+    std::string base = dir + "/" + key();
+    for ( const std::string& ext : extensions ) {
+        // Copying under a temporary name, so that concurrent runs never see a partial file
+        std::string tmp = base + ext + ".tmp";
+        if ( !copy_file( res_filename + ext, tmp ) ) {
+            remove( tmp.c_str() );
+            return false;
+        }
+        remove( ( base + ext ).c_str() );
+        if ( rename( tmp.c_str(), ( base + ext ).c_str() ) != 0 ) {
+            remove( tmp.c_str() );
+            return false;
+        }
+    }
+
+    evict();
+    return true;
+}
+
+void AtlasCache::evict() {
+    struct Entry {
+        uint64_t size  = 0;
+        time_t   mtime = 0;
+        std::vector<std::string> files;
+    };
+
+    // Entry files share the key, the part of the name before the first dot
+    std::map<std::string, Entry> entries;
+    uint64_t total = 0;
+    for ( const CacheFile& cf : list_dir( dir ) ) {
+        Entry& e = entries[ cf.name.substr( 0, cf.name.find( '.' ) ) ];
+        e.size  += cf.size;
+        e.mtime  = std::max( e.mtime, cf.mtime );
+        e.files.push_back( cf.name );
+        total   += cf.size;
+    }
+    if ( total <= max_size ) return;
+
+    std::vector<const Entry*> lru;
+    for ( const auto& e : entries ) lru.push_back( &e.second );
+    std::sort( lru.begin(), lru.end(), []( const Entry *a, const Entry *b ) { return a->mtime < b->mtime; } );
+
+    for ( const Entry *e : lru ) {
+        if ( total <= max_size ) break;
+        for ( const std::string& f : e->files ) remove( ( dir + "/" + f ).c_str() );
+        total -= e->size;
+    }
+}
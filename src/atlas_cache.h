@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Content-addressed on-disk cache of generated atlases.
+// The key is a hash of everything the output depends on: font bytes, requested
+// code points, atlas parameters, backend, tool version and the executable itself. An entry is a set of
+// files named <key><extension> in the cache directory. Hits are hardlinked
+// (copied if linking fails) to the output names, least recently used entries
+// are evicted once the directory exceeds max_size.
+
+struct AtlasCache {
+    std::string dir;
+    uint64_t    max_size = 256ull << 20;
+    uint64_t    hash     = 0xcbf29ce484222325ull;     // FNV-1a offset basis
+
+    bool enabled() const { return !dir.empty(); }
+
+    void add( const void *data, size_t size );
+    void add( const std::string& str );
+    void add( int64_t value );
+    bool add_file( const std::string& filename );
+
+    std::string key() const;
+
+    // Links the cached files to res_filename + extension, false if any of them is missing
+    bool fetch( const std::string& res_filename, const std::vector<std::string>& extensions );
+
+    // Copies res_filename + extension files into the cache and evicts old entries
+    bool store( const std::string& res_filename, const std::vector<std::string>& extensions );
+
+    void evict();
+};
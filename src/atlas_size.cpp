@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "atlas_size.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+static int floor_power_of_two( int v ) {
+    int p = 1;
+    while ( p <= v / 2 ) p *= 2;
+    return p;
+}
+
+static int ceil_power_of_two( int v ) {
+    int p = 1;
+    while ( p < v ) p *= 2;
+    return p;
+}
+
+void AtlasSizeSearch::init( const Font *font, int sdf_size ) {
+    this->sdf_size = sdf_size;
+    font_height = font->ascent - font->descent;
+    glyph_widths.clear();
+}
+
+void AtlasSizeSearch::add_codepoint( const Font *font, uint32_t codepoint ) {
+    int glyph_idx = font->glyph_idx( codepoint );
+    if ( glyph_idx == -1 ) return;
+    if ( glyph_idx == 0 ) return;
+    const Glyph& g = font->glyphs[ glyph_idx ];
+    if ( g.command_count <= 2 ) return;
+    glyph_widths.push_back( g.max.x - g.min.x );
+}
+
+int AtlasSizeSearch::row_count( int tex_width, int row_height, int max_rows ) const {
+    // Same float arithmetic as the packer, a different rounding would move glyphs between rows
+    float scale = (float) row_height / font_height;
+    float width = tex_width;
+    float posx = 0.0f;
+    int rows = 1;
+    for ( float gw : glyph_widths ) {
+        float rect_width = gw * scale + sdf_size * 2.0f;
+        if ( ( posx + rect_width ) > width ) {
+            posx = 0.0f;
+            if ( ++rows > max_rows ) return rows;
+        }
+        posx = ceil( posx + rect_width );
+    }
+    return rows;
+}
+
+bool AtlasSizeSearch::fits( int row_height ) const {
+    // The largest texture of the rule packs into the fewest rows
+    int width = max_width, height = max_height;
+    if ( rule == AtlasSizeRule::Square || rule == AtlasSizeRule::SquarePowerOfTwo ) {
+        width = height = std::min( max_width, max_height );
+    }
+    if ( rule == AtlasSizeRule::PowerOfTwo || rule == AtlasSizeRule::SquarePowerOfTwo ) {
+        width = floor_power_of_two( width );
+        height = floor_power_of_two( height );
+    }
+
+    float scale = (float) row_height / font_height;
+    for ( float gw : glyph_widths ) {
+        if ( gw * scale + sdf_size * 2.0f > width ) return false;
+    }
+    int max_rows = height / ( row_height + sdf_size * 2 );
+    return max_rows >= 1 && row_count( width, row_height, max_rows ) <= max_rows;
+}
+
+bool AtlasSizeSearch::fit( int row_height, AtlasSize& size ) const {
+    int row_and_border = row_height + sdf_size * 2;
+    float scale = (float) row_height / font_height;
+
+    // Narrower textures leave the widest glyph alone on a row, overflowing it
+    float widest = 0.0f, total_width = 0.0f;
+    for ( float gw : glyph_widths ) {
+        widest = std::max( widest, gw );
+        total_width += gw * scale + sdf_size * 2.0f;
+    }
+    int min_width = std::max( 1, (int) ceil( widest * scale + sdf_size * 2.0f ) );
+    int max_rows = max_height / row_and_border;
+    if ( min_width > max_width || max_rows < 1 ) return false;
+
+    // Smallest width in [lo, hi] packing into 'rows' rows, hi is known to fit
+    auto min_width_for_rows = [&]( int lo, int hi, int rows ) {
+        while ( lo < hi ) {
+            int mid = lo + ( hi - lo ) / 2;
+            if ( row_count( mid, row_height, rows ) <= rows ) hi = mid;
+            else lo = mid + 1;
+        }
+        return hi;
+    };
+
+    size = AtlasSize {};
+    size.row_height = row_height;
+
+    switch ( rule ) {
+    case AtlasSizeRule::Any: {
+        // Every row count gets its narrowest texture, more rows never need a wider one.
+        // The rows can't be narrower than their share of the total rect width.
+        int rows_at_max = row_count( max_width, row_height, max_rows );
+        if ( rows_at_max > max_rows ) return false;
+        int64_t best_area = INT64_MAX;
+        int width = max_width;
+        for ( int rows = rows_at_max; rows <= max_rows; ++rows ) {
+            int lo = std::max( min_width, std::min( width, (int) floor( total_width / rows ) ) );
+            width = min_width_for_rows( lo, width, rows );
+            int height = rows * row_and_border;
+            if ( (int64_t) width * height < best_area ) {
+                best_area = (int64_t) width * height;
+                size.width = width;
+                size.height = height;
+            }
+            if ( width == min_width ) break;
+        }
+        return true;
+    }
+    case AtlasSizeRule::PowerOfTwo: {
+        int64_t best_area = INT64_MAX;
+        for ( int width = ceil_power_of_two( min_width ); width <= max_width; width *= 2 ) {
+            int rows = row_count( width, row_height, max_rows );
+            if ( rows > max_rows ) continue;
+            int height = ceil_power_of_two( rows * row_and_border );
+            if ( height > max_height ) continue;
+            // Equal areas go to the squarer texture
+            int64_t area = (int64_t) width * height;
+            if ( area < best_area || ( area == best_area && std::max( width, height ) < std::max( size.width, size.height ) ) ) {
+                best_area = area;
+                size.width = width;
+                size.height = height;
+            }
+        }
+        return best_area != INT64_MAX;
+    }
+    case AtlasSizeRule::Square: {
+        int lo = std::max( min_width, row_and_border );
+        int hi = std::min( max_width, max_height );
+        auto fits = [&]( int side ) {
+            int rows = side / row_and_border;
+            return row_count( side, row_height, rows ) <= rows;
+        };
+        if ( lo > hi || !fits( hi ) ) return false;
+        while ( lo < hi ) {
+            int mid = lo + ( hi - lo ) / 2;
+            if ( fits( mid ) ) hi = mid;
+            else lo = mid + 1;
+        }
+        size.width = size.height = hi;
+        return true;
+    }
+    case AtlasSizeRule::SquarePowerOfTwo: {
+        int max_side = std::min( max_width, max_height );
+        for ( int side = ceil_power_of_two( std::max( min_width, row_and_border ) ); side <= max_side; side *= 2 ) {
+            int rows = side / row_and_border;
+            if ( row_count( side, row_height, rows ) <= rows ) {
+                size.width = size.height = side;
+                return true;
+            }
+        }
+        return false;
+    }
+    }
+    return false;
+}
+
+bool AtlasSizeSearch::fit_max_row_height( int max_row_height, AtlasSize& size ) const {
+    // Glyph rects grow with the row height, so do the rows and the texture
+    int lo = 5;
+    int hi = std::min( max_row_height, std::min( max_width, max_height ) - sdf_size * 2 );
+    if ( hi < lo || !fits( lo ) ) return false;
+    while ( lo < hi ) {
+        int mid = hi - ( hi - lo ) / 2;
+        if ( fits( mid ) ) lo = mid;
+        else hi = mid - 1;
+    }
+    return fit( lo, size );
+}
+
+const char* atlas_size_rule_name( AtlasSizeRule rule ) {
+    switch ( rule ) {
+    case AtlasSizeRule::Any:              return "any";
+    case AtlasSizeRule::PowerOfTwo:       return "pow2";
+    case AtlasSizeRule::Square:           return "square";
+    case AtlasSizeRule::SquarePowerOfTwo: return "square_pow2";
+    }
+    return "";
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "font.h"
+
+// Atlas size search.
+// Replays the shelf packing of SdfAtlas::allocate_codepoint over the glyph widths only,
+// without allocating rects or rendering. The row count of the packing doesn't grow with
+// the texture width, so the smallest texture is found by binary searches over the width.
+
+enum class AtlasSizeRule {
+    Any,                // Smallest area
+    PowerOfTwo,         // Smallest area with power-of-two sides
+    Square,             // Smallest square
+    SquarePowerOfTwo    // Smallest power-of-two square
+};
+
+struct AtlasSize {
+    int width = 0;
+    int height = 0;
+    int row_height = 0;
+};
+
+struct AtlasSizeSearch {
+    AtlasSizeRule rule = AtlasSizeRule::Any;
+    int   max_width  = 2048;
+    int   max_height = 2048;
+    int   sdf_size   = 0;
+
+    float font_height = 0.0f;
+    std::vector<float> glyph_widths;   // Outline widths of the packed glyphs in font units, in packing order
+
+    void init( const Font *font, int sdf_size );
+
+    // Same glyph selection as SdfAtlas::allocate_codepoint
+    void add_codepoint( const Font *font, uint32_t codepoint );
+
+    // Shelf rows of the glyphs packed into tex_width, stops counting past max_rows
+    int row_count( int tex_width, int row_height, int max_rows ) const;
+
+    // Whether the glyphs fit the largest texture of the rule at the row height, a single packing pass
+    bool fits( int row_height ) const;
+
+    // Smallest texture for the row height within the maximum size, false if the glyphs don't fit
+    bool fit( int row_height, AtlasSize& size ) const;
+
+    // Largest row height up to max_row_height the glyphs fit at, with its smallest texture
+    bool fit_max_row_height( int max_row_height, AtlasSize& size ) const;
+};
+
+const char* atlas_size_rule_name( AtlasSizeRule rule );
@@ -0,0 +1,711 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cff.h"
+#include "ttf_read.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+
+
+// Operand stack limit of CFF2 charstrings (maxstack default is 193 and is capped at 513),
+// CFF charstrings are limited to 48 operands
+static const int cff_max_stack = 513;
+
+// Subroutine nesting limit
+static const int cff_max_call_depth = 10;
+
+// Cubic curve is split into at most this number of quadratic curves
+static const int cff_max_quads = 32;
+
+
+const uint8_t* CffIndex::read( const uint8_t *p, const uint8_t *table_end, bool is_cff2 ) {
+    offsets.clear();
+    if ( p == nullptr || table_end - p < ( is_cff2 ? 5 : 3 ) ) return nullptr;
+    uint32_t count = is_cff2 ? ttf_u32( p ) : ttf_u16( p );
+    p += is_cff2 ? 4 : 2;
+    if ( count == 0 ) {
+        data = end = p;
+        return p;
+    }
+
+    int off_size = *p++;
+    if ( off_size < 1 || off_size > 4 ) return nullptr;
+    if ( (size_t) ( table_end - p ) / off_size < (size_t) count + 1 ) return nullptr;
+
+    offsets.resize( count + 1 );
+    for ( uint32_t i = 0; i <= count; ++i ) {
+        uint32_t off = 0;
+        for ( int b = 0; b < off_size; ++b ) off = ( off << 8 ) | *p++;
+        if ( off == 0 || ( i > 0 && off < offsets[ i - 1 ] ) ) return nullptr;
+        offsets[ i ] = off;
+    }
+
+    // Objects are checked against the table once, charstrings are read up to the object end
+    data = p - 1;
+    if ( offsets[ count ] - 1 > (size_t) ( table_end - p ) ) return nullptr;
+    end  = data + offsets[ count ];
+    return end;
+}
+
+
+// DICT data: operator -> operands, escaped operators are stored as 1200 + op
+
+typedef std::unordered_map<int, std::vector<double>> CffDict;
+
+static double read_real( const uint8_t *&p, const uint8_t *end ) {
+    std::string s;
+    bool done = false;
+    while ( !done && p < end ) {
+        uint8_t b = *p++;
+        for ( int nibble : { b >> 4, b & 0xf } ) {
+            if ( nibble <= 9 )        s += char( '0' + nibble );
+            else if ( nibble == 0xa ) s += '.';
+            else if ( nibble == 0xb ) s += 'E';
+            else if ( nibble == 0xc ) s += "E-";
+            else if ( nibble == 0xe ) s += '-';
+            else if ( nibble == 0xf ) { done = true; break; }
+        }
+    }
+    return strtod( s.c_str(), nullptr );
+}
+
+static void read_dict( const uint8_t *p, const uint8_t *end, CffDict& dict ) {
+    std::vector<double> operands;
+    while ( p < end ) {
+        uint8_t b0 = *p;
+        if ( b0 <= 21 || b0 == 23 || b0 == 24 ) {
+            // Operator
+            int op = b0;
+            p++;
+            if ( b0 == 12 && p < end ) op = 1200 + *p++;
+            dict[ op ] = operands;
+            operands.clear();
+        } else if ( b0 == 28 ) {
+            if ( end - p < 3 ) break;
+            operands.push_back( ttf_i16( p + 1 ) );
+            p += 3;
+        } else if ( b0 == 29 ) {
+            if ( end - p < 5 ) break;
+            operands.push_back( ttf_i32( p + 1 ) );
+            p += 5;
+        } else if ( b0 == 30 ) {
+            p++;
+            operands.push_back( read_real( p, end ) );
+        } else if ( b0 >= 32 && b0 <= 246 ) {
+            operands.push_back( b0 - 139 );
+            p++;
+        } else if ( b0 >= 247 && b0 <= 250 ) {
+            if ( end - p < 2 ) break;
+            operands.push_back( ( b0 - 247 ) * 256 + p[1] + 108 );
+            p += 2;
+        } else if ( b0 >= 251 && b0 <= 254 ) {
+            if ( end - p < 2 ) break;
+            operands.push_back( -( b0 - 251 ) * 256 - p[1] - 108 );
+            p += 2;
+        } else {
+            // Reserved
+            p++;
+        }
+    }
+}
+
+static bool dict_value( const CffDict& dict, int op, int idx, double *value ) {
+    auto it = dict.find( op );
+    if ( it == dict.end() || (int) it->second.size() <= idx ) return false;
+    *value = it->second[ idx ];
+    return true;
+}
+
+// Table offset from a DICT operand, out of range offsets give no data
+static TtfSpan dict_table_offset( TtfSpan table, double offset ) {
+    return offset >= 0.0 && offset <= table.size ? table.sub( (size_t) offset ) : TtfSpan();
+}
+
+// Local subroutines from the Private DICT referenced by a Top DICT or a Font DICT
+static bool read_private_subrs( TtfSpan table, const CffDict& dict, bool is_cff2, CffIndex& subrs ) {
+    double size, offset;
+    if ( !dict_value( dict, 18, 0, &size ) || !dict_value( dict, 18, 1, &offset ) ) return true;
+
+    TtfSpan priv = dict_table_offset( table, offset );
+    if ( !priv || size < 0.0 || size > priv.size ) return false;
+    CffDict priv_dict;
+    read_dict( priv.data, priv.data + (size_t) size, priv_dict );
+
+    double subrs_offset;
+    if ( !dict_value( priv_dict, 19, 0, &subrs_offset ) ) return true;
+    TtfSpan subrs_data = dict_table_offset( priv, subrs_offset );
+    return subrs.read( subrs_data.data, table.end(), is_cff2 ) != nullptr;
+}
+
+static bool read_fd_select( TtfSpan fds, int num_glyphs, std::vector<uint8_t>& fd_select ) {
+    fd_select.assign( num_glyphs, 0 );
+    uint8_t format = fds.u8( 0 );
+
+    if ( format == 0 ) {
+        if ( !fds.has( 1, num_glyphs ) ) return false;
+        for ( int iglyph = 0; iglyph < num_glyphs; ++iglyph ) fd_select[ iglyph ] = fds.data[ 1 + iglyph ];
+        return true;
+    }
+
+    if ( format == 3 || format == 4 ) {
+        bool     is_long = format == 4;
+        uint32_t nranges = is_long ? fds.u32( 1 ) : fds.u16( 1 );
+        int      rsize   = is_long ? 6 : 3;
+        // Ranges are followed by the sentinel glyph index
+        if ( !fds.has( is_long ? 5 : 3, (size_t) nranges * rsize + ( is_long ? 4 : 2 ) ) ) return false;
+        const uint8_t *range = fds.data + ( is_long ? 5 : 3 );
+
+        for ( uint32_t irange = 0; irange < nranges; ++irange, range += rsize ) {
+            uint32_t first = is_long ? ttf_u32( range ) : ttf_u16( range );
+            uint32_t last  = is_long ? ttf_u32( range + rsize ) : ttf_u16( range + rsize );
+            uint32_t fd    = is_long ? ttf_u16( range + 4 ) : range[2];
+            for ( uint32_t g = first; g < last && g < (uint32_t) num_glyphs; ++g ) fd_select[ g ] = fd;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool CffFont::init( TtfSpan table, bool is_cff2, int num_glyphs, const std::vector<float>& coords ) {
+    this->is_cff2 = is_cff2;
+    local_subrs.clear();
+    fd_select.clear();
+    vstore = ItemVariationStore {};
+
+    uint8_t major    = table.u8( 0 );
+    uint8_t hdr_size = table.u8( 2 );
+    if ( major != ( is_cff2 ? 2 : 1 ) ) return false;
+    const uint8_t *table_end = table.end();
+
+    CffDict top;
+    if ( is_cff2 ) {
+        uint16_t top_size = table.u16( 3 );
+        if ( !table.has( hdr_size, top_size ) ) return false;
+        read_dict( table.data + hdr_size, table.data + hdr_size + top_size, top );
+        if ( !global_subrs.read( table.data + hdr_size + top_size, table_end, true ) ) return false;
+    } else {
+        CffIndex names, top_dicts, strings;
+        const uint8_t *p = table.sub( hdr_size ).data;
+        if ( !( p = names.read( p, table_end, false ) ) ) return false;
+        if ( !( p = top_dicts.read( p, table_end, false ) ) ) return false;
+        if ( !( p = strings.read( p, table_end, false ) ) ) return false;
+        if ( !global_subrs.read( p, table_end, false ) ) return false;
+        if ( top_dicts.count() < 1 ) return false;
+
+        const uint8_t *top_end;
+        const uint8_t *top_data = top_dicts.object( 0, &top_end );
+        read_dict( top_data, top_end, top );
+
+        double charstring_type = 2;
+        dict_value( top, 1206, 0, &charstring_type );
+        if ( charstring_type != 2 ) return false;
+    }
+
+    double offset;
+    if ( !dict_value( top, 17, 0, &offset ) ) return false;
+    if ( !char_strings.read( dict_table_offset( table, offset ).data, table_end, is_cff2 ) ) return false;
+
+    if ( dict_value( top, 1236, 0, &offset ) ) {
+        // CID-keyed font or CFF2, local subroutines are stored per font dict
+        CffIndex fd_array;
+        if ( !fd_array.read( dict_table_offset( table, offset ).data, table_end, is_cff2 ) ) return false;
+        local_subrs.resize( fd_array.count() );
+        for ( int ifd = 0; ifd < fd_array.count(); ++ifd ) {
+            const uint8_t *fd_end;
+            const uint8_t *fd_data = fd_array.object( ifd, &fd_end );
+            CffDict font_dict;
+            read_dict( fd_data, fd_end, font_dict );
+            if ( !read_private_subrs( table, font_dict, is_cff2, local_subrs[ ifd ] ) ) return false;
+        }
+        if ( dict_value( top, 1237, 0, &offset ) ) {
+            if ( !read_fd_select( dict_table_offset( table, offset ), num_glyphs, fd_select ) ) return false;
+        }
+    } else {
+        local_subrs.resize( 1 );
+        if ( !read_private_subrs( table, top, is_cff2, local_subrs[ 0 ] ) ) return false;
+    }
+    if ( local_subrs.empty() ) local_subrs.resize( 1 );
+
+    // Item variation store follows the 16-bit length
+    if ( is_cff2 && dict_value( top, 24, 0, &offset ) ) {
+        if ( !vstore.init( dict_table_offset( table, offset + 2 ), coords ) ) return false;
+    }
+
+    return true;
+}
+
+
+
+// Contour builder: approximates cubic curves with quadratic ones and reverses contours
+
+struct CffPath {
+    std::vector<GlyphCommand>& commands;
+    std::vector<F2>&           points;
+    float tolerance;
+
+    // Current contour in charstring order
+    std::vector<GlyphCommand> contour;
+    std::vector<F2>           contour_points;
+    F2 pos     = F2{ 0.0f };
+
+    F2 min = F2{ 2e38f };
+    F2 max = F2{ -2e38f };
+
+    CffPath( std::vector<GlyphCommand>& commands, std::vector<F2>& points, float tolerance )
+        : commands( commands ), points( points ), tolerance( tolerance ) {}
+
+    void move_to( F2 p ) {
+        close();
+        contour.push_back( GlyphCommand::MoveTo );
+        contour_points.push_back( p );
+        pos = p;
+    }
+
+    void line_to( F2 p ) {
+        if ( contour.empty() ) move_to( pos );
+        if ( p.x == pos.x && p.y == pos.y ) return;
+        contour.push_back( GlyphCommand::LineTo );
+        contour_points.push_back( p );
+        pos = p;
+    }
+
+    void quad_to( F2 c, F2 p ) {
+        contour.push_back( GlyphCommand::BezTo );
+        contour_points.push_back( c );
+        contour_points.push_back( p );
+        pos = p;
+    }
+
+    // Single quadratic curve error is sqrt(3)/36 * |p3 - 3 p2 + 3 p1 - p0|,
+    // splitting the cubic into n parts reduces it n^3 times
+    void cubic_to( F2 p1, F2 p2, F2 p3 ) {
+        if ( contour.empty() ) move_to( pos );
+        F2 p0 = pos;
+        if ( p0.x == p1.x && p0.y == p1.y && p2.x == p3.x && p2.y == p3.y ) {
+            line_to( p3 );
+            return;
+        }
+
+        float err = 0.0481125f * length( p3 - 3.0f * p2 + 3.0f * p1 - p0 );
+        int   n = 1;
+        if ( err > tolerance ) {
+            n = (int) ceilf( cbrtf( err / tolerance ) );
+            n = std::min( n, cff_max_quads );
+        }
+
+        // Cubic derivative at t, divided by 3
+        auto tangent = [&]( float t ) {
+            float s = 1.0f - t;
+            return s * s * ( p1 - p0 ) + 2.0f * s * t * ( p2 - p1 ) + t * t * ( p3 - p2 );
+        };
+        auto point = [&]( float t ) {
+            float s = 1.0f - t;
+            return s * s * s * p0 + 3.0f * s * s * t * p1 + 3.0f * s * t * t * p2 + t * t * t * p3;
+        };
+
+        F2 q0 = p0;
+        for ( int i = 1; i <= n; ++i ) {
+            float t0 = (float) ( i - 1 ) / n;
+            float t1 = (float) i / n;
+            float dt = t1 - t0;
+            F2 q3 = i == n ? p3 : point( t1 );
+            F2 q1 = q0 + dt * tangent( t0 );
+            F2 q2 = q3 - dt * tangent( t1 );
+            quad_to( 0.25f * ( 3.0f * ( q1 + q2 ) - q0 - q3 ), q3 );
+            q0 = q3;
+        }
+    }
+
+    void add_bbox( F2 p ) {
+        min = ::min( min, p );
+        max = ::max( max, p );
+    }
+
+    void add_bbox( F2 p0, F2 c, F2 p1 ) {
+        add_bbox( p1 );
+        for ( int axis = 0; axis < 2; ++axis ) {
+            float denom = p0[ axis ] - 2.0f * c[ axis ] + p1[ axis ];
+            if ( denom == 0.0f ) continue;
+            float t = ( p0[ axis ] - c[ axis ] ) / denom;
+            if ( t <= 0.0f || t >= 1.0f ) continue;
+            float s = 1.0f - t;
+            add_bbox( s * s * p0 + 2.0f * s * t * c + t * t * p1 );
+        }
+    }
+
+    // Emits the contour in reverse order, closing line is implicit
+    void close() {
+        int n  = (int) contour.size() - 1;
+        int ip = (int) contour_points.size() - 1;   // End point of the command n
+        if ( n > 0 && contour[ n ] == GlyphCommand::LineTo ) {
+            F2 p = contour_points[ ip ];
+            if ( p.x == contour_points[0].x && p.y == contour_points[0].y ) {
+                n--;
+                ip--;
+            }
+        }
+        if ( n < 1 || ( n == 1 && contour[ 1 ] == GlyphCommand::LineTo ) ) {
+            contour.clear();
+            contour_points.clear();
+            return;
+        }
+
+        commands.push_back( GlyphCommand::MoveTo );
+        points.push_back( contour_points[ ip ] );
+        add_bbox( contour_points[ ip ] );
+
+        for ( int i = n; i >= 1; --i ) {
+            F2 from = contour_points[ ip ];
+            if ( contour[ i ] == GlyphCommand::BezTo ) {
+                F2 c  = contour_points[ ip - 1 ];
+                ip -= 2;
+                F2 to = contour_points[ ip ];
+                commands.push_back( GlyphCommand::BezTo );
+                points.push_back( c );
+                points.push_back( to );
+                add_bbox( from, c, to );
+            } else {
+                ip -= 1;
+                F2 to = contour_points[ ip ];
+                commands.push_back( GlyphCommand::LineTo );
+                points.push_back( to );
+                add_bbox( to );
+            }
+        }
+
+        commands.push_back( GlyphCommand::ClosePath );
+        contour.clear();
+        contour_points.clear();
+    }
+};
+
+
+
+// Type 2 charstring interpreter
+
+struct CffCharString {
+    const CffFont&  cff;
+    const CffIndex& local_subrs;
+    CffPath&        path;
+
+    float stack[ cff_max_stack ];
+    int   sp = 0;
+
+    int   nstems = 0;
+    bool  width_done = false;   // Optional advance width before the first stack clearing operator (CFF only)
+    bool  ended = false;
+    int   vsindex = 0;
+
+    CffCharString( const CffFont& cff, const CffIndex& local_subrs, CffPath& path )
+        : cff( cff ), local_subrs( local_subrs ), path( path ) {
+        width_done = cff.is_cff2;
+    }
+
+    void take_width( bool has_width ) {
+        if ( !width_done && has_width && sp > 0 ) {
+            std::copy( stack + 1, stack + sp, stack );
+            sp--;
+        }
+        width_done = true;
+    }
+
+    static int subr_bias( int count ) {
+        return count < 1240 ? 107 : count < 33900 ? 1131 : 32768;
+    }
+
+    F2 rel( float dx, float dy ) const { return path.pos + F2{ dx, dy }; }
+
+    void curve( float dx1, float dy1, float dx2, float dy2, float dx3, float dy3 ) {
+        F2 p1 = rel( dx1, dy1 );
+        F2 p2 = p1 + F2{ dx2, dy2 };
+        F2 p3 = p2 + F2{ dx3, dy3 };
+        path.cubic_to( p1, p2, p3 );
+    }
+
+    // Alternating horizontal and vertical tangent curves of hvcurveto and vhcurveto
+    void alternating_curves( bool horizontal ) {
+        for ( int i = 0; i + 4 <= sp; i += 4 ) {
+            float last = ( sp - i == 5 ) ? stack[ i + 4 ] : 0.0f;
+            if ( horizontal ) {
+                curve( stack[ i ], 0.0f, stack[ i + 1 ], stack[ i + 2 ], last, stack[ i + 3 ] );
+            } else {
+                curve( 0.0f, stack[ i ], stack[ i + 1 ], stack[ i + 2 ], stack[ i + 3 ], last );
+            }
+            horizontal = !horizontal;
+        }
+    }
+
+    bool run( const uint8_t *p, const uint8_t *end, int depth );
+};
+
+bool CffCharString::run( const uint8_t *p, const uint8_t *end, int depth ) {
+    if ( depth > cff_max_call_depth ) return false;
+
+    while ( p < end && !ended ) {
+        uint8_t b0 = *p++;
+
+        // Operands
+        if ( b0 == 28 || b0 >= 32 ) {
+            if ( sp >= cff_max_stack ) return false;
+            int operand_size = b0 == 28 ? 2 : b0 == 255 ? 4 : b0 >= 247 ? 1 : 0;
+            if ( end - p < operand_size ) return false;
+            if ( b0 == 28 ) {
+                stack[ sp++ ] = ttf_i16( p );
+                p += 2;
+            } else if ( b0 <= 246 ) {
+                stack[ sp++ ] = b0 - 139;
+            } else if ( b0 <= 250 ) {
+                stack[ sp++ ] = ( b0 - 247 ) * 256 + *p++ + 108;
+            } else if ( b0 <= 254 ) {
+                stack[ sp++ ] = -( b0 - 251 ) * 256 - *p++ - 108;
+            } else {
+                // 16.16 fixed
+                stack[ sp++ ] = ttf_i32( p ) / 65536.0f;
+                p += 4;
+            }
+            continue;
+        }
+
+        switch ( b0 ) {
+        case 1:     // hstem
+        case 3:     // vstem
+        case 18:    // hstemhm
+        case 23:    // vstemhm
+            take_width( sp & 1 );
+            nstems += sp / 2;
+            break;
+
+        case 19:    // hintmask
+        case 20:    // cntrmask
+            // Operands are implicit vstemhm
+            take_width( sp & 1 );
+            nstems += sp / 2;
+            if ( end - p < ( nstems + 7 ) / 8 ) return false;
+            p += ( nstems + 7 ) / 8;
+            break;
+
+        case 21:    // rmoveto
+            take_width( sp > 2 );
+            if ( sp < 2 ) return false;
+            path.move_to( rel( stack[ 0 ], stack[ 1 ] ) );
+            break;
+
+        case 22:    // hmoveto
+            take_width( sp > 1 );
+            if ( sp < 1 ) return false;
+            path.move_to( rel( stack[ 0 ], 0.0f ) );
+            break;
+
+        case 4:     // vmoveto
+            take_width( sp > 1 );
+            if ( sp < 1 ) return false;
+            path.move_to( rel( 0.0f, stack[ 0 ] ) );
+            break;
+
+        case 5:     // rlineto
+            for ( int i = 0; i + 2 <= sp; i += 2 ) path.line_to( rel( stack[ i ], stack[ i + 1 ] ) );
+            break;
+
+        case 6:     // hlineto
+        case 7: {   // vlineto
+            bool horizontal = b0 == 6;
+            for ( int i = 0; i < sp; ++i ) {
+                path.line_to( horizontal ? rel( stack[ i ], 0.0f ) : rel( 0.0f, stack[ i ] ) );
+                horizontal = !horizontal;
+            }
+            break;
+        }
+
+        case 8:     // rrcurveto
+            for ( int i = 0; i + 6 <= sp; i += 6 ) {
+                curve( stack[ i ], stack[ i + 1 ], stack[ i + 2 ], stack[ i + 3 ], stack[ i + 4 ], stack[ i + 5 ] );
+            }
+            break;
+
+        case 24: {  // rcurveline
+            int i = 0;
+            for ( ; i + 6 <= sp - 2; i += 6 ) {
+                curve( stack[ i ], stack[ i + 1 ], stack[ i + 2 ], stack[ i + 3 ], stack[ i + 4 ], stack[ i + 5 ] );
+            }
+            if ( i + 2 <= sp ) path.line_to( rel( stack[ i ], stack[ i + 1 ] ) );
+            break;
+        }
+
+        case 25: {  // rlinecurve
+            int i = 0;
+            for ( ; i + 2 <= sp - 6; i += 2 ) path.line_to( rel( stack[ i ], stack[ i + 1 ] ) );
+            if ( i + 6 <= sp ) {
+                curve( stack[ i ], stack[ i + 1 ], stack[ i + 2 ], stack[ i + 3 ], stack[ i + 4 ], stack[ i + 5 ] );
+            }
+            break;
+        }
+
+        case 26: {  // vvcurveto
+            int i = 0;
+            float dx1 = 0.0f;
+            if ( sp & 1 ) dx1 = stack[ i++ ];
+            for ( ; i + 4 <= sp; i += 4 ) {
+                curve( dx1, stack[ i ], stack[ i + 1 ], stack[ i + 2 ], 0.0f, stack[ i + 3 ] );
+                dx1 = 0.0f;
+            }
+            break;
+        }
+
+        case 27: {  // hhcurveto
+            int i = 0;
+            float dy1 = 0.0f;
+            if ( sp & 1 ) dy1 = stack[ i++ ];
+            for ( ; i + 4 <= sp; i += 4 ) {
+                curve( stack[ i ], dy1, stack[ i + 1 ], stack[ i + 2 ], stack[ i + 3 ], 0.0f );
+                dy1 = 0.0f;
+            }
+            break;
+        }
+
+        case 30:    // vhcurveto
+        case 31:    // hvcurveto
+            alternating_curves( b0 == 31 );
+            break;
+
+        case 10:    // callsubr
+        case 29: {  // callgsubr
+            if ( sp < 1 ) return false;
+            const CffIndex& subrs = b0 == 10 ? local_subrs : cff.global_subrs;
+            int isubr = (int) stack[ --sp ] + subr_bias( subrs.count() );
+            if ( isubr < 0 || isubr >= subrs.count() ) return false;
+            const uint8_t *subr_end;
+            const uint8_t *subr = subrs.object( isubr, &subr_end );
+            if ( !run( subr, subr_end, depth + 1 ) ) return false;
+            continue;   // Subroutine operands stay on the stack
+        }
+
+        case 11:    // return
+            return true;
+
+        case 14:    // endchar
+            // Four remaining operands are the deprecated seac accent composition, not supported
+            take_width( sp == 1 || sp == 5 );
+            path.close();
+            ended = true;
+            return true;
+
+        case 15:    // vsindex (CFF2)
+            if ( sp > 0 ) vsindex = (int) stack[ sp - 1 ];
+            break;
+
+        case 16: {  // blend (CFF2), n default values are followed by n * regions deltas
+            if ( sp < 1 ) return false;
+            int n = (int) stack[ --sp ];
+            bool has_vs = vsindex >= 0 && vsindex < (int) cff.vstore.scalars.size();
+            const float *scalars = has_vs ? cff.vstore.scalars[ vsindex ].data() : nullptr;
+            int regions = has_vs ? cff.vstore.scalars[ vsindex ].size() : 0;
+            if ( n < 0 || n * ( regions + 1 ) > sp ) return false;
+            float *values = stack + sp - n * ( regions + 1 );
+            const float *deltas = values + n;
+            for ( int i = 0; i < n; ++i ) {
+                for ( int r = 0; r < regions; ++r ) values[ i ] += deltas[ i * regions + r ] * scalars[ r ];
+            }
+            sp -= n * regions;
+            continue;   // Operands stay on the stack
+        }
+
+        case 12: {
+            uint8_t b1 = p < end ? *p++ : 0;
+            float *s = stack;
+            switch ( b1 ) {
+            case 35:    // flex
+                if ( sp < 13 ) return false;
+                curve( s[0], s[1], s[2], s[3], s[4], s[5] );
+                curve( s[6], s[7], s[8], s[9], s[10], s[11] );
+                break;
+            case 34:    // hflex
+                if ( sp < 7 ) return false;
+                curve( s[0], 0.0f, s[1], s[2], s[3], 0.0f );
+                curve( s[4], 0.0f, s[5], -s[2], s[6], 0.0f );
+                break;
+            case 36:    // hflex1
+                if ( sp < 9 ) return false;
+                curve( s[0], s[1], s[2], s[3], s[4], 0.0f );
+                curve( s[5], 0.0f, s[6], s[7], s[8], -( s[1] + s[3] + s[7] ) );
+                break;
+            case 37: {  // flex1
+                if ( sp < 11 ) return false;
+                float dx = s[0] + s[2] + s[4] + s[6] + s[8];
+                float dy = s[1] + s[3] + s[5] + s[7] + s[9];
+                bool  horizontal = fabsf( dx ) > fabsf( dy );
+                curve( s[0], s[1], s[2], s[3], s[4], s[5] );
+                curve( s[6], s[7], s[8], s[9], horizontal ? s[10] : -dx, horizontal ? -dy : s[10] );
+                break;
+            }
+            default:
+                // Deprecated arithmetic and storage operators are not supported
+                break;
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        sp = 0;
+    }
+
+    return true;
+}
+
+bool CffFont::glyph_shape( int glyph_idx, float tolerance, Glyph& glyph,
+                           std::vector<GlyphCommand>& commands, std::vector<F2>& points ) const {
+    if ( glyph_idx >= char_strings.count() ) return false;
+
+    int fd = glyph_idx < (int) fd_select.size() ? fd_select[ glyph_idx ] : 0;
+    if ( fd >= (int) local_subrs.size() ) return false;
+
+    size_t command_start = commands.size();
+    size_t point_start   = points.size();
+    CffPath path( commands, points, tolerance );
+    CffCharString cs( *this, local_subrs[ fd ], path );
+
+    const uint8_t *cs_end;
+    const uint8_t *cs_data = char_strings.object( glyph_idx, &cs_end );
+    if ( !cs.run( cs_data, cs_end, 0 ) ) {
+        commands.resize( command_start );
+        points.resize( point_start );
+        return false;
+    }
+    path.close();
+
+    glyph.command_start = command_start;
+    glyph.command_count = commands.size() - command_start;
+    glyph.point_start   = point_start;
+    glyph.point_count   = points.size() - point_start;
+    if ( glyph.command_count > 0 ) {
+        glyph.min = path.min;
+        glyph.max = path.max;
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "font.h"
+
+
+// INDEX structure of a CFF table, object offsets are decoded once
+// so subroutine calls don't have to read the offset array again
+
+struct CffIndex {
+    const uint8_t         *data = nullptr;    // Byte preceding the object data, offsets are 1-based
+    std::vector<uint32_t>  offsets;           // count + 1 offsets
+    const uint8_t         *end  = nullptr;    // First byte after the INDEX
+
+    // Returns pointer to the next byte after the INDEX, nullptr if malformed or past table_end
+    const uint8_t* read( const uint8_t *p, const uint8_t *table_end, bool is_cff2 );
+
+    int count() const { return offsets.empty() ? 0 : (int) offsets.size() - 1; }
+
+    const uint8_t* object( int idx, const uint8_t **obj_end ) const {
+        *obj_end = data + offsets[ idx + 1 ];
+        return data + offsets[ idx ];
+    }
+};
+
+
+// Glyph outlines of "CFF " and "CFF2" tables (Type 2 charstrings).
+// Cubic curves are approximated with quadratic ones, contours are reversed
+// to the TrueType orientation (clockwise outer contours).
+
+struct CffFont {
+    bool     is_cff2 = false;
+
+    CffIndex char_strings;
+    CffIndex global_subrs;
+
+    // Local subroutines per font dict, single entry for non-CID fonts
+    std::vector<CffIndex> local_subrs;
+
+    // Glyph index -> font dict, empty for non-CID fonts
+    std::vector<uint8_t>  fd_select;
+
+    // CFF2 variation store, blend deltas are scaled by the region scalars of the instance
+    ItemVariationStore    vstore;
+
+    // coords are the normalized axis coordinates of a variable font instance, empty for the default one
+    bool init( TtfSpan table, bool is_cff2, int num_glyphs, const std::vector<float>& coords );
+
+    // Appends glyph display list, tolerance is the maximum cubic approximation error in font units.
+    // Sets glyph bounding box, returns false for malformed charstrings.
+    bool glyph_shape( int glyph_idx, float tolerance, Glyph& glyph,
+                      std::vector<GlyphCommand>& commands, std::vector<F2>& points ) const;
+};
@@ -21,28 +21,20 @@
  */
 
 #include "font.h"
-#include <cassert>
+#include "cff.h"
+#include "stats.h"
+#include "ttf_read.h"
+#include "woff.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cwctype>
 #include <iostream>
+#include <thread>
 
 
-// Convert high-endian TTF values to low-endian
-// TODO support for high-endian architectures
-
-inline uint16_t ttf_u16( const uint8_t *p ) { return p[0] * 256 + p[1]; }
-inline uint32_t ttf_u32( const uint8_t *p ) { return ( p[0] << 24 ) + ( p[1] << 16 ) + ( p[2] << 8 ) + p[3]; }
-
-inline int16_t ttf_i16( const uint8_t *p ) { return p[0] * 256 + p[1]; }
-inline int32_t ttf_i32( const uint8_t *p ) { return ( p[0] << 24 ) + ( p[1] << 16 ) + ( p[2] << 8 ) + p[3]; }
-
-
-inline bool check_tag( const uint8_t *d, const char *tag ) {
-    bool match = d[0] == tag[0] &&
-                 d[1] == tag[1] &&
-                 d[2] == tag[2] &&
-                 d[3] == tag[3];
-    return match;
-}
+// Maximum distance between a CFF cubic curve and its quadratic approximation in target pixels
+static const float cff_tolerance_px = 0.05f;
 
 
 inline bool is_font( const uint8_t *ttf ) {
@@ -54,55 +46,42 @@ inline bool is_font( const uint8_t *ttf ) {
 }
 
 
-static const uint8_t* find_table( const uint8_t *ttf, const char *tag ) {
-    uint32_t num_tables = ttf_u16( ttf + 4 );
-    const uint8_t *table = ttf + 12;
-
-    for ( uint32_t itbl = 0; itbl < num_tables; ++itbl ) {
-        if ( check_tag( table, tag ) ) {
-            uint32_t offset = ttf_u32( table + 8 );
-            return ttf + offset;
-        }
-        table += 16;
-    }
-
-    return nullptr;
-}
-
-
-
 // Reading mappings from codepoint to glyph index
 
-static bool fill_cmap( Font& font, const uint8_t *ttf ) {
-    const uint8_t *cmap = find_table( ttf, "cmap" );
+// Codepoints mapped by the segments of formats 12 and 13 together, no more than in the Unicode range
+static const uint32_t cmap_max_codepoints = 0x110000;
+
+static bool fill_cmap( Font& font, TtfSpan cmap ) {
     if ( !cmap ) return false;
 
-    uint32_t num_tables = ttf_u16( cmap + 2 );
-    const uint8_t *imap = nullptr;
+    uint32_t num_tables = cmap.u16( 2 );
+    if ( !cmap.has( 4, num_tables * 8 ) ) return false;
+    TtfSpan imap;
     
     for ( size_t itbl = 0; itbl < num_tables; ++itbl ) {
-        const uint8_t *enc_table = cmap + 4 + 8 * itbl;
+        const uint8_t *enc_table = cmap.data + 4 + 8 * itbl;
         uint16_t platform = ttf_u16( enc_table );
         uint16_t encoding = ttf_u16( enc_table + 2 );
         uint32_t offset   = ttf_u32( enc_table + 4 );
 
         if ( platform == 0 ) {     // Unicode
-            imap = cmap + offset;
+            imap = cmap.sub( offset );
             break;
         }
         if ( platform == 3 ) {     // MS
             if ( encoding == 1 || encoding == 10 ) {
-                imap = cmap + offset;
+                imap = cmap.sub( offset );
                 break;
             }
         }
     }
     if ( !imap ) return false;
 
-    uint16_t format = ttf_u16( imap );
+    uint16_t format = imap.u16( 0 );
 
     if ( format == 0 ) {
-        const uint8_t *idx_data = imap + 6;
+        if ( !imap.has( 6, 256 ) ) return false;
+        const uint8_t *idx_data = imap.data + 6;
         for ( uint32_t i = 1; i < 256; ++i ) {
             int idx = (int) ( idx_data[i] );
             font.glyph_map.insert( { i, idx } );
@@ -110,11 +89,14 @@ static bool fill_cmap( Font& font, const uint8_t *ttf ) {
         return true;
         
     } else if ( format == 4 ) {
-        uint32_t  seg_count = ttf_u16( imap + 6 ) >> 1;
-        const uint8_t  *end_code = imap + 7 * 2;
+        uint32_t  seg_count = imap.u16( 6 ) >> 1;
+        if ( !imap.has( 8 * 2, seg_count * 2 * 4 ) ) return false;
+        const uint8_t  *end_code = imap.data + 7 * 2;
         const uint8_t  *start_code = end_code + 2 + seg_count * 2;
-        const uint8_t  *offset = imap + 8 * 2 + seg_count * 2 * 3;
-        const uint8_t  *delta = imap + 8 * 2 + seg_count * 2 * 2;
+        const uint8_t  *offset = imap.data + 8 * 2 + seg_count * 2 * 3;
+        const uint8_t  *delta = imap.data + 8 * 2 + seg_count * 2 * 2;
+        // Glyph index array is read through the offsets, it runs to the end of the subtable
+        size_t offset_pos = 8 * 2 + seg_count * 2 * 3;
         
         for ( uint32_t iseg = 0; iseg < seg_count; iseg++ ) {
             uint32_t seg_start = ttf_u16( start_code + iseg * 2 );
@@ -130,7 +112,7 @@ static bool fill_cmap( Font& font, const uint8_t *ttf ) {
             } else {
                 for ( uint32_t cp = seg_start; cp <= seg_end; ++cp ) {
                     uint32_t item = cp - seg_start;
-                    int32_t idx = ttf_i16( offset + iseg * 2 + seg_offset + item * 2 );
+                    int32_t idx = imap.i16( offset_pos + iseg * 2 + seg_offset + item * 2 );
                     font.glyph_map.insert( { cp, idx } );
                 }
             }
@@ -138,9 +120,10 @@ static bool fill_cmap( Font& font, const uint8_t *ttf ) {
         return true;
         
     } else if ( format == 6 ) {
-        uint32_t       first    = ttf_u16( imap + 6 );
-        uint32_t       count    = ttf_u16( imap + 8 );
-        const uint8_t *idx_data = imap + 10;
+        uint32_t       first    = imap.u16( 6 );
+        uint32_t       count    = imap.u16( 8 );
+        if ( !imap.has( 10, count * 2 ) ) return false;
+        const uint8_t *idx_data = imap.data + 10;
 
         for ( uint32_t i = 0; i < count; ++i ) {
             uint32_t idx = ttf_u16( idx_data + i * 2 );
@@ -149,9 +132,10 @@ static bool fill_cmap( Font& font, const uint8_t *ttf ) {
         return true;
         
     } else if ( format == 10 ) {
-        uint32_t        first_char = ttf_u32( imap + 12 );
-        uint32_t        num_chars  = ttf_u32( imap + 16 );
-        const uint8_t  *idx_data = imap + 20;
+        uint32_t        first_char = imap.u32( 12 );
+        uint32_t        num_chars  = imap.u32( 16 );
+        if ( num_chars > cmap_max_codepoints || !imap.has( 20, num_chars * 2 ) ) return false;
+        const uint8_t  *idx_data = imap.data + 20;
 
         for ( uint32_t i = 0; i < num_chars; ++i ) {
             uint32_t idx = ttf_u16( idx_data + i * 2 );
@@ -159,38 +143,25 @@ static bool fill_cmap( Font& font, const uint8_t *ttf ) {
         }
         return true;
         
-    } else if ( format == 12 ) {
-        uint32_t       ngroups = ttf_u32( imap + 12 );
-        const uint8_t *sm_group = imap + 16;
+    } else if ( format == 12 || format == 13 ) {
+        uint32_t       ngroups = imap.u32( 12 );
+        if ( !imap.has( 16, (size_t) ngroups * 12 ) ) return false;
+        const uint8_t *sm_group = imap.data + 16;
+        uint32_t       budget = cmap_max_codepoints;
 
-        for ( uint32_t i = 0; i < ngroups; ++i ) {
+        for ( uint32_t i = 0; i < ngroups; ++i, sm_group += 12 ) {
             uint32_t start_code = ttf_u32( sm_group );
-            uint32_t end_code = ttf_u32( sm_group + 4 );
+            uint32_t end_code = std::min( ttf_u32( sm_group + 4 ), cmap_max_codepoints - 1 );
             uint32_t start_idx = ttf_u32( sm_group + 8 );
+            if ( start_code > end_code ) continue;
+            if ( end_code - start_code >= budget ) return false;
+            budget -= end_code - start_code + 1;
 
             for ( uint32_t icode = start_code; icode <= end_code; ++icode ) {
-                uint32_t idx = start_idx + icode - start_code;
+                // Format 13 maps the whole group to one glyph
+                uint32_t idx = format == 12 ? start_idx + icode - start_code : start_idx;
                 font.glyph_map.insert( { icode, idx } );
             }
-
-            sm_group += 12;
-        }
-        return true;
-        
-    } else if ( format == 13 ) {
-        uint32_t       ngroups = ttf_u32( imap + 12 );
-        const uint8_t *sm_group = imap + 16;
-
-        for ( uint32_t i = 0; i < ngroups; ++i ) {
-            uint32_t start_code = ttf_u32( sm_group );
-            uint32_t end_code = ttf_u32( sm_group + 4 );
-            uint32_t glyph_idx = ttf_u32( sm_group + 8 );
-            
-            for ( uint32_t icode = start_code; icode <= end_code; ++icode ) {
-                font.glyph_map.insert( { icode, glyph_idx } );
-            }
-
-            sm_group += 12;
         }
         return true;
     }
@@ -200,9 +171,10 @@ static bool fill_cmap( Font& font, const uint8_t *ttf ) {
 
 
 
-// Glyph offset in 'glyf' table
+// Glyph data in 'glyf' table, no data for an empty glyph or if the 'loca' offsets are out of order
+// or outside of 'glyf'. The 'loca' size is checked for all the glyphs beforehand.
 
-inline int glyph_loc_offset( int glyph_idx, bool is_loc32, const uint8_t *loca ) {
+inline TtfSpan glyph_data( int glyph_idx, bool is_loc32, const uint8_t *loca, TtfSpan glyf ) {
     uint32_t off0, off1;
     if ( is_loc32 ) {
         off0 = ttf_u32( loca + glyph_idx * 4 );
@@ -211,57 +183,179 @@ inline int glyph_loc_offset( int glyph_idx, bool is_loc32, const uint8_t *loca )
         off0 = ttf_u16( loca + glyph_idx * 2 ) * 2;
         off1 = ttf_u16( loca + glyph_idx * 2 + 2 ) * 2;
     }
-    if ( off0 == off1 ) return -1;
-    else return off0;
+    if ( off0 >= off1 ) return TtfSpan();
+    else return glyf.sub( off0, off1 - off0 );
 }
 
 
 
-// Display list for simple (non composite) glyph
+// Display list size limits of a simple glyph
 
-static void glyph_shape_simple( Glyph& glyph, std::vector<GlyphCommand>& commands, const uint8_t *glyph_loc) {
-    int num_contours = ttf_i16( glyph_loc );
+inline int glyf_command_bound( int num_points, int num_contours ) {
+    return num_points + 2 * num_contours;
+}
 
-    if ( num_contours < 0 ) return;
+inline int glyf_point_bound( int num_points, int num_contours ) {
+    return 2 * num_points + num_contours;
+}
 
-    // Indices for the last point of each countour
-    const uint8_t *end_pts = glyph_loc + 10;
-    // Size of the byte code instructions, skipping this
-    size_t   icount = ttf_u16( end_pts + num_contours * 2 );
-    // Number of control points
-    size_t   num_pts = ttf_u16( end_pts + num_contours * 2 - 2 ) + 1;
+// Display list of TrueType contours, used for "glyf" and WOFF2 glyph streams.
+// A contour of n points takes at most n + 2 commands: MoveTo, one command per point,
+// closing BezTo and ClosePath, and at most 2n + 1 points. Returns the number of commands written,
+// the number of points goes to point_count.
+
+static int glyf_contours( const F2 *points, const uint8_t *on_curve, int num_points,
+                          const uint16_t *end_pts, int num_contours,
+                          GlyphCommand *commands, F2 *command_points, int *point_count ) {
+    // Two consecutive off-curve points assume on-curve point between them
+    int start = 0;
+    int count = 0;
+    int pcount = 0;
+
+    for ( int icontour = 0; icontour < num_contours; ++icontour ) {
+        int end = end_pts[ icontour ];
+        if ( end >= num_points ) break;
+        int contour_start = start;
+        start = std::max( start, end + 1 );
+        // Single points are hinting anchors, not contours
+        if ( end <= contour_start ) continue;
+
+        int move_point_idx = pcount;
+
+        commands[ count++ ] = GlyphCommand::MoveTo;
+        command_points[ pcount++ ] = points[ contour_start ];
+
+        for ( int ipoint = contour_start + 1; ipoint <= end; ++ipoint ) {
+            F2 cur_pos  = points[ ipoint ];
+            F2 prev_pos = points[ ipoint - 1 ];
+
+            if ( on_curve[ ipoint ] ) {
+                if ( on_curve[ ipoint - 1 ] ) {
+                    // Normal (non smooth) control point, pushing LineTo
+                    commands[ count++ ] = GlyphCommand::LineTo;
+                    command_points[ pcount++ ] = cur_pos;
+                } else {
+                    // Normal control point, pushing BezTo
+                    commands[ count++ ] = GlyphCommand::BezTo;
+                    command_points[ pcount++ ] = prev_pos;
+                    command_points[ pcount++ ] = cur_pos;
+                }
+            } else if ( !on_curve[ ipoint - 1 ] ) {
+                // Smooth curve, inserting control point in the middle
+                commands[ count++ ] = GlyphCommand::BezTo;
+                command_points[ pcount++ ] = prev_pos;
+                command_points[ pcount++ ] = 0.5f * ( prev_pos + cur_pos );
+            }
+        }
 
-    const uint8_t *flag_array = end_pts + num_contours * 2 + 2 + icount;
+        // Closing contour
+        F2 cur_pos = points[ end ];
+        if ( !on_curve[ contour_start ] ) {
+            if ( on_curve[ end ] ) {
+                // Contour starts off-curve, contour start to current point
+                command_points[ move_point_idx ] = cur_pos;
+            } else {
+                // Contour starts and ends off-curve,
+                // calculating contour starting point, setting the MoveTo point,
+                // and closing contour with BezTo
+                F2 pos = 0.5f * ( cur_pos + points[ contour_start ] );
+                command_points[ move_point_idx ] = pos;
+
+                commands[ count++ ] = GlyphCommand::BezTo;
+                command_points[ pcount++ ] = cur_pos;
+                command_points[ pcount++ ] = pos;
+            }
+        } else if ( !on_curve[ end ] ) {
+            // Contour ends off-curve, closing contour with BezTo to contour starting point
+            commands[ count++ ] = GlyphCommand::BezTo;
+            command_points[ pcount++ ] = cur_pos;
+            command_points[ pcount++ ] = points[ contour_start ];
+        }
+
+        // Pushing ClosePath command
+        commands[ count++ ] = GlyphCommand::ClosePath;
+    }
+    *point_count = pcount;
+    return count;
+}
 
-    glyph.command_start = commands.size();
 
-    const uint8_t *fpos   = flag_array;
-    int            fcount = num_pts;
-    size_t         xbytes = 0;
+// Moves the points of a simple glyph by variation deltas, updates the bounding box and metric deltas
 
-    // Calculating offsets of point coordinate tables 
-    while ( fcount > 0 ) {
-        uint8_t flag    = fpos[0];
-        uint8_t frepeat = fpos[1];
-        size_t  xsize = ( flag & 0x02 ) ?  1  :  ( flag & 0x10 ) ? 0 : 2;
+static void glyf_vary_points( FontOutlines& fo, int glyph_idx, std::vector<F2>& points,
+                              const std::vector<uint16_t>& end_pts, const GlyphVariations *var ) {
+    Glyph& glyph = fo.glyphs[ glyph_idx ];
+    std::vector<F2> deltas;
 
-        if ( flag & 0x08 ) {
-            fcount -= frepeat + 1;
-            fpos += 2;
-            xbytes += xsize * ( frepeat + 1 );
-        } else {
-            fcount--;
-            fpos++;
-            xbytes += xsize;
+    if ( var && var->glyph_deltas( glyph_idx, points.data(), points.size(), end_pts.data(), end_pts.size(), deltas ) ) {
+        F2 old_min = glyph.min;
+        glyph.min = F2{ 2e38f };
+        glyph.max = F2{ -2e38f };
+        for ( size_t ipoint = 0; ipoint < points.size(); ++ipoint ) {
+            points[ ipoint ] += deltas[ ipoint ];
+            glyph.min = min( glyph.min, points[ ipoint ] );
+            glyph.max = max( glyph.max, points[ ipoint ] );
         }
+
+        // Phantom points: origin and advance, the side bearing follows the new bounding box
+        F2 origin  = deltas[ points.size() ];
+        F2 advance = deltas[ points.size() + 1 ];
+        fo.metric_deltas[ glyph_idx ] = F2{ glyph.min.x - old_min.x - origin.x, advance.x - origin.x };
     }
-    
-    const uint8_t *xcoord = fpos;
-    const uint8_t *ycoord = xcoord + xbytes;
+}
+
+void glyf_simple_glyph( FontOutlines& fo, int glyph_idx, std::vector<F2>& points, const std::vector<uint8_t>& on_curve,
+                        const std::vector<uint16_t>& end_pts, const GlyphVariations *var ) {
+    Glyph& glyph = fo.glyphs[ glyph_idx ];
+    glyf_vary_points( fo, glyph_idx, points, end_pts, var );
+
+    glyph.command_start = fo.commands.size();
+    glyph.point_start   = fo.points.size();
+    fo.commands.resize( fo.commands.size() + glyf_command_bound( points.size(), end_pts.size() ) );
+    fo.points.resize( fo.points.size() + glyf_point_bound( points.size(), end_pts.size() ) );
+    glyph.command_count = glyf_contours( points.data(), on_curve.data(), points.size(),
+                                         end_pts.data(), end_pts.size(), fo.commands.data() + glyph.command_start,
+                                         fo.points.data() + glyph.point_start, &glyph.point_count );
+    fo.commands.resize( glyph.command_start + glyph.command_count );
+    fo.points.resize( glyph.point_start + glyph.point_count );
+}
+
+
+// Coordinate bytes of a point by the flag bits 0x02, 0x04, 0x10 and 0x20 described below
+
+static const uint8_t glyf_coord_size[64] = {
+    4, 4, 3, 3, 3, 3, 2, 2, 4, 4, 3, 3, 3, 3, 2, 2,
+    2, 2, 3, 3, 1, 1, 2, 2, 2, 2, 3, 3, 1, 1, 2, 2,
+    2, 2, 1, 1, 3, 3, 2, 2, 2, 2, 1, 1, 3, 3, 2, 2,
+    0, 0, 1, 1, 1, 1, 2, 2, 0, 0, 1, 1, 1, 1, 2, 2
+};
+
+// Display list for simple (non composite) glyph, written to the command and point slices
+// reserved at glyph.command_start and glyph.point_start. The header and the contour end points are checked
+// by the sizing pass. Returns false if the flags or the coordinates run past the glyph data.
+// With checked_reads every flag and coordinate read is checked against the glyph data instead,
+// the decoding benchmark compares the two.
+
+template <bool checked_reads>
+static bool glyph_shape_simple( FontOutlines& fo, int glyph_idx, TtfSpan glyph_loc, const GlyphVariations *var ) {
+    int num_contours = ttf_i16( glyph_loc.data );
+
+    if ( num_contours < 0 ) return true;
+
+    // Indices for the last point of each countour
+    const uint8_t *end_pts = glyph_loc.data + 10;
+    // Size of the byte code instructions, skipping this
+    size_t   icount = ttf_u16( end_pts + num_contours * 2 );
+    // Number of control points
+    size_t   num_pts = ttf_u16( end_pts + num_contours * 2 - 2 ) + 1;
+
+    size_t flags_offset = 10 + num_contours * 2 + 2 + icount;
+    if ( flags_offset > glyph_loc.size ) return false;
+    const uint8_t *flag_array = glyph_loc.data + flags_offset;
+    const uint8_t *glyph_end  = glyph_loc.end();
 
     // Flag bits:
     // 0x01 - on-curve, ~0x01 - off-curve
-    // Two consecutive off-curve points assume on-curve point between them    
     //
     // 0x02 - x-coord is 8-bit unsigned integer
     //       0x10 - positive, ~0x10 - negative
@@ -275,277 +369,503 @@ static void glyph_shape_simple( Glyph& glyph, std::vector<GlyphCommand>& command
     //
     // 0x08 - repeat flag N times, read next byte for N
 
-    // Current contour point coordinates
-    F2 cur_pos { 0.0f };
-    // Previous contour point coordinates
-    F2 prev_pos { 0.0f };
-
-    bool prev_on_curve = true;  // previous point was on-curve
-    bool on_curve = true;       // current point is on-curve
-    
-    size_t  iflag = 0; // next flag index
-    uint8_t flag  = 0; // current flag value
+    std::vector<uint8_t>  flags( num_pts );
+    std::vector<F2>       points( num_pts );
+    std::vector<uint16_t> contour_ends( num_contours );
 
-    size_t gc_contour_start_idx = 0;          // Index of the first control point of the contour
-    bool   contour_starts_off_curve = false;
-    bool   new_contour   = true;              // Current command starts new contour
+    for ( int icontour = 0; icontour < num_contours; ++icontour ) {
+        contour_ends[ icontour ] = ttf_u16( end_pts + icontour * 2 );
+    }
 
-    size_t  icontour = 0; // Next contour starting index
+    // A point takes at most 2 flag bytes and 4 coordinate bytes, the loops below are only checked
+    // for the glyphs that could run past their data
+    const uint8_t *fpos = flag_array;
+    bool flags_fit = !checked_reads && (size_t) ( glyph_end - fpos ) >= num_pts * 2;
+    for ( size_t ipoint = 0; ipoint < num_pts; ) {
+        if ( !flags_fit && ( fpos == glyph_end || ( ( *fpos & 0x08 ) && glyph_end - fpos < 2 ) ) ) return false;
+        uint8_t flag = *fpos++;
+        size_t  frepeat = ( flag & 0x08 ) ? *fpos++ : 0;
+        for ( size_t i = 0; i <= frepeat && ipoint < num_pts; ++i ) flags[ ipoint++ ] = flag;
+    }
 
-    GlyphCommand command;
-    command.type = GlyphCommand::MoveTo;
-    command.p0 = F2{ 0.0f };
-    command.p1 = F2{ 0.0f };
+    if ( !checked_reads && (size_t) ( glyph_end - fpos ) < num_pts * 4 ) {
+        size_t coord_size = 0;
+        for ( size_t ipoint = 0; ipoint < num_pts; ++ipoint ) coord_size += glyf_coord_size[ flags[ ipoint ] & 0x3f ];
+        if ( coord_size > (size_t) ( glyph_end - fpos ) ) return false;
+    }
 
-    // Filling glyph display list
+    const uint8_t *coord = fpos;
+    float x = 0.0f;
+    for ( size_t ipoint = 0; ipoint < num_pts; ++ipoint ) {
+        uint8_t flag = flags[ ipoint ];
+        if ( checked_reads && glyph_end - coord < ( ( flag & 0x02 ) ? 1 : ( flag & 0x10 ) ? 0 : 2 ) ) return false;
+        if ( flag & 0x02 ) {
+            // X-coord is 8 bit value
+            float dx = *coord++;
+            x += ( flag & 0x10 ) ? dx : -dx; // X-coord sign
+        } else if ( !( flag & 0x10 ) ) {
+            // X-coord is 16 bit value
+            x += ttf_i16( coord );
+            coord += 2;
+        }
+        points[ ipoint ].x = x;
+    }
 
+    float y = 0.0f;
     for ( size_t ipoint = 0; ipoint < num_pts; ++ipoint ) {
-        if ( ipoint == iflag ) {
-            flag = flag_array[0];
-            size_t frepeat = flag_array[1];
-
-            if ( flag & 0x08 ) {
-                // Repeat flag
-                iflag = ipoint + frepeat + 1;
-                flag_array += 2;
-            } else {
-                // Do not repeat flag
-                iflag = ipoint + 1;
-                flag_array++;
-            }
+        uint8_t flag = flags[ ipoint ];
+        if ( checked_reads && glyph_end - coord < ( ( flag & 0x04 ) ? 1 : ( flag & 0x20 ) ? 0 : 2 ) ) return false;
+        if ( flag & 0x04 ) {
+            // Y-coord is 8-bit value
+            float dy = *coord++;
+            y += ( flag & 0x20 ) ? dy : -dy; // Y-coord sign
+        } else if ( !( flag & 0x20 ) ) {
+            // Y-coord is 16-bit value
+            y += ttf_i16( coord );
+            coord += 2;
         }
+        points[ ipoint ].y = y;
+        flags[ ipoint ] = flag & 0x01;
+    }
+
+    glyf_vary_points( fo, glyph_idx, points, contour_ends, var );
+
+    Glyph& glyph = fo.glyphs[ glyph_idx ];
+    glyph.command_count = glyf_contours( points.data(), flags.data(), num_pts, contour_ends.data(), num_contours,
+                                         fo.commands.data() + glyph.command_start,
+                                         fo.points.data() + glyph.point_start, &glyph.point_count );
+    return true;
+}
 
-        prev_on_curve = on_curve;
-        on_curve = flag & 0x01;
 
-        prev_pos = cur_pos;
+// Composite glyphs will have a display list of all their subglyphs combined with transformation applied.
+// Components are resolved first, they may be composites with higher glyph indices. A single component
+// with a pure translation reuses the display list of the component glyph with an offset, composites
+// with the same ( component, transform ) records share one display list.
 
-        if ( flag & 0x02 ) {
-            // X-coord is 8 bit value
-            float dx = xcoord[0];
-            cur_pos.x += ( flag & 0x10 ) ? dx : -dx; // X-coord sign
-            xcoord++;
-        } else {
-            if ( !( flag & 0x10 ) ) {
-                // X-coord is 16 bit value
-                cur_pos.x += ttf_i16( xcoord );
-                xcoord += 2;
-            }
+static const int glyf_max_component_depth = 32;
+
+// Composites copying more commands than this are left empty, nested components of a malformed font
+// could multiply the display list sizes otherwise
+static const size_t glyf_max_composite_commands = 1 << 16;
+
+struct CompositeResolver {
+    enum State : uint8_t { Unresolved, InProgress, Resolved };
+
+    FontOutlines&        fo;
+    std::vector<uint8_t> state;
+
+    // Component records: glyph index and transform per component -> composite glyph with the display list
+    std::map<std::vector<float>, int> shared;
+
+    explicit CompositeResolver( FontOutlines& fo ) : fo( fo ), state( fo.glyphs.size(), Unresolved ) {}
+
+    void resolve( int glyph_idx, int depth );
+};
+
+// Display list ranges and offset of the source glyph
+static void glyph_share_commands( Glyph& glyph, const Glyph& source ) {
+    glyph.command_start  = source.command_start;
+    glyph.command_count  = source.command_count;
+    glyph.point_start    = source.point_start;
+    glyph.point_count    = source.point_count;
+    glyph.command_offset = source.command_offset;
+}
+
+void CompositeResolver::resolve( int glyph_idx, int depth ) {
+    if ( state[ glyph_idx ] != Unresolved ) return;
+    state[ glyph_idx ] = InProgress;
+
+    Glyph &glyph = fo.glyphs[ glyph_idx ];
+    if ( !glyph.is_composite ) {
+        state[ glyph_idx ] = Resolved;
+        return;
+    }
+
+    // Components referring back to the glyph or nested too deep are skipped
+    std::vector<float> key;
+    for ( int icomp = glyph.components_start; icomp < glyph.components_start + glyph.components_count; ++icomp ) {
+        const GlyphComponent& gcomp = fo.components[ icomp ];
+        if ( gcomp.glyph_idx >= (int) fo.glyphs.size() ) continue;
+        if ( depth < glyf_max_component_depth ) resolve( gcomp.glyph_idx, depth + 1 );
+        if ( state[ gcomp.glyph_idx ] != Resolved ) continue;
+        const Mat2d& tr = gcomp.transform;
+        key.insert( key.end(), { (float) gcomp.glyph_idx, tr[0][0], tr[0][1], tr[1][0], tr[1][1], tr[2][0], tr[2][1] } );
+    }
+
+    glyph.command_start = 0;
+    glyph.command_count = 0;
+    glyph.point_start   = 0;
+    glyph.point_count   = 0;
+    glyph.command_offset = F2{ 0.0f };
+    state[ glyph_idx ] = Resolved;
+
+    // A single pure translation, the only component left may follow skipped ones
+    if ( key.size() == 7 && key[1] == 1.0f && key[2] == 0.0f && key[3] == 0.0f && key[4] == 1.0f ) {
+        glyph_share_commands( glyph, fo.glyphs[ (int) key[0] ] );
+        glyph.command_offset += F2{ key[5], key[6] };
+        stats.count( "shared composites", 1 );
+        return;
+    }
+
+    auto shared_glyph = shared.find( key );
+    if ( shared_glyph != shared.end() ) {
+        glyph_share_commands( glyph, fo.glyphs[ shared_glyph->second ] );
+        stats.count( "shared composites", 1 );
+        return;
+    }
+
+    size_t command_count = 0;
+    for ( size_t ikey = 0; ikey < key.size(); ikey += 7 ) command_count += fo.glyphs[ (int) key[ ikey ] ].command_count;
+    if ( command_count > glyf_max_composite_commands ) return;
+
+    // Commands are copied as is, points are transformed component by component
+    glyph.command_start = fo.commands.size();
+    glyph.point_start   = fo.points.size();
+    for ( size_t ikey = 0; ikey < key.size(); ikey += 7 ) {
+        const Glyph& cglyph = fo.glyphs[ (int) key[ ikey ] ];
+        Mat2d tr( key[ ikey + 1 ], key[ ikey + 2 ], key[ ikey + 3 ], key[ ikey + 4 ], key[ ikey + 5 ], key[ ikey + 6 ] );
+        F2 offset = cglyph.command_offset;
+
+        for ( int icommand = cglyph.command_start; icommand < cglyph.command_start + cglyph.command_count; ++icommand ) {
+            fo.commands.push_back( fo.commands[ icommand ] );
         }
+        for ( int ipoint = cglyph.point_start; ipoint < cglyph.point_start + cglyph.point_count; ++ipoint ) {
+            fo.points.push_back( tr * ( fo.points[ ipoint ] + offset ) );
+        }
+    }
+    glyph.command_count = fo.commands.size() - glyph.command_start;
+    glyph.point_count   = fo.points.size() - glyph.point_start;
+    shared[ key ] = glyph_idx;
+}
 
-        if ( flag & 0x04 ) {
-            // Y-coord is 8-bit value
-            float dy = ycoord[0];
-            cur_pos.y += ( flag & 0x20 ) ? dy : -dy; // Y-coord sign
-            ycoord++;
-        } else {
-            if ( !( flag & 0x20 ) ) {
-                // Y-coord is 16-bit value
-                cur_pos.y += ttf_i16( ycoord );
-                ycoord += 2;
-            }
+// Bounding box of the display list control points
+static void glyph_commands_bounds( const FontOutlines& fo, Glyph& glyph ) {
+    if ( glyph.point_count == 0 ) return;
+    glyph.min = F2{ 2e38f };
+    glyph.max = F2{ -2e38f };
+    for ( int ipoint = glyph.point_start; ipoint < glyph.point_start + glyph.point_count; ++ipoint ) {
+        glyph.min = min( glyph.min, fo.points[ ipoint ] );
+        glyph.max = max( glyph.max, fo.points[ ipoint ] );
+    }
+    glyph.min += glyph.command_offset;
+    glyph.max += glyph.command_offset;
+}
+
+void glyf_vary_components( FontOutlines& fo, int glyph_idx, const GlyphVariations& var ) {
+    Glyph& glyph = fo.glyphs[ glyph_idx ];
+    std::vector<F2> deltas;
+
+    // One point per component offset, then the phantom points
+    if ( !var.glyph_deltas( glyph_idx, nullptr, glyph.components_count, nullptr, 0, deltas ) ) return;
+    for ( int icomp = 0; icomp < glyph.components_count; ++icomp ) {
+        Mat2d& tr = fo.components[ glyph.components_start + icomp ].transform;
+        tr[2] += deltas[ icomp ];
+    }
+
+    // The side bearing is corrected once the display list is built
+    F2 origin  = deltas[ glyph.components_count ];
+    F2 advance = deltas[ glyph.components_count + 1 ];
+    fo.metric_deltas[ glyph_idx ] = F2{ -origin.x, advance.x - origin.x };
+}
+
+void glyf_expand_composites( FontOutlines& fo ) {
+    CompositeResolver resolver( fo );
+    fo.glyph_min = F2 { 2e38f };
+    fo.glyph_max = F2 { -2e38f };
+    for ( size_t iglyph = 0; iglyph < fo.glyphs.size(); ++iglyph ) {
+        resolver.resolve( iglyph, 0 );
+
+        // Bounding boxes of varied composite glyphs come from the moved components
+        Glyph& glyph = fo.glyphs[ iglyph ];
+        if ( glyph.is_composite && !fo.metric_deltas.empty() ) {
+            float old_min_x = glyph.min.x;
+            glyph_commands_bounds( fo, glyph );
+            fo.metric_deltas[ iglyph ].x += glyph.min.x - old_min_x;
         }
+        fo.glyph_min = min( fo.glyph_min, fo.glyphs[ iglyph ].min );
+        fo.glyph_max = max( fo.glyph_max, fo.glyphs[ iglyph ].max );
+    }
+}
 
-        if ( new_contour ) {
-            // Push MoveTo command if starting new contour
-            contour_starts_off_curve = !on_curve;
-            gc_contour_start_idx = commands.size();
-            command.type = GlyphCommand::MoveTo;
-            command.p0 = cur_pos;
-            command.p1 = F2{ 0.0f };
 
-            commands.push_back( command );
-            
-            icontour = ttf_u16( end_pts );
-            end_pts += 2;
-            new_contour = false;
-        } else {
-            if ( on_curve ) {
-                if ( prev_on_curve ) {
-                    // Normal (non smooth) control point, pushing LineTo
-                    command.p0 = cur_pos;
-                    command.p1 = F2{ 0.0f };
-                    command.type = GlyphCommand::LineTo;
-                    commands.push_back( command );
-                } else {
-                    // Normal control point, pushing BezTo
-                    command.p0 = prev_pos;
-                    command.p1 = cur_pos;
-                    command.type = GlyphCommand::BezTo;
-                    commands.push_back( command );
-                }
+// Component records of a composite glyph, returns the position after the records,
+// nullptr if the records run past end. Components already read are kept.
+
+const uint8_t* glyf_components( const uint8_t *pos, const uint8_t *end, Glyph& glyph,
+                                std::vector<GlyphComponent>& components, bool *has_instructions ) {
+    glyph.is_composite = true;
+    glyph.components_start = components.size();
+    *has_instructions = false;
+
+    bool next_comp = true;
+
+    while( next_comp ) {
+        if ( end - pos < 4 ) break;
+        uint16_t flags = ttf_u16( pos );
+        uint32_t comp_glyph_idx = ttf_u16( pos + 2 );
+        pos += 4;
+
+        // Argument and transform sizes
+        int record_size = ( ( flags & 1 ) ? 4 : 2 )
+                        + ( ( flags & ( 1 << 3 ) ) ? 2 : ( flags & ( 1 << 6 ) ) ? 4 : ( flags & ( 1 << 7 ) ) ? 8 : 0 );
+        if ( end - pos < record_size ) break;
+        
+        Mat2d gtr { 1.0f };
+
+        // Component position
+        if ( flags & 2 ) {
+            if ( flags & 1 ) {
+                gtr[2][0] = ttf_i16( pos ); pos += 2;
+                gtr[2][1] = ttf_i16( pos ); pos += 2;
             } else {
-                if ( !prev_on_curve ) {
-                    // Smooth curve, inserting control point in the middle
-                    F2 mid_cp = 0.5f * ( prev_pos + cur_pos );
-                    command.p0 = prev_pos;
-                    command.p1 = mid_cp;
-                    command.type = GlyphCommand::BezTo;
-                    commands.push_back( command );
-                }
+                gtr[2][0] = ( (int8_t) *pos ); pos++;
+                gtr[2][1] = ( (int8_t) *pos ); pos++;
             }
+        } else {
+            // Positioning by matching points is not supported, the component stays at the origin
+            pos += ( flags & 1 ) ? 4 : 2;
         }
 
-        // Closing contour
-        if ( icontour == ipoint && ipoint > 0 ) {
-            if ( contour_starts_off_curve ) {
-                if ( on_curve ) {
-                    // Contour starts off-curve, contour start to current point
-                    commands[ gc_contour_start_idx ].p0 = cur_pos;
-                } else {
-                    // Contour starts and ends off-curve,
-                    // calculating contour starting point, setting first MoveTo P0,
-                    // and closing contour with BezTo
-                    
-                    F2 cpos = cur_pos;
-                    F2 next_cp = commands[ gc_contour_start_idx + 1 ].p0; // First BezTo off-curve CP
-                    F2 pos = 0.5f * ( cpos + next_cp );                   // Contour start point
-                    commands[ gc_contour_start_idx ].p0 = pos;
-
-                    command.p0 = cpos;
-                    command.p1 = pos;
-                    command.type = GlyphCommand::BezTo;
-                    commands.push_back( command );
-                }
-            } else {
-                if ( !on_curve ) {
-                    // Contour ends off-curve, closing contour with BezTo to contour starting point
-                    
-                    F2 start_pos = commands[ gc_contour_start_idx ].p0;
-
-                    command.p0 = cur_pos;
-                    command.p1 = start_pos;
-                    command.type = GlyphCommand::BezTo;
-                    commands.push_back( command );
-                }
-            }
-            // Pushing ClosePath command
-            command.type = GlyphCommand::ClosePath;
-            command.p0 = F2{ 0.0f };
-            command.p1 = F2{ 0.0f };
-            commands.push_back( command );
-            new_contour = true;
+        // Component rotation and scale
+        if ( flags & ( 1 << 3 ) ) {
+            // Uniform scale
+            gtr[0][0] = gtr[1][1] = ttf_i16( pos ) / 16384.0f; pos += 2;
+        } else if ( flags & ( 1 << 6 ) ) {
+            // XY-scale
+            gtr[0][0] = ttf_i16( pos ) / 16384.0f; pos += 2;
+            gtr[1][1] = ttf_i16( pos ) / 16384.0f; pos += 2;
+        } else if ( flags & ( 1 << 7 ) ) {
+            // Rotion matrix
+            gtr[0][0] = ttf_i16( pos ) / 16384.0f; pos += 2;
+            gtr[0][1] = ttf_i16( pos ) / 16384.0f; pos += 2;
+            gtr[1][0] = ttf_i16( pos ) / 16384.0f; pos += 2;
+            gtr[1][1] = ttf_i16( pos ) / 16384.0f; pos += 2;
         }
+
+        GlyphComponent gc;
+        gc.glyph_idx = comp_glyph_idx;
+        gc.transform = gtr;
+        components.push_back( gc );            
+
+        // Instructions follow the last component
+        if ( flags & ( 1 << 8 ) ) *has_instructions = true;
+
+        // More components?
+        next_comp = flags & ( 1 << 5 );
     }
+    glyph.components_count = components.size() - glyph.components_start;
+    return next_comp ? nullptr : pos;
+}
+
+
+// Runs fn( chunk_index, begin, end ) over chunks of [0, count) on several threads,
+// 0 threads is the number of cores
+
+static const size_t decode_chunk = 64;
 
-    glyph.command_count = commands.size() - glyph.command_start;
+template<typename Fn>
+static void parallel_chunks( size_t count, int threads, Fn fn ) {
+    size_t num_chunks = ( count + decode_chunk - 1 ) / decode_chunk;
+    size_t nthreads = threads > 0 ? threads : std::max( 1u, std::thread::hardware_concurrency() );
+    nthreads = std::max<size_t>( 1, std::min( nthreads, num_chunks ) );
+    std::atomic<size_t> next_chunk { 0 };
+
+    auto worker = [&]() {
+        for (;;) {
+            size_t ichunk = next_chunk++;
+            if ( ichunk >= num_chunks ) break;
+            fn( ichunk, ichunk * decode_chunk, std::min( count, ( ichunk + 1 ) * decode_chunk ) );
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for ( size_t i = 1; i < nthreads; ++i ) pool.emplace_back( worker );
+    worker();
+    for ( std::thread& t : pool ) t.join();
 }
 
 
-// Composite glyphs will have a display list of all their subglyphs combined with transformation applied
+// Reading "glyf" display lists and subglyphs of composite glyphs.
+// The serial pre-pass reads glyph headers and components, display list sizes of simple glyphs
+// are bounded by their point and contour counts, so every simple glyph gets its own slice
+// of the command and point arrays and the workers decode glyphs independently. Slices are compacted afterwards.
+// Malformed glyphs are left empty, returns false if "loca" is too short for the glyph count.
 
-static void glyph_commands_composite( Font& font, int glyph_idx ) {
-    Glyph &glyph = font.glyphs[ glyph_idx ];
-    if ( !glyph.is_composite ) return;
-    glyph.command_start = font.glyph_commands.size();
-    glyph.command_count = 0;
+static bool glyf_decode( FontOutlines& fo, bool is_loc32, TtfSpan loca, TtfSpan glyf,
+                         const GlyphVariations *var, int threads, bool checked_reads ) {
+    size_t num_glyphs = fo.glyphs.size();
+    if ( !loca.has( 0, ( num_glyphs + 1 ) * ( is_loc32 ? 4 : 2 ) ) ) return false;
 
-    for ( int icomp = glyph.components_start; icomp < glyph.components_start + glyph.components_count; ++icomp ) {
-        GlyphComponent& gcomp = font.glyph_components[ icomp ];
-        const Glyph& cglyph = font.glyphs[ gcomp.glyph_idx ];
-        const Mat2d& tr = gcomp.transform;
+    std::vector<TtfSpan> simple_locs( num_glyphs );
+    std::atomic<int> malformed { 0 };
+    size_t command_bound = 0;
+    size_t point_bound   = 0;
 
-        for ( int icommand = cglyph.command_start; icommand < cglyph.command_start + cglyph.command_count; ++icommand ) {
-            const GlyphCommand& gcommand = font.glyph_commands[ icommand ];
-            GlyphCommand new_command;
-            new_command.type = gcommand.type;
-                
-            switch ( gcommand.type ) {
-            case GlyphCommand::MoveTo:
-            case GlyphCommand::LineTo:
-                new_command.p0 = tr * gcommand.p0;
-                break;
-            case GlyphCommand::BezTo:
-                new_command.p0 = tr * gcommand.p0;
-                new_command.p1 = tr * gcommand.p1;
-                break;
-            case GlyphCommand::ClosePath:                
-                break;
+    int sizing_span = stats.begin( "glyph sizing" );
+    for ( size_t iglyph = 0; iglyph < num_glyphs; ++iglyph ) {
+        Glyph &glyph = fo.glyphs[ iglyph ];
+
+        TtfSpan glyph_loc = glyph_data( iglyph, is_loc32, loca.data, glyf );
+        if ( !glyph_loc ) continue;
+        if ( glyph_loc.size < 10 ) {
+            ++malformed;
+            continue;
+        }
+
+        const uint8_t *glyph_pos = glyph_loc.data;
+        int num_contours = ttf_i16( glyph_pos );
+
+        float minx = ttf_i16( glyph_pos + 2 );
+        float miny = ttf_i16( glyph_pos + 4 );
+        float maxx = ttf_i16( glyph_pos + 6 );
+        float maxy = ttf_i16( glyph_pos + 8 );
+
+        glyph.min = F2{ minx, miny };
+        glyph.max = F2{ maxx, maxy };
+
+        // Simple glyph, contour end points and instruction size
+        if ( num_contours > 0 ) {
+            if ( !glyph_loc.has( 10, num_contours * 2 + 2 ) ) {
+                ++malformed;
+                continue;
+            }
+            int num_pts = ttf_u16( glyph_pos + 10 + num_contours * 2 - 2 ) + 1;
+            glyph.command_start = command_bound;
+            glyph.point_start   = point_bound;
+            command_bound += glyf_command_bound( num_pts, num_contours );
+            point_bound   += glyf_point_bound( num_pts, num_contours );
+            simple_locs[ iglyph ] = glyph_loc;
+
+        // Composite glyph
+        } else if ( num_contours < 0 ) {
+            bool has_instructions;
+            if ( !glyf_components( glyph_pos + 10, glyph_loc.end(), glyph, fo.components, &has_instructions ) ) {
+                ++malformed;
             }
-            font.glyph_commands.push_back( new_command );
         }
     }
+    fo.commands.resize( command_bound );
+    fo.points.resize( point_bound );
+    stats.end( sizing_span );
+
+    parallel_chunks( num_glyphs, threads, [&]( size_t, size_t begin, size_t end ) {
+        for ( size_t iglyph = begin; iglyph < end; ++iglyph ) {
+            if ( simple_locs[ iglyph ] ) {
+                bool shaped = checked_reads ? glyph_shape_simple<true>( fo, iglyph, simple_locs[ iglyph ], var )
+                                            : glyph_shape_simple<false>( fo, iglyph, simple_locs[ iglyph ], var );
+                if ( !shaped ) {
+                    fo.glyphs[ iglyph ].command_count = 0;
+                    fo.glyphs[ iglyph ].point_count   = 0;
+                    ++malformed;
+                }
+            } else if ( var && fo.glyphs[ iglyph ].is_composite ) {
+                glyf_vary_components( fo, iglyph, *var );
+            }
+        }
+    } );
 
-    glyph.command_count = font.glyph_commands.size() - glyph.command_start;
+    // Closing the gaps left by the slices, display lists only move towards the start
+    size_t command_pos = 0;
+    size_t point_pos   = 0;
+    for ( size_t iglyph = 0; iglyph < num_glyphs; ++iglyph ) {
+        if ( !simple_locs[ iglyph ] ) continue;
+        Glyph &glyph = fo.glyphs[ iglyph ];
+        auto slice = fo.commands.begin() + glyph.command_start;
+        std::copy( slice, slice + glyph.command_count, fo.commands.begin() + command_pos );
+        auto point_slice = fo.points.begin() + glyph.point_start;
+        std::copy( point_slice, point_slice + glyph.point_count, fo.points.begin() + point_pos );
+        glyph.command_start = command_pos;
+        glyph.point_start   = point_pos;
+        command_pos += glyph.command_count;
+        point_pos   += glyph.point_count;
+    }
+    fo.commands.resize( command_pos );
+    fo.points.resize( point_pos );
+
+    if ( malformed > 0 ) stats.count( "malformed glyphs", malformed );
+    return true;
 }
 
 
-// Reading glyph display list or subglyphs of a composite glyph.
+// Reading CFF display lists. Charstring sizes are only known after running them,
+// so every chunk of glyphs is decoded to its own command and point arrays, the arrays are joined in glyph order.
 
-static void glyph_shape( Font& font, int glyph_idx, bool is_loc32, const uint8_t *loca, const uint8_t *glyf) {
-    Glyph &glyph = font.glyphs[ glyph_idx ];
+static void cff_decode( FontOutlines& fo, const CffFont& cff_font, float tolerance, int threads ) {
+    size_t num_glyphs = fo.glyphs.size();
+    size_t num_chunks = ( num_glyphs + decode_chunk - 1 ) / decode_chunk;
+    std::vector<std::vector<GlyphCommand>> chunk_commands( num_chunks );
+    std::vector<std::vector<F2>>           chunk_points( num_chunks );
 
-    int glyph_offset = glyph_loc_offset( glyph_idx, is_loc32, loca );
-    if ( glyph_offset < 0 ) return;    
-    
-    const uint8_t *glyph_loc = glyf + glyph_offset;
-    int num_contours = ttf_i16( glyph_loc );
+    parallel_chunks( num_glyphs, threads, [&]( size_t ichunk, size_t begin, size_t end ) {
+        for ( size_t iglyph = begin; iglyph < end; ++iglyph ) {
+            cff_font.glyph_shape( iglyph, tolerance, fo.glyphs[ iglyph ], chunk_commands[ ichunk ], chunk_points[ ichunk ] );
+        }
+    } );
+
+    for ( size_t ichunk = 0; ichunk < num_chunks; ++ichunk ) {
+        size_t chunk_start = fo.commands.size();
+        size_t chunk_point_start = fo.points.size();
+        size_t end = std::min( num_glyphs, ( ichunk + 1 ) * decode_chunk );
+        for ( size_t iglyph = ichunk * decode_chunk; iglyph < end; ++iglyph ) {
+            fo.glyphs[ iglyph ].command_start += chunk_start;
+            fo.glyphs[ iglyph ].point_start   += chunk_point_start;
+        }
+        fo.commands.insert( fo.commands.end(), chunk_commands[ ichunk ].begin(), chunk_commands[ ichunk ].end() );
+        fo.points.insert( fo.points.end(), chunk_points[ ichunk ].begin(), chunk_points[ ichunk ].end() );
+    }
+}
 
-    float minx = ttf_i16( glyph_loc + 2 );
-    float miny = ttf_i16( glyph_loc + 4 );
-    float maxx = ttf_i16( glyph_loc + 6 );
-    float maxy = ttf_i16( glyph_loc + 8 );
-    
-    glyph.min = F2{ minx, miny };
-    glyph.max = F2{ maxx, maxy };
-
-    // Simple glyph
-    if ( num_contours > 0 ) {
-        glyph_shape_simple( glyph, font.glyph_commands, glyph_loc);
-
-    // Composite glyph
-    } else if ( num_contours < 0 ) {
-        glyph.is_composite = true;
-        glyph.components_start = font.glyph_components.size();
-
-        bool next_comp = true;
-        const uint8_t *pos = glyph_loc + 10;
-
-        while( next_comp ) {
-            uint16_t flags = ttf_u16( pos );
-            uint32_t comp_glyph_idx = ttf_u16( pos + 2 );
-            pos += 4;
-            
-            Mat2d gtr { 1.0f };
-
-            // Component position
-            if ( flags & 2 ) {
-                if ( flags & 1 ) {
-                    gtr[2][0] = ttf_i16( pos ); pos += 2;
-                    gtr[2][1] = ttf_i16( pos ); pos += 2;
-                } else {
-                    gtr[2][0] = ( (int8_t) *pos ); pos++;
-                    gtr[2][1] = ( (int8_t) *pos ); pos++;
-                }
-            } else {
-                assert( false );
-            }
 
-            // Component rotation and scale
-            if ( flags & ( 1 << 3 ) ) {
-                // Uniform scale
-                gtr[0][0] = gtr[1][1] = ttf_i16( pos ) / 16384.0f; pos += 2;
-            } else if ( flags & ( 1 << 6 ) ) {
-                // XY-scale
-                gtr[0][0] = ttf_i16( pos ) / 16384.0f; pos += 2;
-                gtr[1][1] = ttf_i16( pos ) / 16384.0f; pos += 2;
-            } else if ( flags & ( 1 << 7 ) ) {
-                // Rotion matrix
-                gtr[0][0] = ttf_i16( pos ) / 16384.0f; pos += 2;
-                gtr[0][1] = ttf_i16( pos ) / 16384.0f; pos += 2;
-                gtr[1][0] = ttf_i16( pos ) / 16384.0f; pos += 2;
-                gtr[1][1] = ttf_i16( pos ) / 16384.0f; pos += 2;
-            }
 
-            GlyphComponent gc;
-            gc.glyph_idx = comp_glyph_idx;
-            gc.transform = gtr;
-            font.glyph_components.push_back( gc );            
+// Contour index of the display lists: command and point ranges of every contour and signed areas.
+// Glyphs sharing a display list share its contours.
+
+static void split_contours( FontOutlines& fo, Glyph& glyph ) {
+    glyph.contour_start = fo.contours.size();
 
-            // More components?
-            next_comp = flags & ( 1 << 5 );
+    // Splitting at ClosePath, areas from the control points
+    GlyphContour contour;
+    contour.command_start = glyph.command_start;
+    contour.point_start   = glyph.point_start;
+    int ip = glyph.point_start;
+    int command_end = glyph.command_start + glyph.command_count;
+    for ( int ic = glyph.command_start; ic < command_end; ++ic ) {
+        GlyphCommand command = fo.commands[ ic ];
+        ip += command_points( command );
+        if ( command != GlyphCommand::ClosePath && ic != command_end - 1 ) continue;
+
+        contour.command_count = ic + 1 - contour.command_start;
+        contour.point_count   = ip - contour.point_start;
+        if ( contour.point_count > 0 ) {
+            const F2 *points = fo.points.data() + contour.point_start;
+            float area = cross( points[ contour.point_count - 1 ], points[0] );
+            for ( int ipoint = 1; ipoint < contour.point_count; ++ipoint ) {
+                area += cross( points[ ipoint - 1 ], points[ ipoint ] );
+            }
+            contour.area = 0.5f * area;
+            fo.contours.push_back( contour );
         }
-        glyph.components_count = font.glyph_components.size() - glyph.components_start;
+        contour.command_start = ic + 1;
+        contour.point_start   = ip;
+    }
+    glyph.contour_count = fo.contours.size() - glyph.contour_start;
+}
+
+void index_contours( FontOutlines& fo ) {
+    // Display list start -> glyph with the contours
+    std::unordered_map<int, int> indexed;
+    for ( size_t iglyph = 0; iglyph < fo.glyphs.size(); ++iglyph ) {
+        Glyph& glyph = fo.glyphs[ iglyph ];
+        if ( glyph.command_count == 0 ) continue;
+        auto shared = indexed.find( glyph.command_start );
+        if ( shared != indexed.end() ) {
+            glyph.contour_start = fo.glyphs[ shared->second ].contour_start;
+            glyph.contour_count = fo.glyphs[ shared->second ].contour_count;
+            continue;
+        }
+        split_contours( fo, glyph );
+        indexed[ glyph.command_start ] = iglyph;
     }
 }
 
@@ -553,135 +873,601 @@ static void glyph_shape( Font& font, int glyph_idx, bool is_loc32, const uint8_t
 
 // Reading kerning table
 
-static bool fill_kern( Font& font, const uint8_t *ttf) {
-    const uint8_t *kern = find_table( ttf, "kern" );
+static bool fill_kern( Font& font, TtfSpan kern ) {
     if ( !kern ) return false;
 
-    uint16_t  num_tables = ttf_u16( kern + 2 );
-    const uint8_t  *table = nullptr;
-    const uint8_t  *pos = kern + 4;
+    uint16_t  num_tables = kern.u16( 2 );
+    TtfSpan   table;
+    size_t    pos = 4;
 
     for ( size_t itbl = 0; itbl < num_tables; ++itbl ) {
-        uint16_t length = ttf_u16( pos + 2 );
-        uint16_t coverage = ttf_u16( pos + 4 );
+        uint16_t length = kern.u16( pos + 2 );
+        uint16_t coverage = kern.u16( pos + 4 );
         
         if ( coverage == 1 ) {
-            table = pos;
+            table = kern.sub( pos );
             break;
         }
+        if ( length == 0 ) break;
         pos += length;
     }
 
     if ( !table ) return false;
 
-    uint32_t num_pairs = ttf_u16( table + 6 );
-    pos = table + 14;
+    uint32_t num_pairs = table.u16( 6 );
+    if ( !table.has( 14, num_pairs * 6 ) ) return false;
+    const uint8_t *ppos = table.data + 14;
     
     for ( uint32_t ipair = 0; ipair < num_pairs; ++ipair ) {
-        uint32_t left  = ttf_u16( pos );
-        uint32_t right = ttf_u16( pos + 2 );
-        int32_t  kern  = ttf_i16( pos + 4 );
+        uint32_t left  = ttf_u16( ppos );
+        uint32_t right = ttf_u16( ppos + 2 );
+        int32_t  kern  = ttf_i16( ppos + 4 );
         uint32_t pair = ( left << 16 ) | right;
         font.kern_map.insert( { pair, kern} );
-        pos += 6;
+        ppos += 6;
     }
 
     return true;
 }
 
-bool Font::load_ttf_file( const char *filename ) {
+// Reading GPOS pair adjustment lookups of the "kern" feature
+
+// Coverage and class definition ranges are capped at the glyph index range
+static const size_t gpos_max_glyphs = 0x10000;
+
+// Coverage table, glyph ids in coverage index order
+static void read_coverage( TtfSpan cov, std::vector<uint16_t>& glyph_ids ) {
+    glyph_ids.clear();
+    uint16_t format = cov.u16( 0 );
+    uint16_t count  = cov.u16( 2 );
+
+    if ( format == 1 ) {
+        if ( !cov.has( 4, count * 2 ) ) return;
+        for ( uint32_t i = 0; i < count; ++i ) {
+            glyph_ids.push_back( ttf_u16( cov.data + 4 + i * 2 ) );
+        }
+    } else if ( format == 2 ) {
+        if ( !cov.has( 4, count * 6 ) ) return;
+        for ( uint32_t i = 0; i < count; ++i ) {
+            const uint8_t *range = cov.data + 4 + i * 6;
+            uint16_t start = ttf_u16( range );
+            uint16_t end   = ttf_u16( range + 2 );
+            if ( end < start || glyph_ids.size() + ( end - start ) >= gpos_max_glyphs ) continue;
+            for ( uint32_t g = start; g <= end; ++g ) glyph_ids.push_back( g );
+        }
+    }
+}
+
+// Class definition table into glyph index -> class array, missing glyphs are class 0
+static void read_class_def( TtfSpan cd, std::vector<uint16_t>& classes ) {
+    uint16_t format = cd.u16( 0 );
+
+    if ( format == 1 ) {
+        uint16_t start = cd.u16( 2 );
+        uint16_t count = cd.u16( 4 );
+        if ( !cd.has( 6, count * 2 ) ) return;
+        if ( classes.size() < (size_t) start + count ) classes.resize( start + count, 0 );
+        for ( uint32_t i = 0; i < count; ++i ) {
+            classes[ start + i ] = ttf_u16( cd.data + 6 + i * 2 );
+        }
+    } else if ( format == 2 ) {
+        uint16_t count = cd.u16( 2 );
+        if ( !cd.has( 4, count * 6 ) ) return;
+        for ( uint32_t i = 0; i < count; ++i ) {
+            const uint8_t *range = cd.data + 4 + i * 6;
+            uint16_t start = ttf_u16( range );
+            uint16_t end   = ttf_u16( range + 2 );
+            uint16_t cls   = ttf_u16( range + 4 );
+            if ( end < start ) continue;
+            if ( classes.size() <= end ) classes.resize( end + 1, 0 );
+            for ( uint32_t g = start; g <= end; ++g ) classes[ g ] = cls;
+        }
+    }
+}
+
+static int value_record_size( uint16_t value_format ) {
+    int bits = 0;
+    for ( uint16_t v = value_format; v; v >>= 1 ) bits += v & 1;
+    return bits * 2;
+}
+
+// Only the horizontal advance adjustment matters for kerning. Variable fonts keep the instance
+// deltas in the "GDEF" variation store, device offsets are from the start of base.
+// The record is inside of base.
+static int16_t value_record_x_advance( const uint8_t *record, uint16_t value_format,
+                                       TtfSpan base, const ItemVariationStore *var ) {
+    if ( !( value_format & 0x0004 ) ) return 0;
+    int16_t adv = ttf_i16( record + value_record_size( value_format & 0x0003 ) );
+
+    if ( var && ( value_format & 0x0040 ) ) {
+        uint16_t device_offset = ttf_u16( record + value_record_size( value_format & 0x003f ) );
+        TtfSpan  device = base.sub( device_offset, 6 );
+        if ( device_offset && device && ttf_u16( device.data + 4 ) == 0x8000 ) {
+            adv += (int16_t) lroundf( var->delta( ttf_u16( device.data ), ttf_u16( device.data + 2 ) ) );
+        }
+    }
+    return adv;
+}
+
+static bool read_pair_pos( KernSubtable& st, TtfSpan pp, const ItemVariationStore *var ) {
+    uint16_t format = pp.u16( 0 );
+    TtfSpan  cov = pp.sub( pp.u16( 2 ) );
+    uint16_t vf1 = pp.u16( 4 );
+    uint16_t vf2 = pp.u16( 6 );
+    int      vs1 = value_record_size( vf1 );
+    int      vs2 = value_record_size( vf2 );
+
+    std::vector<uint16_t> covered;
+    read_coverage( cov, covered );
+
+    if ( format == 1 ) {
+        uint16_t pair_set_count = pp.u16( 8 );
+        if ( !pp.has( 10, pair_set_count * 2 ) ) return false;
+        std::vector<std::pair<uint32_t, int16_t>> pairs;
+        for ( uint32_t iset = 0; iset < pair_set_count && iset < covered.size(); ++iset ) {
+            TtfSpan  ps = pp.sub( ttf_u16( pp.data + 10 + iset * 2 ) );
+            uint16_t count = ps.u16( 0 );
+            if ( !ps.has( 2, count * ( 2 + vs1 + vs2 ) ) ) continue;
+            const uint8_t *rec = ps.data + 2;
+            for ( uint32_t i = 0; i < count; ++i, rec += 2 + vs1 + vs2 ) {
+                int16_t adv = value_record_x_advance( rec + 2, vf1, ps, var );
+                pairs.push_back( { ( (uint32_t) covered[ iset ] << 16 ) | ttf_u16( rec ), adv } );
+            }
+        }
+        std::sort( pairs.begin(), pairs.end() );
+        for ( const auto& p : pairs ) {
+            st.pairs.push_back( p.first );
+            st.pair_values.push_back( p.second );
+        }
+        return true;
+    }
+
+    if ( format == 2 ) {
+        // Without an x advance there is nothing to read, and the empty records wouldn't
+        // bound the class matrix by the subtable size
+        if ( !( ( vf1 | vf2 ) & 0x0004 ) ) return false;
+        st.class1_count = pp.u16( 12 );
+        st.class2_count = pp.u16( 14 );
+        if ( st.class1_count == 0 || st.class2_count == 0 ) return false;
+        size_t class_count = (size_t) st.class1_count * st.class2_count;
+        if ( !pp.has( 16, class_count * ( vs1 + vs2 ) ) ) return false;
+
+        std::vector<uint16_t> class1;
+        read_class_def( pp.sub( pp.u16( 8 ) ), class1 );
+        read_class_def( pp.sub( pp.u16( 10 ) ), st.class2 );
+
+        uint16_t max_glyph = 0;
+        for ( uint16_t g : covered ) max_glyph = std::max( max_glyph, g );
+        st.class1.assign( covered.empty() ? 0 : max_glyph + 1, KernSubtable::no_class );
+        for ( uint16_t g : covered ) {
+            uint16_t c = g < class1.size() ? class1[ g ] : 0;
+            st.class1[ g ] = c < st.class1_count ? c : 0;
+        }
+
+        st.class_values.resize( class_count );
+        const uint8_t *rec = pp.data + 16;
+        for ( size_t i = 0; i < st.class_values.size(); ++i, rec += vs1 + vs2 ) {
+            st.class_values[ i ] = value_record_x_advance( rec, vf1, pp, var );
+        }
+        return true;
+    }
+
+    return false;
+}
+
+static bool fill_gpos_kern( Font& font, TtfSpan gpos, const ItemVariationStore *var ) {
+    if ( !gpos ) return false;
+
+    TtfSpan  feature_list = gpos.sub( gpos.u16( 6 ) );
+    TtfSpan  lookup_list  = gpos.sub( gpos.u16( 8 ) );
+    uint16_t lookup_count = lookup_list.u16( 0 );
+    uint16_t feature_count = feature_list.u16( 0 );
+    if ( !lookup_list.has( 2, lookup_count * 2 ) || !feature_list.has( 2, feature_count * 6 ) ) return false;
+
+    // Kerning lookups of all scripts and languages, applied in lookup list order
+    std::vector<bool> is_kern( lookup_count, false );
+    for ( uint32_t ifeature = 0; ifeature < feature_count; ++ifeature ) {
+        const uint8_t *rec = feature_list.data + 2 + ifeature * 6;
+        if ( !check_tag( rec, "kern" ) ) continue;
+        TtfSpan  feature = feature_list.sub( ttf_u16( rec + 4 ) );
+        uint16_t index_count = feature.u16( 2 );
+        if ( !feature.has( 4, index_count * 2 ) ) continue;
+        for ( uint32_t i = 0; i < index_count; ++i ) {
+            uint16_t ilookup = ttf_u16( feature.data + 4 + i * 2 );
+            if ( ilookup < lookup_count ) is_kern[ ilookup ] = true;
+        }
+    }
+
+    for ( uint32_t ilookup = 0; ilookup < lookup_count; ++ilookup ) {
+        if ( !is_kern[ ilookup ] ) continue;
+        TtfSpan  lookup = lookup_list.sub( ttf_u16( lookup_list.data + 2 + ilookup * 2 ) );
+        uint16_t type = lookup.u16( 0 );
+        uint16_t subtable_count = lookup.u16( 4 );
+        if ( !lookup.has( 6, subtable_count * 2 ) ) continue;
+
+        KernLookup kl;
+        for ( uint32_t isub = 0; isub < subtable_count; ++isub ) {
+            TtfSpan  sub = lookup.sub( ttf_u16( lookup.data + 6 + isub * 2 ) );
+            uint16_t sub_type = type;
+            // Extension positioning, 32-bit offset to the actual subtable
+            if ( type == 9 ) {
+                sub_type = sub.u16( 2 );
+                sub = sub.sub( sub.u32( 4 ) );
+            }
+            if ( sub_type != 2 || !sub ) continue;
+
+            KernSubtable st;
+            if ( read_pair_pos( st, sub, var ) ) kl.subtables.push_back( std::move( st ) );
+        }
+        if ( !kl.subtables.empty() ) font.kern_lookups.push_back( std::move( kl ) );
+    }
+
+    for ( const KernLookup& kl : font.kern_lookups ) {
+        for ( const KernSubtable& st : kl.subtables ) {
+            stats.count( "kern pairs", st.pairs.size() );
+            stats.count( "kern class values", st.class_values.size() );
+        }
+    }
+
+    return !font.kern_lookups.empty();
+}
+
+// Bound to references by std::vector::assign, needs a definition before C++17
+const uint16_t KernSubtable::no_class;
+
+bool KernSubtable::find( int left, int right, int *value ) const {
+    if ( is_class_based() ) {
+        uint16_t c1 = left_class( left );
+        if ( c1 == no_class ) return false;
+        uint16_t c2 = right_class( right );
+        *value = c2 < class2_count ? class_values[ (size_t) c1 * class2_count + c2 ] : 0;
+        return true;
+    }
+
+    uint32_t key = ( (uint32_t) left << 16 ) | (uint32_t) right;
+    auto it = std::lower_bound( pairs.begin(), pairs.end(), key );
+    if ( it == pairs.end() || *it != key ) return false;
+    *value = pair_values[ it - pairs.begin() ];
+    return true;
+}
+
+int Font::glyph_kern_advance( int left, int right ) const {
+    if ( kern_lookups.empty() ) {
+        auto it = kern_map.find( ( (uint32_t) left << 16 ) | (uint32_t) right );
+        return it == kern_map.end() ? 0 : (int) it->second;
+    }
+
+    int res = 0;
+    for ( const KernLookup& kl : kern_lookups ) {
+        for ( const KernSubtable& st : kl.subtables ) {
+            int value;
+            if ( st.find( left, right, &value ) ) {
+                res += value;
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+int Font::kern_advance( uint32_t cp1, uint32_t cp2 ) const {
+    int left  = glyph_idx( cp1 );
+    int right = glyph_idx( cp2 );
+    if ( left < 0 || right < 0 ) return 0;
+    return glyph_kern_advance( left, right );
+}
+
+const char* font_error_string( FontError error ) {
+    switch ( error ) {
+    case FontError::None:         return "no error";
+    case FontError::FileRead:     return "file can't be read";
+    case FontError::NotFont:      return "not a font file";
+    case FontError::BadContainer: return "malformed WOFF or WOFF2 data";
+    case FontError::BadDirectory: return "table directory outside of the file";
+    case FontError::NoFace:       return "no such face";
+    case FontError::MissingTable: return "required table is missing";
+    case FontError::BadTable:     return "malformed table";
+    case FontError::Unsupported:  return "unsupported font format";
+    case FontError::UnknownAxis:  return "unknown variation axis";
+    }
+    return "unknown error";
+}
+
+bool FontFile::load( const char *filename ) {
+    error = FontError::FileRead;
     FILE *f = fopen( filename, "rb" );
     if ( !f ) return false;
-    
+    StatsTimer st( "file read" );
+
     fseek( f, 0, SEEK_END );
     size_t fsize = ftell( f );
     fseek( f, 0, SEEK_SET );
 
-    uint8_t *ttf = (unsigned char*) malloc( fsize );
-    fread( ttf, 1, fsize, f );
+    storage.resize( fsize );
+    size_t read = fread( storage.data(), 1, fsize, f );
     fclose( f );
+    stats.count( "font bytes", fsize );
 
-    bool res = load_ttf_mem( ttf );
-    free( ttf );
-    return res;
+    return read == fsize && init( storage.data(), fsize );
+}
+
+bool FontFile::init( const uint8_t *font_data, size_t font_size ) {
+    error = FontError::NotFont;
+    if ( font_data == nullptr || font_size < 12 ) return false;
+
+    // WOFF and WOFF2 are unpacked to sfnt
+    bool is_woff = check_tag( font_data, "wOFF" );
+    if ( is_woff || check_tag( font_data, "wOF2" ) ) {
+        StatsTimer st( "woff decode" );
+        bool res = is_woff ? woff_decode( font_data, font_size, *this ) : woff2_decode( font_data, font_size, *this );
+        if ( !res ) {
+            error = FontError::BadContainer;
+            return false;
+        }
+        data = sfnt.data();
+        size = sfnt.size();
+    } else {
+        if ( !is_font( font_data ) && !check_tag( font_data, "ttcf" ) ) return false;
+        data = font_data;
+        size = font_size;
+    }
+    error = FontError::None;
+    return true;
+}
+
+int FontFile::face_count() const {
+    if ( check_tag( data, "ttcf" ) ) {
+        // Face offsets have to be inside of the file
+        uint32_t count = ttf_u32( data + 8 );
+        return ( size - 12 ) / 4 >= count ? count : 0;
+    }
+    return 1;
+}
+
+const uint8_t* FontFile::face( int face_index ) const {
+    if ( face_index < 0 || face_index >= face_count() ) return nullptr;
+    uint32_t dir_offset = 0;
+    if ( check_tag( data, "ttcf" ) ) {
+        dir_offset = ttf_u32( data + 12 + face_index * 4 );
+    }
+    TtfSpan dir = TtfSpan( data, size ).sub( dir_offset );
+    if ( !dir.has( 0, 12 ) || !dir.has( 12, dir.u16( 4 ) * 16 ) ) return nullptr;
+    return is_font( dir.data ) ? dir.data : nullptr;
+}
+
+// Table offsets are relative to the file start, the table directory of a collection face is elsewhere
+
+TtfSpan FontFile::find_table( const uint8_t *dir, const char *tag ) const {
+    uint32_t num_tables = ttf_u16( dir + 4 );
+    const uint8_t *table = dir + 12;
+
+    for ( uint32_t itbl = 0; itbl < num_tables; ++itbl ) {
+        if ( check_tag( table, tag ) ) {
+            uint32_t offset = ttf_u32( table + 8 );
+            uint32_t length = ttf_u32( table + 12 );
+            return TtfSpan( data, size ).sub( offset, length );
+        }
+        table += 16;
+    }
+
+    return TtfSpan();
 }
 
+bool Font::load_ttf_file( const char *filename, int face_index ) {
+    FontFile file;
+    if ( !file.load( filename ) ) {
+        error = file.error;
+        return false;
+    }
+    return load_face( file, face_index );
+}
 
-bool Font::load_ttf_mem( const uint8_t *ttf ) {
+bool Font::load_ttf_mem( const uint8_t *ttf, size_t size, int face_index ) {
+    FontFile file;
+    if ( !file.init( ttf, size ) ) {
+        error = file.error;
+        return false;
+    }
+    return load_face( file, face_index );
+}
+
+bool Font::load_face( FontFile& file, int face_index ) {
+    StatsTimer st( "ttf load" );
+
+    const uint8_t *ttf = file.data;
+    error = FontError::NotFont;
     if ( ttf == nullptr ) return false;
-    if ( !is_font( ttf ) ) return false;
+    error = FontError::NoFace;
+    const uint8_t *dir = file.face( face_index );
+    if ( !dir ) return false;
 
     uint32_t num_glyphs = 0xffff;
 
-    const uint8_t *head = find_table( ttf, "head" );
-    if ( !head ) return false;
+    error = FontError::MissingTable;
+    TtfSpan head = file.find_table( dir, "head" );
+    TtfSpan hmtx = file.find_table( dir, "hmtx" );
+    TtfSpan hhea = file.find_table( dir, "hhea" );
+    TtfSpan cmap = file.find_table( dir, "cmap" );
+    if ( !head || !hmtx || !hhea || !cmap ) return false;
+    error = FontError::BadTable;
+    if ( head.size < 54 || hhea.size < 36 ) return false;
 
-    uint16_t loc_format = ttf_u16( head + 50 );
+    uint16_t loc_format = ttf_u16( head.data + 50 );
     // 0 - 16 bit offset
     // 1 - 32 bit offset
     // >1 - unsupported
-    if ( loc_format > 1 ) return false;
     bool is_loc32 = loc_format;
 
-    const uint8_t *loca = find_table( ttf, "loca" );
-    if ( !loca ) return false;
+    // TrueType outlines in "glyf" (WOFF2 transformed "glyf" has no "loca"),
+    // otherwise CFF outlines in "CFF " or "CFF2"
+    TtfSpan loca = file.find_table( dir, "loca" );
+    TtfSpan glyf = file.find_table( dir, "glyf" );
+    TtfSpan cff  = file.find_table( dir, "CFF " );
+    TtfSpan cff2 = file.find_table( dir, "CFF2" );
+    auto woff2_glyf = glyf ? file.woff2_glyf.find( glyf.data - ttf ) : file.woff2_glyf.end();
+    bool is_woff2 = woff2_glyf != file.woff2_glyf.end();
+    bool is_cff = !is_woff2 && !( loca && glyf );
+
+    error = FontError::Unsupported;
+    if ( !is_woff2 && !is_cff && loc_format > 1 ) return false;
+    error = FontError::MissingTable;
+    if ( is_cff && !cff && !cff2 ) return false;
+
+    TtfSpan maxp = file.find_table( dir, "maxp" );
+    if ( maxp.has( 4, 2 ) ) num_glyphs = ttf_u16( maxp.data + 4 );
+
+    ascent  = ttf_i16( hhea.data + 4 );
+    descent = ttf_i16( hhea.data + 6 );
+    line_gap = ttf_i16( hhea.data + 8 );
+
+    uint32_t num_hmtx = ttf_u16( hhea.data + 34 );
+
+    // Normalized axis coordinates of a variable font instance, empty for the default one
+    std::vector<float> coords;
+    if ( !var_normalize( file.find_table( dir, "fvar" ), file.find_table( dir, "avar" ), variations, coords ) ) {
+        error = FontError::UnknownAxis;
+        return false;
+    }
+    GlyphVariations glyph_var;
+    bool has_gvar = !coords.empty() && !is_cff && glyph_var.init( file.find_table( dir, "gvar" ), coords );
+    const GlyphVariations *var = has_gvar ? &glyph_var : nullptr;
+
+    // Filling glyph idx mappings, cmap may be shared by the faces of a collection
+    auto cached_cmap = file.cmaps.find( cmap.data - ttf );
+    if ( cached_cmap != file.cmaps.end() ) {
+        glyph_map = cached_cmap->second;
+        stats.count( "shared tables", 1 );
+    } else {
+        int cmap_span = stats.begin( "cmap fill" );
+        bool cmap_res = fill_cmap( *this, cmap );
+        stats.end( cmap_span );
+        if ( !cmap_res ) {
+            error = FontError::Unsupported;
+            return false;
+        }
+        file.cmaps[ cmap.data - ttf ] = glyph_map;
+    }
 
-    const uint8_t *hmtx = find_table( ttf, "hmtx" );
-    if ( !hmtx ) return false;
+    // Cubic curves are approximated to a fraction of the target pixel
+    float fheight = ascent - descent;
+    float cubic_tolerance = cff_tolerance_px * fheight / ( pixel_height > 0.0f ? pixel_height : fheight );
 
-    const uint8_t *glyf = find_table( ttf, "glyf" );
-    if ( !glyf ) return false;
+    // Reading glyph display lists while calculating glyph max bounding box,
+    // outlines may be shared by the faces of a collection
 
-    const uint8_t *maxp = find_table( ttf, "maxp" );
-    if ( maxp ) num_glyphs = ttf_u16( maxp + 4 );
+    TtfSpan outline_table = is_cff ? ( cff ? cff : cff2 ) : glyf;
+    FontFile::OutlinesKey outlines_key = std::make_tuple( (uint32_t) ( outline_table.data - ttf ),
+                                                          is_cff || is_woff2 ? 0u : (uint32_t) ( loca.data - ttf ),
+                                                          num_glyphs,
+                                                          is_cff ? cubic_tolerance : 0.0f,
+                                                          coords );
+    auto cached_outlines = file.outlines.find( outlines_key );
 
-    const uint8_t *hhea = find_table( ttf, "hhea" );
-    if ( !hhea ) return false;
-    ascent  = ttf_i16( hhea + 4 );
-    descent = ttf_i16( hhea + 6 );
-    line_gap = ttf_i16( hhea + 8 );
+    if ( cached_outlines != file.outlines.end() ) {
+        stats.count( "shared tables", 1 );
+    } else {
+        FontOutlines fo;
+        CffFont cff_font;
+        if ( is_cff ) {
+            if ( !cff_font.init( outline_table, !cff, num_glyphs, coords ) ) {
+                error = FontError::BadTable;
+                return false;
+            }
+            num_glyphs = std::min<uint32_t>( num_glyphs, cff_font.char_strings.count() );
+        }
 
-    uint32_t num_hmtx = ttf_u16( hhea + 34 );
+        fo.glyphs = std::vector<Glyph>( num_glyphs, Glyph{} );
+        if ( var ) fo.metric_deltas.assign( num_glyphs, F2{ 0.0f } );
+
+        // Reading simple glyph display listd and components for composite glyphs
+        int decode_span = stats.begin( "glyph decode" );
+        if ( is_woff2 ) {
+            fo.glyphs.clear();
+            bool woff2_res = woff2_decode_glyf( glyf.data, woff2_glyf->second, var, fo );
+            stats.end( decode_span );
+            if ( !woff2_res ) {
+                error = FontError::BadTable;
+                return false;
+            }
+        } else {
+            bool glyf_res = true;
+            if ( is_cff ) {
+                cff_decode( fo, cff_font, cubic_tolerance, threads );
+            } else {
+                glyf_res = glyf_decode( fo, is_loc32, loca, glyf, var, threads, checked_reads );
+            }
+            stats.end( decode_span );
+            if ( !glyf_res ) {
+                error = FontError::BadTable;
+                return false;
+            }
+        }
+
+        // Calculating composite glyph commands
+        int composite_span = stats.begin( "composite expansion" );
+        glyf_expand_composites( fo );
+        stats.end( composite_span );
 
-    // Filling glyph idx mappings
-    if ( !fill_cmap( *this, ttf ) ) return false;
+        int contour_span = stats.begin( "contour index" );
+        index_contours( fo );
+        stats.end( contour_span );
 
-    glyphs = std::vector<Glyph>( num_glyphs, Glyph{} );
+        cached_outlines = file.outlines.emplace( outlines_key, std::move( fo ) ).first;
+    }
+
+    const FontOutlines& fo = cached_outlines->second;
+    glyphs           = fo.glyphs;
+    glyph_commands   = fo.commands;
+    glyph_points     = fo.points;
+    glyph_contours   = fo.contours;
+    glyph_components = fo.components;
+    glyph_min        = fo.glyph_min;
+    glyph_max        = fo.glyph_max;
+    num_glyphs       = glyphs.size();
 
     // These glyphs have both advance with and left side bearing in "hmtx" table
+    num_hmtx = std::min( num_hmtx, num_glyphs );
+    if ( !hmtx.has( 0, num_hmtx * 4 ) ) {
+        error = FontError::BadTable;
+        return false;
+    }
     for ( size_t iglyph = 0; iglyph < num_hmtx; ++iglyph ) {
-        glyphs[ iglyph ].advance_width     = ttf_u16( hmtx + iglyph * 4 );
-        glyphs[ iglyph ].left_side_bearing = ttf_i16( hmtx + iglyph * 4 + 2 );
+        glyphs[ iglyph ].advance_width     = ttf_u16( hmtx.data + iglyph * 4 );
+        glyphs[ iglyph ].left_side_bearing = ttf_i16( hmtx.data + iglyph * 4 + 2 );
     }
-    // Rest of glyphs have left side bearing only
+    // Rest of glyphs have left side bearing only, 0 if the table is cut short
     for ( size_t iglyph = 0; iglyph < ( num_glyphs - num_hmtx ); ++iglyph ) {
-        const uint8_t *pos = hmtx + num_hmtx * 4 + iglyph * 2;
         glyphs[iglyph + num_hmtx].advance_width = 0.0f;
-        glyphs[iglyph + num_hmtx].left_side_bearing = ttf_i16(pos);
+        glyphs[iglyph + num_hmtx].left_side_bearing = hmtx.i16( num_hmtx * 4 + iglyph * 2 );
     }
 
-    // Reading glyph display lists while calculating glyph max bounding box
-
-    glyph_min = F2 { 2e38f };
-    glyph_max = F2 { -2e38f };
-
-    // Reading simple glyph display listd and components for composite glyphs
-    for ( size_t iglyph = 0; iglyph < num_glyphs; ++iglyph ) {
-        glyph_shape( *this, iglyph, is_loc32, loca, glyf);
-        glyph_min = min( glyph_min, glyphs[iglyph].min );
-        glyph_max = max( glyph_max, glyphs[iglyph].max );        
+    // Variable font metrics: advances from "HVAR" if present, otherwise from the "gvar" phantom points.
+    // CFF2 glyphs have no phantom points, the origin stays in place.
+    if ( !coords.empty() ) {
+        TtfSpan hvar = file.find_table( dir, "HVAR" );
+        ItemVariationStore hvar_store;
+        bool has_hvar = hvar && hvar_store.init( hvar.sub( hvar.u32( 4 ) ), coords );
+        for ( size_t iglyph = 0; iglyph < num_glyphs; ++iglyph ) {
+            Glyph& g = glyphs[ iglyph ];
+            F2 metric_delta = fo.metric_deltas.empty() ? F2{ 0.0f } : fo.metric_deltas[ iglyph ];
+            g.advance_width += has_hvar ? hvar_advance_delta( hvar, hvar_store, iglyph ) : metric_delta.y;
+            if ( is_cff ) {
+                if ( g.command_count > 0 ) g.left_side_bearing = g.min.x;
+            } else {
+                g.left_side_bearing += metric_delta.x;
+            }
+        }
     }
 
-    // Calculating composite glyph commands
-    for ( size_t iglyph = 0; iglyph < num_glyphs; ++iglyph ) {
-        glyph_commands_composite( *this, iglyph );
-    }
+    stats.count( "font glyphs", num_glyphs );
+    stats.count( "font commands", glyph_commands.size() );
+    stats.count( "font points", glyph_points.size() );
 
     // Reading glyph types
     for ( const std::pair<uint32_t, int>& cgpair : glyph_map ) {
         uint32_t codepoint = cgpair.first;
         int iglyph = cgpair.second;
-        if ( iglyph < 0 ) continue;
+        if ( iglyph < 0 || iglyph >= (int) num_glyphs ) continue;
         Glyph& g = glyphs[ iglyph ];
         if ( iswlower( codepoint ) ) g.char_type = Glyph::Lower;
         if ( iswupper( codepoint ) | iswdigit( codepoint ) ) g.char_type = Glyph::Upper;
@@ -689,10 +1475,18 @@ bool Font::load_ttf_mem( const uint8_t *ttf ) {
         if ( iswspace( codepoint ) ) g.char_type = Glyph::Space;
     }
 
-    // Some fonts store kerning information in "kern" table, reading it
-    fill_kern( *this, ttf);
-
-    // TODO Other fonts store kerning information in "gpos" table
+    // Kerning from GPOS pair adjustments, older fonts have "kern" table only
+    int kern_span = stats.begin( "kerning" );
+    // GPOS adjustments of a variable font instance are varied through "GDEF" version 1.3
+    TtfSpan gdef = file.find_table( dir, "GDEF" );
+    ItemVariationStore gdef_store;
+    bool has_gdef_var = !coords.empty() && gdef.u32( 0 ) >= 0x00010003 && gdef.u32( 14 ) &&
+                        gdef_store.init( gdef.sub( gdef.u32( 14 ) ), coords );
+    if ( !fill_gpos_kern( *this, file.find_table( dir, "GPOS" ), has_gdef_var ? &gdef_store : nullptr ) ) {
+        fill_kern( *this, file.find_table( dir, "kern" ) );
+    }
+    stats.end( kern_span );
         
+    error = FontError::None;
     return true;    
 }
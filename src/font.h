@@ -22,9 +22,13 @@
 
 #pragma once
 
+#include <cstdint>
+#include <map>
+#include <tuple>
 #include <vector>
 #include <unordered_map>
 #include "float2.h"
+#include "font_var.h"
 #include "mat2d.h"
 
 
@@ -39,8 +43,19 @@ struct Glyph {
     F2 min = F2{ 0.0f };
     F2 max = F2{ 0.0f };
 
+    // Display list: commands and their points
     int command_start = 0;
     int command_count = 0;
+    int point_start   = 0;
+    int point_count   = 0;
+
+    // Display list translation, composite glyphs with a single translated component
+    // use the commands of the component glyph
+    F2  command_offset = F2{ 0.0f };
+
+    // Contours of the display list, shared with the display list
+    int contour_start = 0;
+    int contour_count = 0;
 
     bool is_composite = false;
 
@@ -49,13 +64,29 @@ struct Glyph {
 };
 
 
-struct GlyphCommand {
-    enum Type {
-        MoveTo, LineTo, BezTo, ClosePath
-    } type = MoveTo;
+// Display list command, one byte per command. The points are kept in a separate array
+// in command order: MoveTo and LineTo - end point, BezTo - control point and end point,
+// ClosePath - none.
+
+enum class GlyphCommand : uint8_t {
+    MoveTo, LineTo, BezTo, ClosePath
+};
+
+inline int command_points( GlyphCommand command ) {
+    return command == GlyphCommand::BezTo ? 2 : command == GlyphCommand::ClosePath ? 0 : 1;
+}
+
+
+// Closed contour of a display list, from MoveTo to ClosePath
+
+struct GlyphContour {
+    int command_start = 0;
+    int command_count = 0;
+    int point_start   = 0;
+    int point_count   = 0;
 
-    F2 p0 = F2{ 0.0f };
-    F2 p1 = F2{ 0.0f };
+    // Signed area of the control polygon, positive for counter-clockwise contours
+    float area = 0.0f;
 };
 
 
@@ -65,10 +96,146 @@ struct GlyphComponent {
 };
 
 
+// Pair adjustment subtable of a GPOS kerning lookup, horizontal advances only.
+// Format 1 keeps sorted glyph pairs, format 2 keeps glyph classes and a dense
+// class1 x class2 matrix instead of expanding classes into glyph pairs.
+
+struct KernSubtable {
+    // Format 1: ( left_glyph << 16 | right_glyph ), sorted
+    std::vector<uint32_t> pairs;
+    std::vector<int16_t>  pair_values;
+
+    // Format 2: glyph index -> class, no_class for the left glyphs not in coverage
+    static const uint16_t no_class = 0xffff;
+    std::vector<uint16_t> class1;
+    std::vector<uint16_t> class2;
+    uint16_t              class1_count = 0;
+    uint16_t              class2_count = 0;
+    std::vector<int16_t>  class_values;
+
+    bool is_class_based() const { return !class1.empty(); }
+
+    uint16_t left_class( int glyph ) const {
+        return glyph < (int) class1.size() ? class1[ glyph ] : no_class;
+    }
+
+    uint16_t right_class( int glyph ) const {
+        return glyph < (int) class2.size() ? class2[ glyph ] : 0;
+    }
+
+    // Returns false if the subtable doesn't apply to the pair
+    bool find( int left, int right, int *value ) const;
+};
+
+// Lookup adjustments add up, in a lookup the first applicable subtable wins
+struct KernLookup {
+    std::vector<KernSubtable> subtables;
+};
+
+
+// Reasons of a failed font load, FontFile::error and Font::error
+
+enum class FontError {
+    None,
+    FileRead,           // File can't be read
+    NotFont,            // Not a TrueType, OpenType, collection, WOFF or WOFF2 file
+    BadContainer,       // Malformed WOFF or WOFF2 data
+    BadDirectory,       // Collection header or table directory outside of the file
+    NoFace,             // Face index out of range
+    MissingTable,       // Required table is missing or outside of the file
+    BadTable,           // Table too short or with offsets out of range
+    Unsupported,        // No Unicode cmap, unknown "loca" or charstring format
+    UnknownAxis         // Variation axis not in "fvar"
+};
+
+const char* font_error_string( FontError error );
+
+
+// Decoded "glyf" or CFF outlines, metrics from "hmtx" are not included
+
+struct FontOutlines {
+    std::vector<Glyph>          glyphs;
+    std::vector<GlyphCommand>   commands;
+    std::vector<F2>             points;
+    std::vector<GlyphContour>   contours;
+    std::vector<GlyphComponent> components;
+    F2                          glyph_min, glyph_max;
+
+    // Variable font instance: ( left side bearing, advance width ) deltas per glyph
+    // from the "gvar" phantom points, empty at the default instance
+    std::vector<F2>             metric_deltas;
+};
+
+
+// TrueType outline helpers shared by the "glyf" and WOFF2 glyph stream decoders
+
+// Sets the display list of a simple glyph from points with on-curve flags, end_pts are
+// the last point indices. Variation deltas move the points and update the bounding box.
+void glyf_simple_glyph( FontOutlines& fo, int glyph_idx, std::vector<F2>& points, const std::vector<uint8_t>& on_curve,
+                        const std::vector<uint16_t>& end_pts, const GlyphVariations *var );
+
+// Reads component records of a composite glyph, returns the position after the records,
+// nullptr if the records run past end
+const uint8_t* glyf_components( const uint8_t *pos, const uint8_t *end, Glyph& glyph,
+                                std::vector<GlyphComponent>& components, bool *has_instructions );
+
+// Moves the components of a composite glyph by variation deltas
+void glyf_vary_components( FontOutlines& fo, int glyph_idx, const GlyphVariations& var );
+
+// Builds composite glyph display lists and the maximum bounding box
+void glyf_expand_composites( FontOutlines& outlines );
+
+// Splits display lists into contours and finds their signed areas
+void index_contours( FontOutlines& outlines );
+
+
+// Font file contents. Faces of a TrueType collection (.ttc) have their own table
+// directories but often point to the same outline and cmap tables, decoded tables
+// are kept here by file offset and reused by the faces loaded later.
+// WOFF and WOFF2 files are unpacked to sfnt, WOFF2 transformed "glyf" tables
+// are kept as is and decoded to outlines directly without rebuilding "glyf" and "loca".
+
+struct FontFile {
+    std::vector<uint8_t> storage;     // File contents
+    std::vector<uint8_t> sfnt;        // Unpacked WOFF data
+    const uint8_t       *data = nullptr;
+    size_t               size = 0;
+    FontError            error = FontError::None;
+
+    // ( outline table offset, loca offset, glyph count, cubic tolerance, variation coordinates ) -> outlines
+    typedef std::tuple<uint32_t, uint32_t, uint32_t, float, std::vector<float>> OutlinesKey;
+    std::map<OutlinesKey, FontOutlines>                     outlines;
+
+    // WOFF2 transformed "glyf" tables: offset -> length
+    std::map<uint32_t, uint32_t>                            woff2_glyf;
+
+    // cmap table offset -> glyph map
+    std::map<uint32_t, std::unordered_map<uint32_t, int>>   cmaps;
+
+    bool load( const char *filename );
+
+    // Uses the font data in place, WOFF data is unpacked
+    bool init( const uint8_t *font_data, size_t font_size );
+
+    // Number of faces, 1 for a single font file
+    int face_count() const;
+
+    // Table directory of the face with the table records inside of the file,
+    // nullptr if there is no such face
+    const uint8_t* face( int face_index ) const;
+
+    // Table of the face directory, no data if the table is missing or not inside of the file
+    TtfSpan find_table( const uint8_t *dir, const char *tag ) const;
+};
+
+
 struct Font {
-    // Kerning map: ( left_codepoint << 16 & right_codepoint ) -> kerning advance distance
+    // Legacy "kern" table: ( left_glyph << 16 | right_glyph ) -> kerning advance distance
     std::unordered_map<uint32_t, float>  kern_map;
 
+    // Lookups of the GPOS "kern" feature, kern_map is not used if present
+    std::vector<KernLookup>              kern_lookups;
+
     // Glyph map: codepoint -> glyph index 
     std::unordered_map<uint32_t, int>    glyph_map;
 
@@ -78,6 +245,12 @@ struct Font {
     // Array of glyph display commands
     std::vector<GlyphCommand>            glyph_commands;
 
+    // Array of display command points
+    std::vector<F2>                      glyph_points;
+
+    // Array of display list contours
+    std::vector<GlyphContour>            glyph_contours;
+
     // Array of composite glyph indices
     std::vector<GlyphComponent>          glyph_components;
 
@@ -87,9 +260,29 @@ struct Font {
     // Glyph maximum bounding box
     F2    glyph_min, glyph_max;
 
-    bool load_ttf_file( const char *filename );
+    // Target height of ascent - descent in pixels, 0 if unknown (one pixel per font unit is assumed).
+    // Sets the error tolerance of the cubic curve approximation of CFF outlines.
+    float pixel_height = 0.0f;
 
-    bool load_ttf_mem( const uint8_t *ttf );
+    // Axis values of a variable font instance, the default instance if empty
+    std::vector<VarAxisValue> variations;
+
+    // Glyph outline decoding threads, 0 - number of cores
+    int threads = 0;
+
+    // Simple "glyf" glyphs check every flag and coordinate read instead of validating their sizes once,
+    // for the decoding benchmark
+    bool checked_reads = false;
+
+    // Set when loading fails
+    FontError error = FontError::None;
+
+    bool load_ttf_file( const char *filename, int face_index = 0 );
+
+    bool load_ttf_mem( const uint8_t *ttf, size_t size, int face_index = 0 );
+
+    // Font has to be empty, decoded tables are shared through the font file
+    bool load_face( FontFile& file, int face_index );
 
     // Find glyph index by codepoint
     int glyph_idx( uint32_t codepoint ) const {
@@ -97,5 +290,8 @@ struct Font {
         return iter == glyph_map.end() ? -1 : iter->second;
     }
 
-    int kern_advance( uint32_t cp1, uint32_t cp2 );
+    // Kerning advance in font units
+    int kern_advance( uint32_t cp1, uint32_t cp2 ) const;
+
+    int glyph_kern_advance( int left, int right ) const;
 };
@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "font_var.h"
+#include "ttf_read.h"
+
+#include <algorithm>
+#include <cmath>
+
+inline float f2dot14( const uint8_t *p ) { return ttf_i16( p ) / 16384.0f; }
+
+inline float fixed16( const uint8_t *p ) { return ttf_i32( p ) / 65536.0f; }
+
+
+
+// Axis normalization
+
+bool var_normalize( TtfSpan fvar, TtfSpan avar, const std::vector<VarAxisValue>& values, std::vector<float>& coords ) {
+    coords.clear();
+
+    uint16_t axes_offset = fvar.u16( 4 );
+    uint16_t axis_count  = fvar.u16( 8 );
+    uint16_t axis_size   = fvar.u16( 10 );
+    if ( axis_size < 16 || !fvar.has( axes_offset, (size_t) axis_count * axis_size ) ) axis_count = 0;
+    const uint8_t *axes = fvar.data + axes_offset;
+
+    for ( const VarAxisValue& av : values ) {
+        bool found = false;
+        for ( uint32_t iaxis = 0; iaxis < axis_count; ++iaxis ) {
+            found = found || ttf_u32( axes + iaxis * axis_size ) == av.tag;
+        }
+        if ( !found ) return false;
+    }
+
+    std::vector<float> res( axis_count, 0.0f );
+    bool is_default = true;
+
+    for ( uint32_t iaxis = 0; iaxis < axis_count; ++iaxis ) {
+        const uint8_t *axis = axes + iaxis * axis_size;
+        uint32_t tag  = ttf_u32( axis );
+        float    vmin = fixed16( axis + 4 );
+        float    vdef = fixed16( axis + 8 );
+        float    vmax = fixed16( axis + 12 );
+
+        float value = vdef;
+        for ( const VarAxisValue& av : values ) {
+            if ( av.tag == tag ) value = av.value;
+        }
+        value = std::min( std::max( value, vmin ), vmax );
+
+        float c = 0.0f;
+        if ( value < vdef ) c = ( value - vdef ) / ( vdef - vmin );
+        if ( value > vdef ) c = ( value - vdef ) / ( vmax - vdef );
+        res[ iaxis ] = c;
+    }
+
+    // Piecewise linear "avar" segment maps
+    if ( avar.u16( 6 ) == axis_count ) {
+        size_t map = 8;
+        for ( uint32_t iaxis = 0; iaxis < axis_count; ++iaxis ) {
+            uint16_t count = avar.u16( map );
+            if ( !avar.has( map + 2, count * 4 ) ) break;
+            const uint8_t *pairs = avar.data + map + 2;
+            float c = res[ iaxis ];
+            for ( uint32_t i = 1; i < count; ++i ) {
+                float from0 = f2dot14( pairs + i * 4 - 4 ), to0 = f2dot14( pairs + i * 4 - 2 );
+                float from1 = f2dot14( pairs + i * 4 ),     to1 = f2dot14( pairs + i * 4 + 2 );
+                if ( c <= from1 ) {
+                    res[ iaxis ] = from1 > from0 ? to0 + ( to1 - to0 ) * ( c - from0 ) / ( from1 - from0 ) : to1;
+                    break;
+                }
+            }
+            map += 2 + count * 4;
+        }
+    }
+
+    // Coordinates are stored in 2.14 format
+    for ( float& c : res ) {
+        c = std::round( c * 16384.0f ) / 16384.0f;
+        is_default = is_default && c == 0.0f;
+    }
+
+    if ( !is_default ) coords = res;
+    return true;
+}
+
+
+
+// Item variation store
+
+// Scalar of a region given by start, peak and end per axis
+static float region_scalar( const float *coords, int axis_count, const uint8_t *region ) {
+    float scalar = 1.0f;
+    for ( int iaxis = 0; iaxis < axis_count; ++iaxis ) {
+        float start = f2dot14( region + iaxis * 6 );
+        float peak  = f2dot14( region + iaxis * 6 + 2 );
+        float end   = f2dot14( region + iaxis * 6 + 4 );
+        float c = coords[ iaxis ];
+
+        if ( start > peak || peak > end ) continue;
+        if ( start < 0.0f && end > 0.0f && peak != 0.0f ) continue;
+        if ( peak == 0.0f || c == peak ) continue;
+        if ( c <= start || c >= end ) return 0.0f;
+        scalar *= c < peak ? ( c - start ) / ( peak - start ) : ( end - c ) / ( end - peak );
+    }
+    return scalar;
+}
+
+// Delta row size of item variation data. Word deltas come first,
+// 32 and 16 bit with the long words flag, 16 and 8 bit otherwise
+static size_t ivd_row_size( uint16_t word_count, uint16_t index_count ) {
+    bool     long_words = word_count & 0x8000;
+    uint32_t words = word_count & 0x7fff;
+    return long_words ? words * 4 + ( index_count - words ) * 2
+                      : words * 2 + ( index_count - words );
+}
+
+bool ItemVariationStore::init( TtfSpan store, const std::vector<float>& coords ) {
+    data.clear();
+    scalars.clear();
+    if ( store.u16( 0 ) != 1 ) return false;
+
+    TtfSpan regions  = store.sub( store.u32( 2 ) );
+    int axis_count   = regions.u16( 0 );
+    int region_count = regions.u16( 2 );
+    if ( !regions.has( 4, (size_t) region_count * axis_count * 6 ) ) return false;
+    if ( !coords.empty() && axis_count != (int) coords.size() ) return false;
+
+    uint16_t data_count = store.u16( 6 );
+    if ( !store.has( 8, data_count * 4 ) ) return false;
+    data.resize( data_count );
+    scalars.resize( data_count );
+    for ( uint32_t idata = 0; idata < data_count; ++idata ) {
+        TtfSpan ivd = store.sub( ttf_u32( store.data + 8 + idata * 4 ) );
+        uint16_t item_count  = ivd.u16( 0 );
+        uint16_t word_count  = ivd.u16( 2 );
+        uint16_t index_count = ivd.u16( 4 );
+        if ( ( word_count & 0x7fff ) > index_count ) return false;
+        if ( !ivd.has( 6, index_count * 2 + item_count * ivd_row_size( word_count, index_count ) ) ) return false;
+        data[ idata ] = ivd.data;
+
+        scalars[ idata ].assign( index_count, 0.0f );
+        if ( coords.empty() ) continue;
+        for ( uint32_t i = 0; i < index_count; ++i ) {
+            int iregion = ttf_u16( ivd.data + 6 + i * 2 );
+            if ( iregion >= region_count ) continue;
+            scalars[ idata ][ i ] = region_scalar( coords.data(), axis_count, regions.data + 4 + iregion * axis_count * 6 );
+        }
+    }
+    return true;
+}
+
+float ItemVariationStore::delta( uint32_t outer, uint32_t inner ) const {
+    if ( outer >= scalars.size() ) return 0.0f;
+    const uint8_t *ivd = data[ outer ];
+    uint16_t item_count  = ttf_u16( ivd );
+    uint16_t word_count  = ttf_u16( ivd + 2 );
+    uint16_t index_count = ttf_u16( ivd + 4 );
+    if ( inner >= item_count ) return 0.0f;
+
+    bool     long_words = word_count & 0x8000;
+    uint32_t words = word_count & 0x7fff;
+    const uint8_t *row = ivd + 6 + index_count * 2 + inner * ivd_row_size( word_count, index_count );
+
+    const std::vector<float>& s = scalars[ outer ];
+    float delta = 0.0f;
+    for ( uint32_t i = 0; i < index_count; ++i ) {
+        int32_t d;
+        if ( i < words ) {
+            d = long_words ? ttf_i32( row ) : ttf_i16( row );
+            row += long_words ? 4 : 2;
+        } else {
+            d = long_words ? ttf_i16( row ) : (int8_t) *row;
+            row += long_words ? 2 : 1;
+        }
+        delta += s[ i ] * d;
+    }
+    return delta;
+}
+
+float hvar_advance_delta( TtfSpan hvar, const ItemVariationStore& ivs, int glyph_idx ) {
+    uint32_t outer = 0, inner = glyph_idx;
+
+    // Delta set index map, the last entry applies to the glyphs past the end
+    uint32_t map_offset = hvar.u32( 8 );
+    if ( map_offset ) {
+        TtfSpan  map          = hvar.sub( map_offset );
+        uint8_t  format       = map.u8( 0 );
+        uint8_t  entry_format = map.u8( 1 );
+        uint32_t map_count    = format == 0 ? map.u16( 2 ) : map.u32( 2 );
+        size_t   entries      = format == 0 ? 4 : 6;
+        if ( map_count == 0 ) return 0.0f;
+
+        int    entry_size = ( ( entry_format >> 4 ) & 3 ) + 1;
+        int    inner_bits = ( entry_format & 0x0f ) + 1;
+        size_t entry_pos  = entries + (size_t) std::min<uint32_t>( glyph_idx, map_count - 1 ) * entry_size;
+        if ( !map.has( entry_pos, entry_size ) ) return 0.0f;
+        const uint8_t *entry = map.data + entry_pos;
+        uint32_t value = 0;
+        for ( int i = 0; i < entry_size; ++i ) value = ( value << 8 ) | entry[ i ];
+        outer = value >> inner_bits;
+        inner = value & ( ( 1u << inner_bits ) - 1 );
+    }
+
+    return ivs.delta( outer, inner );
+}
+
+
+
+// Glyph variations
+
+bool GlyphVariations::init( TtfSpan gvar, const std::vector<float>& coords ) {
+    this->gvar   = gvar;
+    this->coords = coords;
+
+    // Glyph data offsets and shared tuples are checked once
+    size_t offsets_size = ( gvar.u16( 12 ) + 1 ) * ( ( gvar.u16( 14 ) & 1 ) ? 4 : 2 );
+    size_t shared_size  = gvar.u16( 6 ) * coords.size() * 2;
+    return gvar.u16( 4 ) == coords.size() && gvar.has( 20, offsets_size ) &&
+           gvar.has( gvar.u32( 8 ), shared_size ) && gvar.u32( 16 ) <= gvar.size;
+}
+
+// Scalar of a tuple, intermediate is nullptr if the tuple has no intermediate region
+static float tuple_scalar( const std::vector<float>& coords, const uint8_t *peak, const uint8_t *intermediate ) {
+    float scalar = 1.0f;
+    int axis_count = coords.size();
+    for ( int iaxis = 0; iaxis < axis_count; ++iaxis ) {
+        float p = f2dot14( peak + iaxis * 2 );
+        float c = coords[ iaxis ];
+        if ( p == 0.0f || c == p ) continue;
+        if ( intermediate ) {
+            float start = f2dot14( intermediate + iaxis * 2 );
+            float end   = f2dot14( intermediate + axis_count * 2 + iaxis * 2 );
+            if ( c <= start || c >= end ) return 0.0f;
+            scalar *= c < p ? ( c - start ) / ( p - start ) : ( end - c ) / ( end - p );
+        } else {
+            if ( c == 0.0f || c < std::min( 0.0f, p ) || c > std::max( 0.0f, p ) ) return 0.0f;
+            scalar *= c / p;
+        }
+    }
+    return scalar;
+}
+
+// Packed point numbers, empty means all points
+static const uint8_t* read_packed_points( const uint8_t *p, const uint8_t *end, std::vector<uint16_t>& points ) {
+    points.clear();
+    if ( p >= end ) return end;
+    uint32_t count = *p++;
+    if ( count & 0x80 ) {
+        if ( p >= end ) return end;
+        count = ( ( count & 0x7f ) << 8 ) | *p++;
+    }
+
+    uint16_t point = 0;
+    while ( points.size() < count && p < end ) {
+        uint8_t  control = *p++;
+        bool     words = control & 0x80;
+        uint32_t run = ( control & 0x7f ) + 1;
+        for ( uint32_t i = 0; i < run && points.size() < count; ++i ) {
+            if ( end - p < ( words ? 2 : 1 ) ) return end;
+            point += words ? ttf_u16( p ) : *p;
+            p += words ? 2 : 1;
+            points.push_back( point );
+        }
+    }
+    return p;
+}
+
+// Packed deltas, count values
+static const uint8_t* read_packed_deltas( const uint8_t *p, const uint8_t *end, size_t count, std::vector<float>& deltas ) {
+    deltas.clear();
+    while ( deltas.size() < count && p < end ) {
+        uint8_t  control = *p++;
+        uint32_t run = ( control & 0x3f ) + 1;
+        int      size = ( control & 0xc0 ) == 0xc0 ? 4 : ( control & 0x80 ) ? 0 : ( control & 0x40 ) ? 2 : 1;
+        for ( uint32_t i = 0; i < run && deltas.size() < count; ++i ) {
+            if ( end - p < size ) {
+                // Deltas cut short are 0
+                p = end;
+                break;
+            }
+            switch ( size ) {
+            case 0: deltas.push_back( 0.0f ); break;
+            case 1: deltas.push_back( (int8_t) *p ); break;
+            case 2: deltas.push_back( ttf_i16( p ) ); break;
+            case 4: deltas.push_back( ttf_i32( p ) ); break;
+            }
+            p += size;
+        }
+    }
+    deltas.resize( count, 0.0f );
+    return p;
+}
+
+// Interpolating deltas of the points between two referenced points, one coordinate at a time
+static void iup_segment( const F2 *points, F2 *deltas, int first, int last, int ref1, int ref2, int num_points ) {
+    for ( int coord = 0; coord < 2; ++coord ) {
+        float c1 = points[ ref1 ][ coord ], c2 = points[ ref2 ][ coord ];
+        float d1 = deltas[ ref1 ][ coord ], d2 = deltas[ ref2 ][ coord ];
+        if ( c1 > c2 ) {
+            std::swap( c1, c2 );
+            std::swap( d1, d2 );
+        }
+        for ( int i = first; i != last; i = i + 1 < num_points ? i + 1 : 0 ) {
+            float c = points[ i ][ coord ];
+            float d;
+            if ( c1 == c2 ) {
+                d = d1 == d2 ? d1 : 0.0f;
+            } else if ( c <= c1 ) {
+                d = d1;
+            } else if ( c >= c2 ) {
+                d = d2;
+            } else {
+                d = d1 + ( c - c1 ) * ( d2 - d1 ) / ( c2 - c1 );
+            }
+            deltas[ i ][ coord ] = d;
+        }
+    }
+}
+
+// Inferring deltas of the points not referenced by a tuple, contour by contour
+static void iup_contours( const F2 *points, F2 *deltas, const std::vector<bool>& touched, int num_points,
+                          const uint16_t *end_pts, int num_contours ) {
+    int start = 0;
+    for ( int icontour = 0; icontour < num_contours; ++icontour ) {
+        int end = end_pts[ icontour ];
+        if ( end < start || end >= num_points ) break;
+
+        // Contour points are reindexed from 0 to n - 1
+        int n = end - start + 1;
+        const F2 *cp = points + start;
+        F2       *cd = deltas + start;
+
+        int first_ref = -1;
+        for ( int i = 0; i < n; ++i ) {
+            if ( touched[ start + i ] ) { first_ref = i; break; }
+        }
+
+        if ( first_ref >= 0 ) {
+            int ref = first_ref;
+            do {
+                int next = ref + 1 < n ? ref + 1 : 0;
+                int next_ref = next;
+                while ( !touched[ start + next_ref ] ) next_ref = next_ref + 1 < n ? next_ref + 1 : 0;
+                if ( next != next_ref ) iup_segment( cp, cd, next, next_ref, ref, next_ref, n );
+                ref = next_ref;
+            } while ( ref != first_ref );
+        }
+        start = end + 1;
+    }
+}
+
+bool GlyphVariations::glyph_deltas( int glyph_idx, const F2 *points, int num_points, const uint16_t *end_pts,
+                                    int num_contours, std::vector<F2>& deltas ) const {
+    uint16_t glyph_count = ttf_u16( gvar.data + 12 );
+    if ( glyph_idx >= glyph_count ) return false;
+
+    uint16_t flags = ttf_u16( gvar.data + 14 );
+    const uint8_t *offsets = gvar.data + 20;
+    uint32_t start, end;
+    if ( flags & 1 ) {
+        start = ttf_u32( offsets + glyph_idx * 4 );
+        end   = ttf_u32( offsets + glyph_idx * 4 + 4 );
+    } else {
+        start = ttf_u16( offsets + glyph_idx * 2 ) * 2;
+        end   = ttf_u16( offsets + glyph_idx * 2 + 2 ) * 2;
+    }
+    if ( end <= start ) return false;
+
+    TtfSpan data = gvar.sub( ttf_u32( gvar.data + 16 ) ).sub( start, end - start );
+    if ( !data ) return false;
+    const uint8_t *shared_tuples = gvar.data + ttf_u32( gvar.data + 8 );
+    uint16_t shared_tuple_count = ttf_u16( gvar.data + 6 );
+    int axis_count = coords.size();
+
+    // Tuple headers are checked one by one, serialized data is read up to the end of the glyph data
+    uint16_t tuple_count = data.u16( 0 );
+    size_t   header = 4;
+    size_t   serialized = std::min<size_t>( data.u16( 2 ), data.size );
+
+    int total_points = num_points + 4;
+    deltas.assign( total_points, F2{ 0.0f } );
+
+    std::vector<uint16_t> shared_points, private_points;
+    if ( tuple_count & 0x8000 ) {
+        serialized = read_packed_points( data.data + serialized, data.end(), shared_points ) - data.data;
+    }
+
+    std::vector<float> dx, dy;
+    std::vector<F2>    tuple_deltas;
+    std::vector<bool>  touched;
+    bool varied = false;
+
+    for ( uint32_t ituple = 0; ituple < ( tuple_count & 0x0fff ); ++ituple ) {
+        uint16_t data_size   = data.u16( header );
+        uint16_t tuple_index = data.u16( header + 2 );
+        size_t   header_size = 4 + ( ( tuple_index & 0x8000 ) ? axis_count * 2 : 0 )
+                                 + ( ( tuple_index & 0x4000 ) ? axis_count * 4 : 0 );
+        if ( !data.has( header, header_size ) ) break;
+        header += 4;
+
+        const uint8_t *peak = nullptr;
+        if ( tuple_index & 0x8000 ) {
+            peak = data.data + header;
+            header += axis_count * 2;
+        } else if ( ( tuple_index & 0x0fff ) < shared_tuple_count ) {
+            peak = shared_tuples + ( tuple_index & 0x0fff ) * axis_count * 2;
+        }
+        const uint8_t *intermediate = nullptr;
+        if ( tuple_index & 0x4000 ) {
+            intermediate = data.data + header;
+            header += axis_count * 4;
+        }
+
+        const uint8_t *tuple_data = data.data + serialized;
+        serialized = std::min<size_t>( serialized + data_size, data.size );
+        const uint8_t *tuple_end  = data.data + serialized;
+
+        float scalar = peak ? tuple_scalar( coords, peak, intermediate ) : 0.0f;
+        if ( scalar == 0.0f ) continue;
+
+        const std::vector<uint16_t> *points_ref = &shared_points;
+        if ( tuple_index & 0x2000 ) {
+            tuple_data = read_packed_points( tuple_data, tuple_end, private_points );
+            points_ref = &private_points;
+        }
+        const std::vector<uint16_t>& tuple_points = *points_ref;
+        bool all_points = tuple_points.empty();
+        size_t count = all_points ? total_points : tuple_points.size();
+
+        tuple_data = read_packed_deltas( tuple_data, tuple_end, count, dx );
+        read_packed_deltas( tuple_data, tuple_end, count, dy );
+
+        if ( all_points ) {
+            for ( int i = 0; i < total_points; ++i ) deltas[ i ] += F2{ dx[ i ], dy[ i ] } * F2{ scalar };
+        } else {
+            tuple_deltas.assign( total_points, F2{ 0.0f } );
+            touched.assign( total_points, false );
+            for ( size_t i = 0; i < count; ++i ) {
+                if ( tuple_points[ i ] >= total_points ) continue;
+                tuple_deltas[ tuple_points[ i ] ] = F2{ dx[ i ], dy[ i ] };
+                touched[ tuple_points[ i ] ] = true;
+            }
+            if ( end_pts ) iup_contours( points, tuple_deltas.data(), touched, num_points, end_pts, num_contours );
+            for ( int i = 0; i < total_points; ++i ) deltas[ i ] += tuple_deltas[ i ] * F2{ scalar };
+        }
+        varied = true;
+    }
+
+    return varied;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "float2.h"
+#include "ttf_read.h"
+
+// Variable font instancing. User axis values are normalized with "fvar" and "avar",
+// glyph points are moved by "gvar" deltas, advances come from "HVAR" and CFF2 blends
+// read the same item variation store format.
+
+// Axis value in user units, e.g. wght=650
+struct VarAxisValue {
+    uint32_t tag   = 0;
+    float    value = 0.0f;
+};
+
+// Normalized coordinates in [-1, 1] per "fvar" axis, avar mapping applied.
+// Coordinates are empty when all axes are at their defaults. Returns false for an unknown axis tag,
+// malformed "fvar" has no axes, malformed "avar" is ignored.
+bool var_normalize( TtfSpan fvar, TtfSpan avar, const std::vector<VarAxisValue>& values, std::vector<float>& coords );
+
+
+// Item variation store ("HVAR", "CFF2"): region scalars are computed once per instance.
+// The delta rows are checked by init(), delta() reads them unchecked.
+
+struct ItemVariationStore {
+    // Item variation data
+    std::vector<const uint8_t*>     data;
+
+    // Item variation data -> scalars of its regions, zero at the default instance
+    std::vector<std::vector<float>> scalars;
+
+    // Returns false if the store is malformed
+    bool init( TtfSpan store, const std::vector<float>& coords );
+
+    float delta( uint32_t outer, uint32_t inner ) const;
+};
+
+// Advance width delta of the glyph from "HVAR"
+float hvar_advance_delta( TtfSpan hvar, const ItemVariationStore& ivs, int glyph_idx );
+
+
+// Glyph point deltas of "gvar"
+
+struct GlyphVariations {
+    TtfSpan            gvar;
+    std::vector<float> coords;
+
+    // Returns false if "gvar" is missing, malformed or has other axes
+    bool init( TtfSpan gvar, const std::vector<float>& coords );
+
+    // Deltas of the glyph points followed by 4 phantom points. Points not referenced by a tuple
+    // are interpolated (IUP) on the contours given by end_pts, composite glyphs pass no contours.
+    // Returns false if the glyph has no variations at this instance.
+    bool glyph_deltas( int glyph_idx, const F2 *points, int num_points, const uint16_t *end_pts,
+                       int num_contours, std::vector<F2>& deltas ) const;
+};
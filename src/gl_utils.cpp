@@ -61,6 +61,10 @@ GLuint compileShader(const char *name, const char *source, ShaderType type) {
                     fprintf(stderr, "Error compiling fragment shader '%s':\n%s\n", name, infoLog);
                     assert( false );
                     break;
+                case ComputeShader :
+                    fprintf(stderr, "Error compiling compute shader '%s':\n%s\n", name, infoLog);
+                    assert( false );
+                    break;
                 default:
                     fprintf(stderr, "Error compiling shader '%s':\n%s\n", name, infoLog);
                     assert( false );
@@ -125,6 +129,21 @@ GLuint createProgram(const char* name, const char* vertex_shader, const char* fr
     return id;
 }
 
+GLuint createComputeProgram(const char* name, const char* compute_shader) {
+    GLuint cs_id = compileShader(name, compute_shader, ComputeShader);
+    if (!cs_id) return 0;
+
+    GLuint id = glCreateProgram();
+    if (!id) return 0;
+
+    glAttachShader(id, cs_id);
+
+    bool linked = linkProgram(id);
+    if (!linked) return 0;
+
+    return id;
+}
+
 
 void deleteProgram( GLuint program ) {
     GLuint shaders[16];
@@ -25,7 +25,7 @@
 #include <GL/glew.h>
 
 enum ShaderType {
-	VertexShader = GL_VERTEX_SHADER, FragmentShader = GL_FRAGMENT_SHADER
+	VertexShader = GL_VERTEX_SHADER, FragmentShader = GL_FRAGMENT_SHADER, ComputeShader = GL_COMPUTE_SHADER
 };
 
 struct VertexAttribType {
@@ -89,6 +89,9 @@ bool linkProgram( GLuint program_id );
 
 GLuint createProgram( const char* name, const char* vertex_shader, const char* fragment_shader, VertexAttrib *attribs = nullptr, size_t attrib_count = 0, ProgramAction before_link = 0 );
 
+// Needs GL 4.3 or ARB_compute_shader
+GLuint createComputeProgram( const char* name, const char* compute_shader );
+
 void deleteProgram( GLuint program );
 
 void initUniforms( GLuint program_id, Uniform *uniform, size_t count = 1 );
@@ -78,14 +78,21 @@ void LinePainter::move_to( F2 p0 ) {
     start_pos = p0;
 }
 
-static void set_par_vertex( SdfVertex *v, const Parabola &par ) {
+F2 LinePainter::segment_limits( const Parabola& par, F2 p0, F2 p2 ) const {
+    if ( orientation == 0 ) return F2( par.xstart, par.xend );
+    bool forward = par.world_to_par( p0 ).x < par.world_to_par( p2 ).x;
+    if ( orientation < 0 ) forward = !forward;
+    return forward ? F2( par.xstart, par.xend ) : F2( par.xend, par.xstart );
+}
+
+static void set_par_vertex( SdfVertex *v, const Parabola &par, F2 limits ) {
     F2 par_pos = par.world_to_par( v->pos );
     v->par = par_pos;
-    v->limits = F2( par.xstart, par.xend );
+    v->limits = limits;
     v->scale = par.scale;
 }
 
-static void line_rect( const Parabola &par, F2 vmin, F2 vmax, float line_width, std::vector<SdfVertex> *vertices ) {
+static void line_rect( const Parabola &par, F2 limits, F2 vmin, F2 vmax, float line_width, std::vector<SdfVertex> *vertices ) {
     SdfVertex v0, v1, v2, v3;
     v0.pos = F2( vmin.x, vmin.y );
     v1.pos = F2( vmax.x, vmin.y );
@@ -97,10 +104,10 @@ static void line_rect( const Parabola &par, F2 vmin, F2 vmax, float line_width,
     v2.line_width = line_width;
     v3.line_width = line_width;
 
-    set_par_vertex( &v0, par );
-    set_par_vertex( &v1, par );
-    set_par_vertex( &v2, par );
-    set_par_vertex( &v3, par );
+    set_par_vertex( &v0, par, limits );
+    set_par_vertex( &v1, par, limits );
+    set_par_vertex( &v2, par, limits );
+    set_par_vertex( &v3, par, limits );
 
     vertices->push_back( v0 );
     vertices->push_back( v1 );
@@ -119,7 +126,7 @@ void LinePainter::line_to( F2 p1, float line_width ) {
     vmax += F2( line_width );
 
     Parabola par = Parabola::from_line( prev_pos, p1 );
-    line_rect( par, vmin, vmax, line_width, &vertices );
+    line_rect( par, segment_limits( par, prev_pos, p1 ), vmin, vmax, line_width, &straight_vertices );
     
     prev_pos = p1;
 }
@@ -152,11 +159,11 @@ void LinePainter::qbez_to( F2 p1, F2 p2, float line_width ) {
     switch ( qtype ) {
     case QbezType::Parabola:
         par = Parabola::from_qbez( p0, p1, p2 );
-        line_rect( par, vmin, vmax, line_width, &vertices );
+        line_rect( par, segment_limits( par, p0, p2 ), vmin, vmax, line_width, &vertices );
         break;
     case QbezType::Line:
         par = Parabola::from_line( p0, p2 );
-        line_rect( par, vmin, vmax, line_width, &vertices );
+        line_rect( par, segment_limits( par, p0, p2 ), vmin, vmax, line_width, &straight_vertices );
         break;
     case QbezType::TwoLines: {
         float l10 = length( v10 );
@@ -165,9 +172,9 @@ void LinePainter::qbez_to( F2 p1, F2 p2, float line_width ) {
         float nqt = 1.0f - qt;
         F2 qtop = p0 * ( nqt * nqt ) + p1 * ( 2.0f * nqt * qt ) + p2 * ( qt * qt );
         Parabola par0 = Parabola::from_line( p0, qtop );
-        line_rect( par0, vmin, vmax, line_width, &vertices );
-        Parabola par1 = Parabola::from_line( qtop, p1 );
-        line_rect( par1, vmin, vmax, line_width, &vertices ); 
+        line_rect( par0, segment_limits( par0, p0, qtop ), vmin, vmax, line_width, &straight_vertices );
+        Parabola par1 = Parabola::from_line( qtop, p2 );
+        line_rect( par1, segment_limits( par1, qtop, p2 ), vmin, vmax, line_width, &straight_vertices );
         break;
     }
     }
@@ -181,144 +188,77 @@ void LinePainter::close( float line_width ) {
     line_to( start_pos, line_width );
 }
 
-/* Used to check whether path is clockwise or counter-clockwise. */
-float GlyphPainter::getEdge(F2 startPoint, F2 endPoint) {
-    return (endPoint.x - startPoint.x) * (endPoint.y + startPoint.y);
+void LinePainter::interior( F2 vmin, F2 vmax ) {
+    SdfVertex v0, v1, v2, v3;
+    v0 = { F2( vmin.x, vmin.y ), F2( 0.0f ), F2( 0.0f ), 0.0f, 1.0f };
+    v1 = { F2( vmax.x, vmin.y ), F2( 0.0f ), F2( 0.0f ), 0.0f, 1.0f };
+    v2 = { F2( vmax.x, vmax.y ), F2( 0.0f ), F2( 0.0f ), 0.0f, 1.0f };
+    v3 = { F2( vmin.x, vmax.y ), F2( 0.0f ), F2( 0.0f ), 0.0f, 1.0f };
+
+    straight_vertices.push_back( v0 );
+    straight_vertices.push_back( v1 );
+    straight_vertices.push_back( v2 );
+
+    straight_vertices.push_back( v0 );
+    straight_vertices.push_back( v2 );
+    straight_vertices.push_back( v3 );
 }
 
-/* Glyphs may not consist out of a single connected path. In this case, split the path first and draw multiple subglyhps.
-This is necessary because for each subglaph the orientation (clockwise or counter-clockwise) has to be checked individually. */
+// Contours are drawn in the font order and orientation, the fill pass counts their winding
 void GlyphPainter::draw_glyph( const Font *font, int glyph_index, F2 pos, float scale, float sdf_size ) {
     const Glyph& g = font->glyphs[ glyph_index ];
-    if ( g.command_count == 0 ) return;
-
-    int commmandStartSubglyph = g.command_start;
-    for (int ic = g.command_start; ic < g.command_start + g.command_count; ++ic) {
-        const GlyphCommand& gc = font->glyph_commands[ic];
-        if (
-            (ic == g.command_start + g.command_count - 1) ||
-            (gc.type == GlyphCommand::ClosePath)
-        ) {
-            GlyphPainter::draw_subglyph(font, glyph_index, pos, scale, sdf_size, commmandStartSubglyph, ic);
-            commmandStartSubglyph = ic + 1;
-        }
+    pos += g.command_offset * scale;
+
+    const GlyphCommand *commands = font->glyph_commands.data() + g.command_start;
+    const F2 *points = font->glyph_points.data() + g.point_start;
+    int command_count = g.command_count;
+    int point_count = g.point_count;
+    if ( simplify > 0.0f ) {
+        simplify_outline( font, glyph_index, simplify / scale, outline );
+        commands = outline.commands.data();
+        points = outline.points.data();
+        command_count = outline.commands.size();
+        point_count = outline.points.size();
     }
-}
 
-void GlyphPainter::draw_subglyph(const Font* font, int glyph_index, F2 pos, float scale, float sdf_size, int command_start, int command_end) {
-    const Glyph& g = font->glyphs[glyph_index];
-    if (g.command_count == 0) return;
-
-    /* Determine orientation of path. */
-    float edgeSum = 0;
-    for (int ic = command_start; ic <= command_end; ++ic) {
-        const GlyphCommand& gc = font->glyph_commands[ic];
-        F2 pPrevious, pStart;
+    F2 vmin = F2( 2e38f ), vmax = F2( -2e38f );
+    for ( int ip = 0; ip < point_count; ++ip ) {
+        vmin = min( vmin, points[ ip ] );
+        vmax = max( vmax, points[ ip ] );
+    }
 
-        switch (gc.type) {
-        case GlyphCommand::MoveTo:
-            pStart = gc.p0;
-            pPrevious = gc.p0;
+    for ( int ic = 0; ic < command_count; ++ic ) {
+        switch ( commands[ ic ] ) {
+        case GlyphCommand::MoveTo: {
+            F2 p0 = *points++ * scale + pos;
+            fp.move_to( p0 );
+            lp.move_to( p0 );
             break;
-        case GlyphCommand::LineTo:
-            edgeSum += GlyphPainter::getEdge(pPrevious, gc.p0);
-            pPrevious = gc.p0;
+        }
+        case GlyphCommand::LineTo: {
+            F2 p1 = *points++ * scale + pos;
+            fp.line_to( p1 );
+            lp.line_to( p1, sdf_size );
             break;
-        case GlyphCommand::BezTo:
-            edgeSum += GlyphPainter::getEdge(pPrevious, gc.p0);
-            edgeSum += GlyphPainter::getEdge(gc.p0, gc.p1);
-            pPrevious = gc.p1;
+        }
+        case GlyphCommand::BezTo: {
+            F2 p1 = points[0] * scale + pos;
+            F2 p2 = points[1] * scale + pos;
+            fp.qbez_to( p1, p2 );
+            lp.qbez_to( p1, p2, sdf_size );
+            points += 2;
             break;
+        }
         case GlyphCommand::ClosePath:
-            edgeSum += GlyphPainter::getEdge(pPrevious, pStart);
+            fp.close();
+            lp.close( sdf_size );
             break;
         }
     }
 
-
-    F2 p0, p1, pPrevious, pStart;
-    // hack: explicit handling of subglyphs completely contained in another subglyph
-    const bool isSubglyphEnclosed = (
-        font->glyph_map.at(169) == glyph_index ||
-        font->glyph_map.at(174) == glyph_index ||
-        font->glyph_map.at(8471) == glyph_index ||
-        font->glyph_map.at(48) == glyph_index
-    );
-    if (edgeSum > 0 || isSubglyphEnclosed) {
-        /* Path is clockwise. */
-        for (int ic = command_start; ic <= command_end; ++ic) {
-            const GlyphCommand& gc = font->glyph_commands[ic];
-
-            switch (gc.type) {
-            case GlyphCommand::MoveTo:
-                p0 = gc.p0 * scale + pos;
-                fp.move_to(p0);
-                lp.move_to(p0);
-                break;
-            case GlyphCommand::LineTo:
-                p0 = gc.p0 * scale + pos;
-                fp.line_to(p0);
-                lp.line_to(p0, sdf_size);
-                break;
-            case GlyphCommand::BezTo:
-                p0 = gc.p0 * scale + pos;
-                p1 = gc.p1 * scale + pos;
-                fp.qbez_to(p0, p1);
-                lp.qbez_to(p0, p1, sdf_size);
-                break;
-            case GlyphCommand::ClosePath:
-                fp.close();
-                lp.close(sdf_size);
-                break;
-            }
-        }
-    }
-    else {
-        /* Path is counter-clockwise. It has to be drawn in reverse order so that it clockwise and counter-clockwise paths can be handled the same way by the rendering. */
-        bool hasToBeClosed = false;
-        for (int ic = command_end; ic >= command_start; --ic) {
-            /* Get the end point of the previous command. */
-            if (ic > command_start) {
-                const GlyphCommand& gcPrevious = font->glyph_commands[ic - 1];
-                switch (gcPrevious.type) {
-                case GlyphCommand::MoveTo:
-                    pPrevious = gcPrevious.p0 * scale + pos;
-                    break;
-                case GlyphCommand::LineTo:
-                    pPrevious = gcPrevious.p0 * scale + pos;
-                    break;
-                case GlyphCommand::BezTo:
-                    pPrevious = gcPrevious.p1 * scale + pos;
-                    break;
-                }
-            }
-
-            const GlyphCommand& gc = font->glyph_commands[ic];
-            switch (gc.type) {
-            case GlyphCommand::MoveTo:
-                if (hasToBeClosed) {
-                    fp.close();
-                    lp.close(sdf_size);
-                    hasToBeClosed = false;
-                }
-                break;
-            case GlyphCommand::LineTo:
-                fp.line_to(pPrevious);
-                lp.line_to(pPrevious, sdf_size);
-                break;
-            case GlyphCommand::BezTo:
-                p0 = gc.p0 * scale + pos;
-                fp.qbez_to(p0, pPrevious);
-                lp.qbez_to(p0, pPrevious, sdf_size);
-                break;
-            case GlyphCommand::ClosePath:
-                hasToBeClosed = true;
-                fp.move_to(pPrevious);
-                lp.move_to(pPrevious);
-                break;
-            }
-        }
-    }
+    // Interior texels closer than sdf_size to the bounding box are closer than that to the outline
+    // and covered by the line quads, the rest gets the interior quad. One texel of margin for rounding.
+    vmin = vmin * scale + pos + F2( sdf_size - 1.0f );
+    vmax = vmax * scale + pos - F2( sdf_size - 1.0f );
+    if ( vmin.x < vmax.x && vmin.y < vmax.y ) lp.interior( vmin, vmax );
 }
-
-
@@ -27,6 +27,8 @@
 #include "float2.h"
 #include "sdf_gl.h"
 #include "font.h"
+#include "parabola.h"
+#include "outline_simplify.h"
 
 
 struct FillPainter {
@@ -46,11 +48,18 @@ struct FillPainter {
 
 
 struct LinePainter {
-    std::vector<SdfVertex> vertices;
+    std::vector<SdfVertex> vertices;            // Parabolic segments
+    std::vector<SdfVertex> straight_vertices;   // Straight segments and interior quads, drawn with the cheaper shader variant
 
     F2 start_pos = F2( 0.0f );    
     F2 prev_pos;
 
+    // 0 - segment limits are sorted (SDF)
+    // 1 / -1 - segment limits are stored in (reversed) contour travel order (MSDF)
+    int orientation = 0;
+
+    F2 segment_limits( const Parabola& par, F2 p0, F2 p2 ) const;
+
     void move_to( F2 p0 );
 
     void line_to( F2 p1, float line_width );
@@ -58,6 +67,10 @@ struct LinePainter {
     void qbez_to( F2 p1, F2 p2, float line_width );
 
     void close( float line_width );
+
+    // Quad with zero scale covering the glyph interior beyond the line quads,
+    // written at the maximum distance with the sign of the texel
+    void interior( F2 vmin, F2 vmax );
 };
 
 
@@ -67,14 +80,19 @@ struct GlyphPainter {
 
     LinePainter lp;
 
-    float getEdge(F2 startPoint, F2 endPoint);
-    
-    void draw_glyph( const Font *font, int glyph_index, F2 pos, float scale, float sdf_size );
+    std::vector<DrawBatch> batches;
+
+    // Outline simplification tolerance in pixels, 0 - glyphs are drawn as they are
+    float simplify = 0.0f;
 
-    void draw_subglyph(const Font* font, int glyph_index, F2 pos, float scale, float sdf_size, int command_start, int command_end);
+    GlyphOutline outline;
+
+    void draw_glyph( const Font *font, int glyph_index, F2 pos, float scale, float sdf_size );
 
     void clear() {
         fp.vertices.clear();
         lp.vertices.clear();
+        lp.straight_vertices.clear();
+        batches.clear();
     }
 };
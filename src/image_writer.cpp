@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "image_writer.h"
+
+#include <cstring>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../third_party/stb_image_write.h"
+
+
+bool parse_image_format( const std::string& name, ImageFormat *format ) {
+    if ( name == "png" )    { *format = ImageFormat::Png;    return true; }
+    if ( name == "png16" )  { *format = ImageFormat::Png16;  return true; }
+    if ( name == "r16" )    { *format = ImageFormat::Raw16;  return true; }
+    if ( name == "r32f" )   { *format = ImageFormat::Raw32f; return true; }
+    return false;
+}
+
+const char* image_format_name( ImageFormat format ) {
+    switch ( format ) {
+    case ImageFormat::Png:    return "png";
+    case ImageFormat::Png16:  return "png16";
+    case ImageFormat::Raw16:  return "r16";
+    case ImageFormat::Raw32f: return "r32f";
+    }
+    return "";
+}
+
+const char* image_format_extension( ImageFormat format ) {
+    switch ( format ) {
+    case ImageFormat::Png:
+    case ImageFormat::Png16:  return ".png";
+    case ImageFormat::Raw16:  return ".r16";
+    case ImageFormat::Raw32f: return ".r32f";
+    }
+    return "";
+}
+
+PixelType image_pixel_type( ImageFormat format ) {
+    switch ( format ) {
+    case ImageFormat::Png:    return PixelType::U8;
+    case ImageFormat::Png16:
+    case ImageFormat::Raw16:  return PixelType::U16;
+    case ImageFormat::Raw32f: return PixelType::F32;
+    }
+    return PixelType::U8;
+}
+
+size_t pixel_type_size( PixelType type ) {
+    switch ( type ) {
+    case PixelType::U8:  return 1;
+    case PixelType::U16: return 2;
+    case PixelType::F32: return 4;
+    }
+    return 1;
+}
+
+
+
+// PNG chunk helpers for 16-bit images, stb_image_write handles 8 bit only
+
+static uint32_t png_crc( const uint8_t *data, size_t len, uint32_t crc = 0xffffffffu ) {
+    static uint32_t table[256] = { 0 };
+    if ( table[1] == 0 ) {
+        for ( uint32_t i = 0; i < 256; ++i ) {
+            uint32_t c = i;
+            for ( int k = 0; k < 8; ++k ) c = ( c & 1 ) ? 0xedb88320u ^ ( c >> 1 ) : c >> 1;
+            table[i] = c;
+        }
+    }
+    for ( size_t i = 0; i < len; ++i ) {
+        crc = table[ ( crc ^ data[i] ) & 0xff ] ^ ( crc >> 8 );
+    }
+    return crc;
+}
+
+static void put_u32be( uint8_t *p, uint32_t v ) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static bool write_png_chunk( FILE *f, const char *tag, const uint8_t *data, uint32_t len ) {
+    uint8_t head[8];
+    put_u32be( head, len );
+    memcpy( head + 4, tag, 4 );
+    uint32_t crc = png_crc( head + 4, 4 );
+    crc = png_crc( data, len, crc ) ^ 0xffffffffu;
+    uint8_t tail[4];
+    put_u32be( tail, crc );
+
+    return fwrite( head, 1, 8, f ) == 8 &&
+           ( len == 0 || fwrite( data, 1, len, f ) == len ) &&
+           fwrite( tail, 1, 4, f ) == 4;
+}
+
+static bool write_png16( const std::string& filename, int width, int height, int channels, std::vector<uint8_t>& filtered ) {
+    static const uint8_t color_types[5] = { 0, 0, 4, 2, 6 };
+    static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+    int   zlen = 0;
+    uint8_t *zdata = stbi_zlib_compress( filtered.data(), (int) filtered.size(), &zlen, 8 );
+    if ( !zdata ) return false;
+
+    // Compressed data is all we need from now on
+    std::vector<uint8_t>().swap( filtered );
+
+    uint8_t ihdr[13];
+    put_u32be( ihdr, width );
+    put_u32be( ihdr + 4, height );
+    ihdr[8]  = 16;                        // bit depth
+    ihdr[9]  = color_types[ channels ];
+    ihdr[10] = 0;                         // deflate
+    ihdr[11] = 0;                         // adaptive filtering
+    ihdr[12] = 0;                         // no interlace
+
+    bool res = false;
+    FILE *f = fopen( filename.c_str(), "wb" );
+    if ( f ) {
+        res = fwrite( signature, 1, 8, f ) == 8 &&
+              write_png_chunk( f, "IHDR", ihdr, 13 ) &&
+              write_png_chunk( f, "IDAT", zdata, zlen ) &&
+              write_png_chunk( f, "IEND", nullptr, 0 );
+        res = ( fclose( f ) == 0 ) && res;
+    }
+
+    STBIW_FREE( zdata );
+    return res;
+}
+
+
+
+bool ImageWriter::open( const std::string& filename, ImageFormat format, int width, int height, int channels ) {
+    this->filename = filename;
+    this->format   = format;
+    this->width    = width;
+    this->height   = height;
+    this->channels = channels;
+    row = 0;
+    image.clear();
+
+    switch ( format ) {
+    case ImageFormat::Png:
+        image.resize( (size_t) width * height * channels );
+        return true;
+    case ImageFormat::Png16:
+        // Filter type byte + big-endian samples per row
+        image.reserve( (size_t) ( width * channels * 2 + 1 ) * height );
+        return true;
+    case ImageFormat::Raw16:
+    case ImageFormat::Raw32f:
+        file = fopen( filename.c_str(), "wb" );
+        return file != nullptr;
+    }
+    return false;
+}
+
+bool ImageWriter::write_row( const void *pixels ) {
+    if ( row >= height ) return false;
+    size_t count = (size_t) width * channels;
+
+    switch ( format ) {
+    case ImageFormat::Png:
+        memcpy( image.data() + row * count, pixels, count );
+        break;
+
+    case ImageFormat::Png16: {
+        // "Sub" filter, SDF rows are smooth and compress much better this way
+        const uint16_t *src = (const uint16_t*) pixels;
+        image.push_back( 1 );
+        for ( size_t i = 0; i < count; ++i ) {
+            uint16_t prev = i >= (size_t) channels ? src[ i - channels ] : 0;
+            image.push_back( ( src[i] >> 8 ) - ( prev >> 8 ) );
+            image.push_back( ( src[i] & 0xff ) - ( prev & 0xff ) );
+        }
+        break;
+    }
+
+    case ImageFormat::Raw16: {
+        const uint16_t *src = (const uint16_t*) pixels;
+        uint8_t buf[512];
+        for ( size_t i = 0; i < count; i += 256 ) {
+            size_t n = count - i < 256 ? count - i : 256;
+            for ( size_t j = 0; j < n; ++j ) {
+                buf[ j * 2 ]     = src[ i + j ] & 0xff;
+                buf[ j * 2 + 1 ] = src[ i + j ] >> 8;
+            }
+            if ( fwrite( buf, 2, n, file ) != n ) return false;
+        }
+        break;
+    }
+
+    case ImageFormat::Raw32f: {
+        const float *src = (const float*) pixels;
+        uint8_t buf[1024];
+        for ( size_t i = 0; i < count; i += 256 ) {
+            size_t n = count - i < 256 ? count - i : 256;
+            for ( size_t j = 0; j < n; ++j ) {
+                uint32_t u;
+                memcpy( &u, src + i + j, 4 );
+                buf[ j * 4 ]     = u & 0xff;
+                buf[ j * 4 + 1 ] = ( u >> 8 ) & 0xff;
+                buf[ j * 4 + 2 ] = ( u >> 16 ) & 0xff;
+                buf[ j * 4 + 3 ] = u >> 24;
+            }
+            if ( fwrite( buf, 4, n, file ) != n ) return false;
+        }
+        break;
+    }
+    }
+
+    row++;
+    return true;
+}
+
+bool ImageWriter::close() {
+    bool res = row == height;
+
+    switch ( format ) {
+    case ImageFormat::Png:
+        res = res && stbi_write_png( filename.c_str(), width, height, channels, image.data(), width * channels );
+        break;
+    case ImageFormat::Png16:
+        res = res && write_png16( filename, width, height, channels, image );
+        break;
+    case ImageFormat::Raw16:
+    case ImageFormat::Raw32f:
+        if ( file ) {
+            res = ( fclose( file ) == 0 ) && res;
+            file = nullptr;
+        }
+        break;
+    }
+
+    std::vector<uint8_t>().swap( image );
+    return res;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Atlas image output formats.
+// All formats store the same normalized distance: 0.5 on the glyph outline,
+// 0.0 and 1.0 at 'falloff' pixels outside and inside respectively.
+//
+// Png    - 8-bit PNG
+// Png16  - 16-bit PNG
+// Raw16  - headerless little-endian uint16 rows, top to bottom
+// Raw32f - headerless little-endian float32 rows, top to bottom
+
+enum class ImageFormat {
+    Png, Png16, Raw16, Raw32f
+};
+
+// Pixel type the writer expects in write_row()
+
+enum class PixelType {
+    U8, U16, F32
+};
+
+bool parse_image_format( const std::string& name, ImageFormat *format );
+
+const char* image_format_name( ImageFormat format );
+
+const char* image_format_extension( ImageFormat format );
+
+PixelType image_pixel_type( ImageFormat format );
+
+size_t pixel_type_size( PixelType type );
+
+
+// Streaming image writer. Rows are passed top to bottom in the pixel type of the format.
+// Raw formats go straight to the file, PNG formats keep only the final encoded-depth copy.
+
+struct ImageWriter {
+    ImageFormat format   = ImageFormat::Png;
+    int         width    = 0;
+    int         height   = 0;
+    int         channels = 1;
+
+    std::string          filename;
+    FILE                *file = nullptr;
+    std::vector<uint8_t> image;
+    int                  row  = 0;
+
+    bool open( const std::string& filename, ImageFormat format, int width, int height, int channels );
+
+    bool write_row( const void *pixels );
+
+    bool close();
+
+    size_t row_size() const {
+        return width * channels * pixel_type_size( image_pixel_type( format ) );
+    }
+};
@@ -20,10 +20,12 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <GL/gl.h>
@@ -34,16 +36,27 @@
 #include "sdf_atlas.h"
 #include "glyph_painter.h"
 #include "font.h"
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "../third_party/stb_image_write.h"
-#include <map>
+#include "image_writer.h"
+#include "atlas_cache.h"
+#include "stats.h"
+#include "sdf_cpu.h"
+#include "sdf_compute.h"
+#include "sdf_edt.h"
+#include "atlas_size.h"
 
 ArgsParser   args;
 SdfGl        sdf_gl;
+SdfCompute   sdf_compute;
 SdfAtlas     sdf_atlas;
+FontFile     font_file;
 Font         font;
 GlyphPainter gp;
+MsdfPainter  mp;
+AtlasCache   cache;
+
+// Part of the cache key together with the hash of the executable, which changes with every
+// rebuild that changes the output. The version covers builds the executable can't be read back from.
+const char  *tool_version = "1.1";
 
 int          max_tex_size = 2048;
 int          width = max_tex_size;
@@ -53,6 +66,22 @@ int          border_size = 5;
 std::string  filename;
 std::string  res_filename;
 F2           tex_size = F2(width, height);
+ImageFormat  image_format = ImageFormat::Png;
+bool         msdf_mode = false;
+std::string  backend = "gl";
+FillRule     fill_rule = FillRule::NonZero;
+float        tolerance = 0.01f;
+float        simplify = 0.0f;
+bool         auto_size = false;
+AtlasSizeRule size_rule = AtlasSizeRule::Any;
+bool         max_row_height = false;
+int          threads = 0;
+int          supersample = 4;
+int          samples = 1;
+bool         print_stats = false;
+bool         sdf_gl_ready = false;
+bool         sdf_compute_ready = false;
+std::string  trace_filename;
 
 
 struct UnicodeRange {
@@ -62,9 +91,15 @@ struct UnicodeRange {
 
 std::vector<UnicodeRange> unicode_ranges;
 
+// Faces of a font collection, empty - all faces
+std::vector<int>          face_indices { 0 };
+
+// Instances of a variable font, empty - the default instance
+std::vector<std::vector<VarAxisValue>> var_instances;
+
 
 std::string help = R"(Program for generating signed distance field font atlas.
-Given TTF file, generates PNG image and JSON with glyph rectangles and metrics.
+Given TTF, OTF (CFF, CFF2), TTC, WOFF or WOFF2 file, generates PNG image and JSON with glyph rectangles and metrics.
 Copyright: ©2019 Anton Stiopin, astiopin@gmail.com
 License: MIT
 Usage: sdf_atlas -f font_file.ttf [options]
@@ -75,8 +110,44 @@ Options:
     -th 'size'      atlas image height in pixels (optional)
     -ur 'ranges'    unicode ranges 'start1:end1,start:end2,single_codepoint' without spaces,
                     default: all
+    -fi 'faces'     face indices of a font collection (.ttc) 'index1,index2' or 'all', default 0.
+                    Several faces are written to 'filename_index' outputs
+    --var 'values'  variable font instance 'axis1=value1,axis2=value2', e.g. 'wght=650,wdth=80',
+                    axes not given are at their defaults. Repeated for several instances,
+                    written to 'filename_axis1value1_axis2value2' outputs
     -bs 'size'      SDF distance in pixels, default 5
-    -rh 'size'      row height in pixels (without SDF border), default 45
+    -rh 'size'      row height in pixels (without SDF border), default 45,
+                    'max' - the largest one the glyphs fit the atlas at (implies -size any)
+    -size 'rule'    smallest atlas the glyphs fit, -tw and -th become the limits:
+                    any         - smallest area
+                    pow2        - smallest area with power-of-two sides
+                    square      - smallest square
+                    square_pow2 - smallest power-of-two square
+    -fmt 'format'   atlas image format, default png:
+                    png   - 8-bit PNG
+                    png16 - 16-bit PNG
+                    r16   - raw little-endian uint16 (.r16)
+                    r32f  - raw little-endian float32 (.r32f)
+    -mode 'mode'    sdf - single channel distance field, default
+                    msdf - multi-channel (RGB) distance field with sharp corners
+    -backend 'name' gl - GPU rendering through OpenGL, default
+                    compute - GPU rendering with OpenGL 4.3 compute shaders over atlas tiles (SDF mode only)
+                    cpu - exact CPU reference renderer (SDF mode only)
+                    edt - CPU distance transform of supersampled coverage, faster and less precise (SDF mode only)
+    -fill 'rule'    inside of the outline, nonzero - nonzero winding number, default
+                    evenodd - odd winding number
+    -tol 'pixels'   distance error the GPU backends iterate down to, default 0.01
+    -simp 'pixels'  outline simplification tolerance of the gl backend, default 0 (off): nearly straight
+                    curves become lines, nearly collinear lines are merged and short ones dropped
+    -ms 'samples'   samples per pixel of the fill, sign and distance passes, 1, 2, 4, 8 or 16, default 1.
+                    The atlas gets their average, as rendered larger and scaled down (gl and cpu backends, SDF mode)
+    -ss 'factor'    coverage samples per pixel in x and y of the edt backend, default 4
+    -j 'count'      glyph decoding and CPU backend threads, default is the number of cores
+    -cache 'dir'    reuse atlases generated earlier with the same font, options and build,
+                    keeping them in the given directory
+    -cs 'size'      cache size limit in megabytes, default 256
+    --stats         print stage timings and counters
+    --trace 'file'  write stage timings in Chrome trace-event JSON format
 Example:
     sdf_atlas -f Roboto-Regular.ttf -o roboto -tw 2048 -th 2048 -bs 22 -rh 70 -ur 31:126,0xA0:0xFF,0x400:0x4FF,0xFFFF
 )";
@@ -94,6 +165,84 @@ void read_res_filename( ArgsParser* ap ) {
     res_filename = ap->word();
 }
 
+void read_face_indices( ArgsParser *ap ) {
+    std::string nword = ap->word();
+    face_indices.clear();
+    if ( nword == "all" ) return;
+
+    char *pos = const_cast<char*>( nword.c_str() );
+    for (;;) {
+        errno = 0;
+        char *new_pos = pos;
+        long face = strtol( pos, &new_pos, 0 );
+        if ( errno != 0 || face < 0 || new_pos == pos ) {
+            std::cerr << "Error reading face indices" << std::endl;
+            exit( 1 );
+        }
+        face_indices.push_back( face );
+        pos = new_pos;
+        char lim = *pos++;
+        if ( lim == 0 ) return;
+        if ( lim != ',' ) {
+            std::cerr << "Error reading face indices" << std::endl;
+            exit( 1 );
+        }
+    }
+}
+
+void read_var_instance( ArgsParser *ap ) {
+    std::string nword = ap->word();
+    std::vector<VarAxisValue> instance;
+
+    const char *pos = nword.c_str();
+    for (;;) {
+        const char *eq = strchr( pos, '=' );
+        if ( !eq || eq == pos || eq - pos > 4 ) {
+            std::cerr << "Error reading variable font axis values" << std::endl;
+            exit( 1 );
+        }
+        // Short tags are padded with spaces
+        std::string tag( pos, eq - pos );
+        tag.resize( 4, ' ' );
+
+        errno = 0;
+        char *new_pos = nullptr;
+        float value = strtof( eq + 1, &new_pos );
+        if ( errno != 0 || new_pos == eq + 1 ) {
+            std::cerr << "Error reading variable font axis values" << std::endl;
+            exit( 1 );
+        }
+
+        VarAxisValue av;
+        av.tag   = ( (uint8_t) tag[0] << 24 ) | ( (uint8_t) tag[1] << 16 ) | ( (uint8_t) tag[2] << 8 ) | (uint8_t) tag[3];
+        av.value = value;
+        instance.push_back( av );
+
+        pos = new_pos;
+        char lim = *pos++;
+        if ( lim == 0 ) break;
+        if ( lim != ',' ) {
+            std::cerr << "Error reading variable font axis values" << std::endl;
+            exit( 1 );
+        }
+    }
+    var_instances.push_back( instance );
+}
+
+// Output name suffix of a variable font instance: '_wght650_wdth80'
+std::string var_instance_suffix( const std::vector<VarAxisValue>& instance ) {
+    std::string suffix;
+    for ( const VarAxisValue& av : instance ) {
+        char tag[5] = { char( av.tag >> 24 ), char( av.tag >> 16 ), char( av.tag >> 8 ), char( av.tag ), 0 };
+        char value[32];
+        snprintf( value, sizeof( value ), "%g", av.value );
+        std::string stag = tag;
+        stag.erase( stag.find_last_not_of( ' ' ) + 1 );
+        suffix += "_" + stag + value;
+    }
+    return suffix;
+}
+
 void read_tex_width( ArgsParser *ap ) {
     errno = 0;
     width = strtol( ap->word().c_str(), nullptr, 0 );
@@ -121,14 +270,37 @@ void read_tex_height( ArgsParser *ap ) {
 };
 
 void read_row_height( ArgsParser *ap ) {
+    std::string word = ap->word();
+    if ( word == "max" ) {
+        max_row_height = true;
+        auto_size = true;
+        return;
+    }
     errno = 0;
-    row_height = strtol( ap->word().c_str(), nullptr, 0 );
+    row_height = strtol( word.c_str(), nullptr, 0 );
     if ( errno != 0 || row_height <= 4 ) {
         std::cerr << "Error reading row height." << std::endl;
         exit( 1 );
     }
 }
 
+void read_size_rule( ArgsParser *ap ) {
+    std::string rule = ap->word();
+    if ( rule == "any" ) {
+        size_rule = AtlasSizeRule::Any;
+    } else if ( rule == "pow2" ) {
+        size_rule = AtlasSizeRule::PowerOfTwo;
+    } else if ( rule == "square" ) {
+        size_rule = AtlasSizeRule::Square;
+    } else if ( rule == "square_pow2" ) {
+        size_rule = AtlasSizeRule::SquarePowerOfTwo;
+    } else {
+        std::cerr << "Unknown atlas size rule '" << rule << "'" << std::endl;
+        exit( 1 );
+    }
+    auto_size = true;
+}
+
 void read_border_size( ArgsParser *ap ) {
     errno = 0;
     border_size = strtol( ap->word().c_str(), nullptr, 0 );
@@ -138,6 +310,113 @@ void read_border_size( ArgsParser *ap ) {
     }
 }
 
+void read_image_format( ArgsParser *ap ) {
+    std::string name = ap->word();
+    if ( !parse_image_format( name, &image_format ) ) {
+        std::cerr << "Unknown image format '" << name << "'." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_mode( ArgsParser *ap ) {
+    std::string mode = ap->word();
+    if ( mode == "sdf" ) {
+        msdf_mode = false;
+    } else if ( mode == "msdf" ) {
+        msdf_mode = true;
+    } else {
+        std::cerr << "Unknown mode '" << mode << "'." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_backend( ArgsParser *ap ) {
+    backend = ap->word();
+    if ( backend != "gl" && backend != "compute" && backend != "cpu" && backend != "edt" ) {
+        std::cerr << "Unknown backend '" << backend << "'." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_fill_rule( ArgsParser *ap ) {
+    std::string rule = ap->word();
+    if ( rule == "nonzero" ) {
+        fill_rule = FillRule::NonZero;
+    } else if ( rule == "evenodd" ) {
+        fill_rule = FillRule::EvenOdd;
+    } else {
+        std::cerr << "Unknown fill rule '" << rule << "'." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_threads( ArgsParser *ap ) {
+    errno = 0;
+    threads = strtol( ap->word().c_str(), nullptr, 0 );
+    if ( errno != 0 || threads < 0 ) {
+        std::cerr << "Error reading thread count." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_supersample( ArgsParser *ap ) {
+    errno = 0;
+    supersample = strtol( ap->word().c_str(), nullptr, 0 );
+    if ( errno != 0 || supersample < 1 || supersample > 16 ) {
+        std::cerr << "Error reading supersampling factor." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_samples( ArgsParser *ap ) {
+    errno = 0;
+    samples = strtol( ap->word().c_str(), nullptr, 0 );
+    if ( errno != 0 || samples < 1 || samples > 16 || ( samples & ( samples - 1 ) ) != 0 ) {
+        std::cerr << "Error reading sample count." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_cache_dir( ArgsParser *ap ) {
+    cache.dir = ap->word();
+}
+
+void read_tolerance( ArgsParser *ap ) {
+    errno = 0;
+    tolerance = strtof( ap->word().c_str(), nullptr );
+    if ( errno != 0 || !( tolerance > 0.0f ) ) {
+        std::cerr << "Error reading tolerance." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_simplify( ArgsParser *ap ) {
+    errno = 0;
+    simplify = strtof( ap->word().c_str(), nullptr );
+    if ( errno != 0 || !( simplify >= 0.0f ) ) {
+        std::cerr << "Error reading simplification tolerance." << std::endl;
+        exit( 1 );
+    }
+}
+
+void read_cache_size( ArgsParser *ap ) {
+    errno = 0;
+    long long size = strtoll( ap->word().c_str(), nullptr, 0 );
+    if ( errno != 0 || size <= 0 ) {
+        std::cerr << "Error reading cache size." << std::endl;
+        exit( 1 );
+    }
+    cache.max_size = (uint64_t) size << 20;
+}
+
+void read_print_stats( ArgsParser* ) {
+    print_stats = true;
+}
+
+void read_trace_filename( ArgsParser *ap ) {
+    trace_filename = ap->word();
+}
+
 void read_unicode_ranges( ArgsParser *ap ) {
     errno = 0;
     int range_start = 0;
@@ -183,6 +462,203 @@ void read_unicode_ranges( ArgsParser *ap ) {
     }
 };
 
+void report_stats() {
+    if ( print_stats ) {
+        stats.print_summary( std::cout );
+    }
+    if ( !trace_filename.empty() && !stats.write_trace( trace_filename ) ) {
+        std::cerr << "Error writing trace file '" << trace_filename << "'" << std::endl;
+    }
+}
+
+void render_gl( ImageWriter& writer ) {
+    int tessellation_span = stats.begin( "tessellation" );
+    if ( msdf_mode ) {
+        sdf_atlas.draw_glyphs( mp );
+        stats.count( "fill vertices", mp.fp.vertices.size() );
+        for ( const LinePainter& l : mp.lp ) {
+            stats.count( "line vertices", l.vertices.size() );
+            stats.count( "straight line vertices", l.straight_vertices.size() );
+        }
+        stats.count( "draw batches", mp.batches.size() );
+    } else {
+        sdf_atlas.draw_glyphs( gp );
+        stats.count( "fill vertices", gp.fp.vertices.size() );
+        stats.count( "line vertices", gp.lp.vertices.size() );
+        stats.count( "straight line vertices", gp.lp.straight_vertices.size() );
+        stats.count( "draw batches", gp.batches.size() );
+    }
+    stats.end( tessellation_span );
+
+    // GL initialization
+    
+    int gl_init_span = stats.begin( "gl init" );
+    if ( !sdf_gl_ready ) {
+        sdf_gl.init();
+        sdf_gl_ready = true;
+    }
+    sdf_gl.fill_rule = fill_rule;
+    sdf_gl.tolerance = tolerance / border_size;
+    sdf_gl.samples = samples;
+    if ( samples > sdf_gl.max_samples() ) {
+        std::cerr << "Sample count " << samples << " is not supported, the maximum is " << sdf_gl.max_samples() << std::endl;
+        exit( 1 );
+    }
+
+    // RGB formats aren't required to be color-renderable, MSDF renders into RGBA and reads back RGB
+    PixelType pixel_type = image_pixel_type( image_format );
+    GLenum color_format = msdf_mode ? GL_RGBA8 : GL_R8;
+    GLenum read_format  = msdf_mode ? GL_RGB  : GL_RED;
+    GLenum read_type    = GL_UNSIGNED_BYTE;
+    if ( pixel_type == PixelType::U16 ) {
+        color_format = msdf_mode ? GL_RGBA16 : GL_R16;
+        read_type    = GL_UNSIGNED_SHORT;
+    } else if ( pixel_type == PixelType::F32 ) {
+        color_format = msdf_mode ? GL_RGBA32F : GL_R32F;
+        read_type    = GL_FLOAT;
+    }
+
+    GLuint rbcolor;
+    glGenRenderbuffers( 1, &rbcolor );
+    glBindRenderbuffer( GL_RENDERBUFFER, rbcolor );
+    glRenderbufferStorage( GL_RENDERBUFFER, color_format, width, height );
+    glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+    GLuint rbds;
+    glGenRenderbuffers( 1, &rbds );
+    glBindRenderbuffer( GL_RENDERBUFFER, rbds );
+    glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_STENCIL, width, height );
+    glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+    GLuint fbo;
+    glGenFramebuffers( 1, &fbo );
+    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbcolor );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbds );
+
+    if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE ) {
+        std::cerr << "Error creating framebuffer!" << std::endl;
+        exit( 1 );
+    }
+    stats.end( gl_init_span );
+
+    // Rendering glyphs
+
+    int render_span = stats.begin( "gpu render" );
+    glViewport( 0, 0, width, height );
+    // Depth and stencil are cleared within the draw batches by the renderer
+    glClearColor( 0.0, 0.0, 0.0, 0.0 );
+    glClear( GL_COLOR_BUFFER_BIT );
+    if ( msdf_mode ) {
+        sdf_gl.render_msdf( F2( width, height ), mp.fp.vertices, mp.lp[0].vertices, mp.lp[1].vertices, mp.lp[2].vertices,
+                            mp.lp[0].straight_vertices, mp.lp[1].straight_vertices, mp.lp[2].straight_vertices,
+                            mp.batches );
+    } else {
+        sdf_gl.render_sdf( F2( width, height ), gp.fp.vertices, gp.lp.vertices, gp.lp.straight_vertices, gp.batches );
+    }
+    // Waiting for the GPU, otherwise rendering time ends up in the readback
+    glFinish();
+    stats.end( render_span );
+
+    // Reading back in bands from the top of the framebuffer, so the picture
+    // comes out flipped vertically and only one band is held besides the writer's copy.
+    // MSDF error correction looks at the neighbouring texels, the picture is read at once.
+
+    int readback_span = stats.begin( "readback" );
+    const int band_rows = msdf_mode ? height : 64;
+    size_t row_size = writer.row_size();
+    std::vector<uint8_t> band( row_size * band_rows );
+
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+    for ( int band_top = height; band_top > 0; band_top -= band_rows ) {
+        int rows = band_top < band_rows ? band_top : band_rows;
+        glReadPixels( 0, band_top - rows, width, rows, read_format, read_type, band.data() );
+        if ( msdf_mode ) {
+            StatsTimer st( "msdf error correction" );
+            msdf_error_correction( band.data(), pixel_type, width, rows, 1.001f / ( 2.0f * border_size ) );
+        }
+        for ( int ir = rows - 1; ir >= 0; --ir ) {
+            writer.write_row( band.data() + ir * row_size );
+        }
+    }
+
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    glDeleteFramebuffers( 1, &fbo );
+    glDeleteRenderbuffers( 1, &rbds );
+    glDeleteRenderbuffers( 1, &rbcolor );
+    glFinish();
+    stats.end( readback_span );
+}
+
+// Converts normalized distances to the writer's pixel type the same way GL does, rows are bottom to top
+void write_distances( ImageWriter& writer, const std::vector<float>& image ) {
+    int convert_span = stats.begin( "pixel conversion" );
+    PixelType pixel_type = image_pixel_type( image_format );
+    std::vector<uint8_t> row( writer.row_size() );
+    for ( int y = height - 1; y >= 0; --y ) {
+        const float *src = image.data() + (size_t) y * width;
+        for ( int x = 0; x < width; ++x ) {
+            switch ( pixel_type ) {
+            case PixelType::U8:  row[x] = (uint8_t) ( src[x] * 255.0f + 0.5f ); break;
+            case PixelType::U16: ( (uint16_t*) row.data() )[x] = (uint16_t) ( src[x] * 65535.0f + 0.5f ); break;
+            case PixelType::F32: ( (float*) row.data() )[x] = src[x]; break;
+            }
+        }
+        writer.write_row( row.data() );
+    }
+    stats.end( convert_span );
+}
+
+void render_cpu( ImageWriter& writer ) {
+    SdfCpu sdf_cpu;
+    sdf_cpu.threads = threads;
+    sdf_cpu.fill_rule = fill_rule;
+    sdf_cpu.samples = samples;
+
+    std::vector<float> image;
+    int render_span = stats.begin( "cpu render" );
+    sdf_cpu.render( sdf_atlas, width, height, image );
+    stats.end( render_span );
+
+    write_distances( writer, image );
+}
+
+void render_edt( ImageWriter& writer ) {
+    SdfEdt sdf_edt;
+    sdf_edt.threads = threads;
+    sdf_edt.supersample = supersample;
+    sdf_edt.fill_rule = fill_rule;
+
+    std::vector<float> image;
+    int render_span = stats.begin( "edt render" );
+    sdf_edt.render( sdf_atlas, width, height, image );
+    stats.end( render_span );
+
+    write_distances( writer, image );
+}
+
+void render_compute( ImageWriter& writer ) {
+    int gl_init_span = stats.begin( "gl init" );
+    if ( !sdf_compute_ready ) {
+        if ( !sdf_compute.init() ) {
+            std::cerr << "Compute backend needs OpenGL 4.3" << std::endl;
+            exit( 1 );
+        }
+        sdf_compute_ready = true;
+    }
+    sdf_compute.fill_rule = fill_rule;
+    sdf_compute.tolerance = tolerance / border_size;
+    stats.end( gl_init_span );
+
+    std::vector<float> image;
+    int render_span = stats.begin( "gpu render" );
+    if ( !sdf_compute.render( sdf_atlas, width, height, image ) ) exit( 1 );
+    stats.end( render_span );
+
+    write_distances( writer, image );
+}
+
 void render() {
     glClearColor( 0.0, 0.0, 0.0, 0.0 );
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
@@ -190,11 +666,188 @@ void render() {
     F2 tex_size = F2( width, height );
 
     glViewport( 0, 0, width, height );
-    sdf_gl.render_sdf( tex_size, gp.fp.vertices, gp.lp.vertices );
+    sdf_gl.render_sdf( tex_size, gp.fp.vertices, gp.lp.vertices, gp.lp.straight_vertices, gp.batches );
 }
 
 
 
+// Calls fn for the requested code points, all mapped ones without unicode ranges
+
+template <class F>
+void for_each_codepoint( const Font& font, F fn ) {
+    if ( unicode_ranges.empty() ) {
+        for ( auto const& kv : font.glyph_map ) fn( kv.first );
+    } else {
+        for ( const UnicodeRange& ur : unicode_ranges ) {
+            for ( uint32_t codepoint = ur.start; codepoint <= ur.end; ++codepoint ) fn( codepoint );
+        }
+    }
+}
+
+// Generates the atlas of one font face, res_filename is the output name without extension
+
+void generate_atlas( int face_index, const std::vector<VarAxisValue>& variations, const std::string& res_filename ) {
+    // Looking up the cache, everything the atlas depends on goes into the key
+
+    std::vector<std::string> output_extensions { image_format_extension( image_format ), ".js" };
+
+    AtlasCache face_cache = cache;
+
+    if ( face_cache.enabled() ) {
+        int lookup_span = stats.begin( "cache lookup" );
+        face_cache.add( font_file.storage.data(), font_file.storage.size() );
+        face_cache.add( (int64_t) font_file.storage.size() );
+        if ( font_file.face_count() > 1 ) {
+            face_cache.add( (int64_t) face_index );
+        }
+        if ( !variations.empty() ) {
+            face_cache.add( "var" + var_instance_suffix( variations ) );
+        }
+        face_cache.add( tool_version );
+        face_cache.add( backend );
+        face_cache.add( msdf_mode ? "msdf" : "sdf" );
+        face_cache.add( fill_rule == FillRule::EvenOdd ? "evenodd" : "nonzero" );
+        if ( backend == "gl" || backend == "compute" ) face_cache.add( std::to_string( tolerance ) );
+        if ( backend == "gl" ) face_cache.add( std::to_string( simplify ) );
+        if ( backend == "edt" ) face_cache.add( (int64_t) supersample );
+        face_cache.add( (int64_t) samples );
+        face_cache.add( image_format_name( image_format ) );
+        face_cache.add( (int64_t) width );
+        face_cache.add( (int64_t) height );
+        face_cache.add( (int64_t) row_height );
+        if ( auto_size ) face_cache.add( std::string( "size " ) + atlas_size_rule_name( size_rule ) );
+        if ( max_row_height ) face_cache.add( "rh max" );
+        face_cache.add( (int64_t) border_size );
+        if ( unicode_ranges.empty() ) {
+            face_cache.add( "all" );
+        } else {
+            face_cache.add( (int64_t) unicode_ranges.size() );
+            for ( const UnicodeRange& ur : unicode_ranges ) {
+                face_cache.add( (int64_t) ur.start );
+                face_cache.add( (int64_t) ur.end );
+            }
+        }
+
+        bool hit = face_cache.fetch( res_filename, output_extensions );
+        stats.end( lookup_span );
+
+        if ( hit ) {
+            std::cout << "Atlas " << face_cache.key() << " found in cache" << std::endl;
+            return;
+        }
+    }
+
+    // Outputs may still be hardlinks to cache entries from earlier runs, with or without the cache now.
+    // Writing through them would change the cached files.
+    for ( const std::string& ext : output_extensions ) {
+        remove( ( res_filename + ext ).c_str() );
+    }
+
+    // The largest row height is found after loading, cubic CFF curves are approximated at the limit
+    if ( max_row_height ) row_height = std::min( width, height ) - border_size * 2;
+
+    font = Font {};
+    font.pixel_height = row_height;
+    font.variations = variations;
+    font.threads = threads;
+    if ( !font.load_face( font_file, face_index ) ) {
+        std::cerr << "Error reading face " << face_index << " of TTF file '" << filename << "': "
+                  << font_error_string( font.error ) << std::endl;
+        exit( 1 );
+    }
+
+    // Searching for the atlas size, packing only
+
+    if ( auto_size ) {
+        int search_span = stats.begin( "size search" );
+        AtlasSizeSearch search;
+        search.rule = size_rule;
+        search.max_width = width;
+        search.max_height = height;
+        search.init( &font, border_size );
+        for_each_codepoint( font, [&search]( uint32_t codepoint ) { search.add_codepoint( &font, codepoint ); } );
+
+        AtlasSize size;
+        bool found = max_row_height ? search.fit_max_row_height( row_height, size ) : search.fit( row_height, size );
+        stats.end( search_span );
+        if ( !found ) {
+            std::cerr << "Glyphs don't fit into " << width << "x" << height << " atlas" << std::endl;
+            exit( 1 );
+        }
+        width = size.width;
+        height = size.height;
+        row_height = size.row_height;
+        std::cout << "Atlas size " << width << "x" << height << ", row height " << row_height << std::endl;
+    }
+
+    // Allocating glyph rects
+
+    int packing_span = stats.begin( "packing" );
+    sdf_atlas.init( &font, width, row_height, border_size );
+    for_each_codepoint( font, []( uint32_t codepoint ) { sdf_atlas.allocate_codepoint( codepoint ); } );
+    stats.end( packing_span );
+    
+    stats.count( "atlas glyphs", sdf_atlas.glyph_count );
+
+    std::cout << "Allocated " << sdf_atlas.glyph_count << " glyphs" << std::endl;
+    std::cout << "Atlas maximum height is " << sdf_atlas.max_height << std::endl;
+
+    if ( height == 0 ) {
+        height = sdf_atlas.max_height;
+    }
+
+    // Rendering and saving the picture
+
+    std::string image_filename = res_filename + image_format_extension( image_format );
+    ImageWriter writer;
+    if ( !writer.open( image_filename, image_format, width, height, msdf_mode ? 3 : 1 ) ) {
+        std::cout << "Error writing image file." << std::endl;
+        exit( 1 );
+    }
+
+    gp.clear();
+    mp.clear();
+    gp.simplify = simplify;
+    mp.simplify = simplify;
+    if ( backend == "cpu" ) {
+        render_cpu( writer );
+    } else if ( backend == "edt" ) {
+        render_edt( writer );
+    } else if ( backend == "compute" ) {
+        render_compute( writer );
+    } else {
+        render_gl( writer );
+    }
+
+    int encode_span = stats.begin( "image encode" );
+    if ( !writer.close() ) {
+        std::cout << "Error writing image file." << std::endl;
+        exit( 1 );
+    }
+    stats.end( encode_span );
+
+    // Saving JSON
+
+    int metadata_span = stats.begin( "metadata write" );
+    std::string json = sdf_atlas.json( height, image_format_name( image_format ), msdf_mode ? "msdf" : "sdf" );
+    std::ofstream json_file;
+    json_file.open( res_filename + ".js" );
+    if ( !json_file ) {
+        std::cout << "Error writing json file." << std::endl;
+    }
+    json_file << json;
+    json_file.close();
+    stats.end( metadata_span );
+
+    if ( face_cache.enabled() ) {
+        StatsTimer st( "cache store" );
+        if ( !face_cache.store( res_filename, output_extensions ) ) {
+            std::cerr << "Error storing atlas in cache '" << face_cache.dir << "'" << std::endl;
+        }
+    }
+}
+
+
 int main( int argc, char* argv[] ) {
     if ( argc == 1 ) {
         std::cout << help;
@@ -233,15 +886,45 @@ int main( int argc, char* argv[] ) {
     args.commands["-tw"] = read_tex_width;
     args.commands["-th"] = read_tex_height;
     args.commands["-ur"] = read_unicode_ranges;
+    args.commands["-fi"] = read_face_indices;
+    args.commands["--var"] = read_var_instance;
     args.commands["-bs"] = read_border_size;
     args.commands["-rh"] = read_row_height;
+    args.commands["-size"] = read_size_rule;
+    args.commands["-fmt"] = read_image_format;
+    args.commands["-mode"] = read_mode;
+    args.commands["-backend"] = read_backend;
+    args.commands["-fill"] = read_fill_rule;
+    args.commands["-tol"] = read_tolerance;
+    args.commands["-simp"] = read_simplify;
+    args.commands["-ms"] = read_samples;
+    args.commands["-ss"] = read_supersample;
+    args.commands["-j"] = read_threads;
+    args.commands["-cache"] = read_cache_dir;
+    args.commands["-cs"] = read_cache_size;
+    args.commands["--stats"] = read_print_stats;
+    args.commands["--trace"] = read_trace_filename;
     args.run( argc, argv );
 
+    if ( cache.enabled() && !cache.add_file( "/proc/self/exe" ) && !cache.add_file( argv[0] ) ) {
+        std::cerr << "Can't read the executable, cached atlases of other builds may be reused" << std::endl;
+    }
+
     if ( filename.empty() ) {
         std::cerr << "Input file not specified" << std::endl;
         exit( 1 );
     }
 
+    if ( backend != "gl" && msdf_mode ) {
+        std::cerr << "MSDF mode is supported by the gl backend only" << std::endl;
+        exit( 1 );
+    }
+
+    if ( samples > 1 && ( msdf_mode || ( backend != "gl" && backend != "cpu" ) ) ) {
+        std::cerr << "Multisampling is supported by the gl and cpu backends in SDF mode only" << std::endl;
+        exit( 1 );
+    }
+
     if ( res_filename.empty() ) {
         size_t ext_dot = filename.find_last_of( "." );
         if ( ext_dot == std::string::npos ) {
@@ -251,110 +934,41 @@ int main( int argc, char* argv[] ) {
         }
     }
 
-    if ( !font.load_ttf_file( filename.c_str() ) ) {
-        std::cerr << "Error reading TTF file '" << filename << "' " << std::endl;
+    if ( !font_file.load( filename.c_str() ) ) {
+        std::cerr << "Error reading TTF file '" << filename << "': " << font_error_string( font_file.error ) << std::endl;
         exit( 1 );
     }
 
-    // Allocating glyph rects
-
-    sdf_atlas.init( &font, width, row_height, border_size );
-
-
-    if ( unicode_ranges.empty() ) {
-         for (auto const& x : sdf_atlas.font->glyph_map) {
-            sdf_atlas.allocate_unicode_range(x.first, x.first);
-         }
-    } else {
-        for ( const UnicodeRange& ur : unicode_ranges ) {
-            sdf_atlas.allocate_unicode_range( ur.start, ur.end );
-        }
+    int face_count = font_file.face_count();
+    if ( face_indices.empty() ) {
+        for ( int face = 0; face < face_count; ++face ) face_indices.push_back( face );
     }
-    
-    sdf_atlas.draw_glyphs( gp );
-
-    std::cout << "Allocated " << sdf_atlas.glyph_count << " glyphs" << std::endl;
-    std::cout << "Atlas maximum height is " << sdf_atlas.max_height << std::endl;
-
-    if ( height == 0 ) {
-        height = sdf_atlas.max_height;
-    }
-
-    uint8_t* picbuf = (uint8_t*) malloc( width * height );    
-
-    // GL initialization
-    
-    sdf_gl.init();    
-
-    GLuint rbcolor;
-    glGenRenderbuffers( 1, &rbcolor );
-    glBindRenderbuffer( GL_RENDERBUFFER, rbcolor );
-    glRenderbufferStorage( GL_RENDERBUFFER, GL_RED, width, height );
-    glBindRenderbuffer( GL_RENDERBUFFER, 0 );
-
-    GLuint rbds;
-    glGenRenderbuffers( 1, &rbds );
-    glBindRenderbuffer( GL_RENDERBUFFER, rbds );
-    glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_STENCIL, width, height );
-    glBindRenderbuffer( GL_RENDERBUFFER, 0 );
-
-    GLuint fbo;
-    glGenFramebuffers( 1, &fbo );
-    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
-    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbcolor );
-    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbds );
-
-    if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE ) {
-        std::cerr << "Error creating framebuffer!" << std::endl;
-        exit( 1 );
-    }
-
-    // Rendering glyphs
-
-    glViewport( 0, 0, width, height );
-    glClearColor( 0.0, 0.0, 0.0, 0.0 );
-    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
-    sdf_gl.render_sdf( F2( width, height ), gp.fp.vertices, gp.lp.vertices );
-
-    glReadPixels( 0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, picbuf );
-
-    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-    glFinish();
-
-    // Flipping the picture vertically
-
-    uint8_t *row_swap = (uint8_t*) malloc( width );
-
-    for ( int iy = 0; iy < height / 2; ++iy ) {
-        uint8_t* row0 = picbuf + iy * width;
-        uint8_t* row1 = picbuf + ( height - 1 - iy ) * width;
-        memcpy( row_swap, row0, width );
-        memcpy( row0, row1, width );
-        memcpy( row1, row_swap, width );
+    for ( int face : face_indices ) {
+        if ( face >= face_count ) {
+            std::cerr << "Font file has " << face_count << " faces, no face " << face << std::endl;
+            exit( 1 );
+        }
     }
 
-    free( row_swap ); 
-
-    // Saving the picture
-
-    std::string png_filename = res_filename + ".png";
-    if ( !stbi_write_png( png_filename.c_str(), width, height, 1, picbuf, width) ) {
-        std::cout << "Error writing png file." << std::endl;
-        exit( 1 );
+    // Faces and instances share the decoded tables through font_file
+    if ( var_instances.empty() ) var_instances.emplace_back();
+
+    int requested_width = width;
+    int requested_height = height;
+    int requested_row_height = row_height;
+    for ( int face : face_indices ) {
+        for ( const std::vector<VarAxisValue>& instance : var_instances ) {
+            width = requested_width;
+            height = requested_height;
+            row_height = requested_row_height;
+            std::string face_filename = res_filename;
+            if ( face_indices.size() > 1 ) face_filename += "_" + std::to_string( face );
+            if ( var_instances.size() > 1 ) face_filename += var_instance_suffix( instance );
+            generate_atlas( face, instance, face_filename );
+        }
     }
 
-    free( picbuf );
-
-    // Saving JSON
-
-    std::string json = sdf_atlas.json( height);
-    std::ofstream json_file;
-    json_file.open( res_filename + ".js" );
-    if ( !json_file ) {
-        std::cout << "Error writing json file." << std::endl;
-    }
-    json_file << json;
-    json_file.close();
+    report_stats();
     
     glfwTerminate();
     
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "msdf_painter.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// Corner if the direction turns by more than ~0.14 rad (pi - 3) from straight continuation
+static const float corner_cross_threshold = 0.14112f; // sin( 3.0 )
+
+static bool is_corner( F2 a, F2 b ) {
+    return dot( a, b ) <= 0.0f || fabsf( cross( a, b ) ) > corner_cross_threshold;
+}
+
+// Cycles edge colors, never returning a banned color
+static int switch_color( int color, unsigned& seed, int banned = MsdfPainter::Black ) {
+    int combined = color & banned;
+    if ( combined == MsdfPainter::Red || combined == MsdfPainter::Green || combined == MsdfPainter::Blue ) {
+        return combined ^ MsdfPainter::White;
+    }
+    if ( color == MsdfPainter::Black || color == MsdfPainter::White ) {
+        static const int start[3] = { MsdfPainter::Cyan, MsdfPainter::Magenta, MsdfPainter::Yellow };
+        int res = start[ seed % 3 ];
+        seed /= 3;
+        return res;
+    }
+    int shifted = color << ( 1 + ( seed & 1 ) );
+    seed >>= 1;
+    return ( shifted | shifted >> 3 ) & MsdfPainter::White;
+}
+
+// Splits edge index range into three nearly equal parts: -1, 0, 1
+static int symmetrical_trichotomy( int position, int n ) {
+    return int( 3.0 + 2.875 * position / ( n - 1 ) - 1.4375 + 0.5 ) - 3;
+}
+
+
+F2 MsdfPainter::Edge::dir_start() const {
+    if ( is_bez && sqr_length( p1 - p0 ) > 1e-12f ) return normalize( p1 - p0 );
+    return normalize( p2 - p0 );
+}
+
+F2 MsdfPainter::Edge::dir_end() const {
+    if ( is_bez && sqr_length( p2 - p1 ) > 1e-12f ) return normalize( p2 - p1 );
+    return normalize( p2 - p0 );
+}
+
+
+MsdfPainter::MsdfPainter() {
+    for ( LinePainter& l : lp ) l.orientation = 1;
+}
+
+void MsdfPainter::color_contour() {
+    int m = edges.size();
+    if ( m == 0 ) return;
+
+    std::vector<int> corners;
+    F2 prev_dir = edges.back().dir_end();
+    for ( int i = 0; i < m; ++i ) {
+        if ( is_corner( prev_dir, edges[i].dir_start() ) ) corners.push_back( i );
+        prev_dir = edges[i].dir_end();
+    }
+
+    if ( corners.empty() ) {
+        // Smooth contour
+        for ( Edge& e : edges ) e.color = White;
+
+    } else if ( corners.size() == 1 ) {
+        // "Teardrop", splitting the contour in three parts starting at the corner
+        int colors[3];
+        colors[0] = switch_color( White, seed );
+        colors[1] = White;
+        colors[2] = switch_color( colors[0], seed );
+        int corner = corners[0];
+        if ( m >= 3 ) {
+            for ( int i = 0; i < m; ++i ) {
+                edges[ ( corner + i ) % m ].color = colors[ 1 + symmetrical_trichotomy( i, m ) ];
+            }
+        } else {
+            for ( int i = 0; i < m; ++i ) {
+                edges[ ( corner + i ) % m ].color = colors[ i * 2 ];
+            }
+        }
+
+    } else {
+        // Switching color at every corner, last spline must differ from the first one
+        int corner_count = corners.size();
+        int spline = 0;
+        int start = corners[0];
+        int color = switch_color( White, seed );
+        int initial_color = color;
+        for ( int i = 0; i < m; ++i ) {
+            int index = ( start + i ) % m;
+            if ( spline + 1 < corner_count && corners[ spline + 1 ] == index ) {
+                ++spline;
+                color = switch_color( color, seed, spline == corner_count - 1 ? initial_color : Black );
+            }
+            edges[ index ].color = color;
+        }
+    }
+}
+
+void MsdfPainter::draw_contour( F2 pos, float scale, float sdf_size ) {
+    if ( edges.empty() ) return;
+    color_contour();
+
+    fp.move_to( edges[0].p0 * scale + pos );
+
+    for ( const Edge& e : edges ) {
+        F2 p0 = e.p0 * scale + pos;
+        F2 p1 = e.p1 * scale + pos;
+        F2 p2 = e.p2 * scale + pos;
+
+        if ( e.is_bez ) {
+            fp.qbez_to( p1, p2 );
+        } else {
+            fp.line_to( p2 );
+        }
+
+        for ( int ic = 0; ic < 3; ++ic ) {
+            if ( !( e.color & ( 1 << ic ) ) ) continue;
+            lp[ic].move_to( p0 );
+            if ( e.is_bez ) {
+                lp[ic].qbez_to( p1, p2, sdf_size );
+            } else {
+                lp[ic].line_to( p2, sdf_size );
+            }
+        }
+    }
+
+    fp.close();
+    edges.clear();
+}
+
+void MsdfPainter::draw_glyph( const Font *font, int glyph_index, F2 pos, float scale, float sdf_size ) {
+    const Glyph& g = font->glyphs[ glyph_index ];
+    if ( g.command_count == 0 ) return;
+    pos += g.command_offset * scale;
+
+    const GlyphCommand *commands = font->glyph_commands.data() + g.command_start;
+    const F2 *points = font->glyph_points.data() + g.point_start;
+    int command_count = g.command_count;
+    if ( simplify > 0.0f ) {
+        simplify_outline( font, glyph_index, simplify / scale, outline );
+        commands = outline.commands.data();
+        points = outline.points.data();
+        command_count = outline.commands.size();
+    }
+
+    // Edge signs assume clockwise outer contours (TrueType convention),
+    // glyphs with counter-clockwise outer contours have the travel order reversed.
+    // The signed area of the control polygon is dominated by the outer contours.
+    float area = 0.0f;
+    for ( int icontour = g.contour_start; icontour < g.contour_start + g.contour_count; ++icontour ) {
+        area += font->glyph_contours[ icontour ].area;
+    }
+    for ( LinePainter& l : lp ) l.orientation = area > 0.0f ? -1 : 1;
+
+    // Splitting commands into contour edges
+    F2 start_pos { 0.0f }, prev_pos { 0.0f };
+    int ip = 0;
+    edges.clear();
+    for ( int ic = 0; ic < command_count; ++ic ) {
+        Edge e;
+        switch ( commands[ ic ] ) {
+        case GlyphCommand::MoveTo:
+            draw_contour( pos, scale, sdf_size );
+            start_pos = prev_pos = points[ ip++ ];
+            break;
+        case GlyphCommand::LineTo: {
+            F2 p = points[ ip++ ];
+            if ( sqr_length( p - prev_pos ) < 1e-7f ) break;
+            e.p0 = prev_pos;
+            e.p1 = 0.5f * ( prev_pos + p );
+            e.p2 = p;
+            edges.push_back( e );
+            prev_pos = p;
+            break;
+        }
+        case GlyphCommand::BezTo:
+            e.p0 = prev_pos;
+            e.p1 = points[ ip ];
+            e.p2 = points[ ip + 1 ];
+            e.is_bez = true;
+            edges.push_back( e );
+            prev_pos = e.p2;
+            ip += 2;
+            break;
+        case GlyphCommand::ClosePath:
+            if ( sqr_length( start_pos - prev_pos ) >= 1e-7f ) {
+                e.p0 = prev_pos;
+                e.p1 = 0.5f * ( prev_pos + start_pos );
+                e.p2 = start_pos;
+                edges.push_back( e );
+            }
+            draw_contour( pos, scale, sdf_size );
+            prev_pos = start_pos;
+            break;
+        }
+    }
+    draw_contour( pos, scale, sdf_size );
+}
+
+
+
+static float median3( float a, float b, float c ) {
+    return std::max( std::min( a, b ), std::min( std::max( a, b ), c ) );
+}
+
+static bool detect_clash( const float *a, const float *b, float threshold ) {
+    // Sorting channel pairs from the biggest to the smallest absolute difference
+    float a0 = a[0], a1 = a[1], a2 = a[2];
+    float b0 = b[0], b1 = b[1], b2 = b[2];
+    if ( fabsf( b0 - a0 ) < fabsf( b1 - a1 ) ) {
+        std::swap( a0, a1 );
+        std::swap( b0, b1 );
+    }
+    if ( fabsf( b1 - a1 ) < fabsf( b2 - a2 ) ) {
+        std::swap( a1, a2 );
+        std::swap( b1, b2 );
+        if ( fabsf( b0 - a0 ) < fabsf( b1 - a1 ) ) {
+            std::swap( a0, a1 );
+            std::swap( b0, b1 );
+        }
+    }
+    return fabsf( b1 - a1 ) >= threshold &&
+           !( b0 == b1 && b0 == b2 ) &&                  // Other texel is already equalized
+           fabsf( a2 - 0.5f ) >= fabsf( b2 - 0.5f );     // Only the texel farther from the edge
+}
+
+template <typename T>
+static void load_texels( const void *pixels, size_t count, float norm, std::vector<float>& res ) {
+    const T *src = (const T*) pixels;
+    for ( size_t i = 0; i < count; ++i ) res[i] = src[i] * norm;
+}
+
+template <typename T>
+static void store_texel( void *pixels, size_t idx, float v, float norm ) {
+    T *dst = (T*) pixels;
+    dst[ idx ] = dst[ idx + 1 ] = dst[ idx + 2 ] = (T) ( v * norm + 0.5f );
+}
+
+void msdf_error_correction( void *pixels, PixelType type, int width, int height, float threshold ) {
+    size_t count = (size_t) width * height * 3;
+    std::vector<float> tex( count );
+
+    switch ( type ) {
+    case PixelType::U8:  load_texels<uint8_t>( pixels, count, 1.0f / 255.0f, tex ); break;
+    case PixelType::U16: load_texels<uint16_t>( pixels, count, 1.0f / 65535.0f, tex ); break;
+    case PixelType::F32: load_texels<float>( pixels, count, 1.0f, tex ); break;
+    }
+
+    const float diag_threshold = threshold * 2.0f;
+    std::vector<int> clashes;
+
+    for ( int y = 0; y < height; ++y ) {
+        for ( int x = 0; x < width; ++x ) {
+            const float *t = &tex[ ( (size_t) y * width + x ) * 3 ];
+            bool clash =
+                ( x > 0          && detect_clash( t, t - 3, threshold ) ) ||
+                ( x < width - 1  && detect_clash( t, t + 3, threshold ) ) ||
+                ( y > 0          && detect_clash( t, t - width * 3, threshold ) ) ||
+                ( y < height - 1 && detect_clash( t, t + width * 3, threshold ) ) ||
+                ( x > 0 && y > 0                  && detect_clash( t, t - width * 3 - 3, diag_threshold ) ) ||
+                ( x < width - 1 && y > 0          && detect_clash( t, t - width * 3 + 3, diag_threshold ) ) ||
+                ( x > 0 && y < height - 1         && detect_clash( t, t + width * 3 - 3, diag_threshold ) ) ||
+                ( x < width - 1 && y < height - 1 && detect_clash( t, t + width * 3 + 3, diag_threshold ) );
+            if ( clash ) clashes.push_back( y * width + x );
+        }
+    }
+
+    for ( int ic : clashes ) {
+        size_t idx = (size_t) ic * 3;
+        float m = median3( tex[ idx ], tex[ idx + 1 ], tex[ idx + 2 ] );
+        switch ( type ) {
+        case PixelType::U8:  store_texel<uint8_t>( pixels, idx, m, 255.0f ); break;
+        case PixelType::U16: store_texel<uint16_t>( pixels, idx, m, 65535.0f ); break;
+        case PixelType::F32: {
+            float *dst = (float*) pixels;
+            dst[ idx ] = dst[ idx + 1 ] = dst[ idx + 2 ] = m;
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "float2.h"
+#include "font.h"
+#include "glyph_painter.h"
+#include "image_writer.h"
+
+
+// Multi-channel SDF painter.
+// Contour edges are colored so that every corner is shared by edges of different colors,
+// each edge is drawn into the line painters of the channels of its color.
+// Fill vertices mark the glyph interior for the texels farther than sdf_size from any edge.
+
+struct MsdfPainter {
+    enum EdgeColor {
+        Black = 0, Red = 1, Green = 2, Yellow = 3, Blue = 4, Magenta = 5, Cyan = 6, White = 7
+    };
+
+    struct Edge {
+        F2   p0, p1, p2;        // p1 is the control point for curves
+        bool is_bez = false;
+        int  color  = White;
+
+        F2 dir_start() const;
+        F2 dir_end() const;
+    };
+
+    FillPainter fp;
+
+    LinePainter lp[3];          // R, G, B channels
+
+    std::vector<DrawBatch> batches;
+
+    std::vector<Edge> edges;    // Current contour
+
+    // Outline simplification tolerance in pixels, 0 - glyphs are drawn as they are
+    float simplify = 0.0f;
+
+    GlyphOutline outline;
+
+    MsdfPainter();
+
+    void draw_glyph( const Font *font, int glyph_index, F2 pos, float scale, float sdf_size );
+
+    void clear() {
+        fp.vertices.clear();
+        for ( LinePainter& l : lp ) {
+            l.vertices.clear();
+            l.straight_vertices.clear();
+        }
+        batches.clear();
+    }
+
+private:
+    void color_contour();
+
+    void draw_contour( F2 pos, float scale, float sdf_size );
+
+    unsigned seed = 0;
+};
+
+
+// Removes interpolation artifacts where the channels of neighbouring texels clash,
+// i.e. bilinear filtering between them would produce a false median.
+// Clashing texels farther from the edge are replaced by their median.
+// threshold is the largest expected channel change between neighbours, 1 / distance range in pixels.
+
+void msdf_error_correction( void *pixels, PixelType type, int width, int height, float threshold );
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "outline_simplify.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Segment of a contour from the end point of the previous one
+struct ContourSegment {
+    F2   p1, p2;                // p1 is the control point for curves
+    bool is_bez = false;
+};
+
+// Longest run of merged lines, the merge test goes over every vertex of the run
+static const int max_merged_lines = 64;
+
+static float segment_dist( F2 p, F2 a, F2 b ) {
+    F2 ab = b - a;
+    float len2 = dot( ab, ab );
+    float t = len2 > 0.0f ? std::max( 0.0f, std::min( 1.0f, dot( p - a, ab ) / len2 ) ) : 0.0f;
+    return length( a + ab * t - p );
+}
+
+// Writes the contour starting at 'start' into the display list. Every step moves the outline
+// by at most half of the tolerance, and the steps don't stack on the same part of it.
+static void simplify_contour( F2 start, std::vector<ContourSegment>& segs, bool closed, float tolerance, GlyphOutline& out ) {
+    float half_tol = 0.5f * tolerance;
+
+    // Curves deviate from the chord by at most half of the control point distance to it,
+    // the distance to the chord segment is convex along the curve
+    F2 prev = start;
+    for ( ContourSegment& s : segs ) {
+        if ( s.is_bez && 0.5f * segment_dist( s.p1, prev, s.p2 ) <= half_tol ) {
+            s.is_bez = false;
+            s.p1 = s.p2;
+        }
+        prev = s.p2;
+    }
+
+    out.commands.push_back( GlyphCommand::MoveTo );
+    out.points.push_back( start );
+
+    // Lines are merged while the vertices of the run stay within half of the tolerance from the merged one
+    F2 anchor = start;
+    int run_start = -1;             // First line of the current run, -1 without one
+    for ( size_t is = 0; is < segs.size(); ++is ) {
+        const ContourSegment& s = segs[ is ];
+        if ( s.is_bez ) {
+            if ( run_start >= 0 ) {
+                anchor = segs[ is - 1 ].p2;
+                out.commands.push_back( GlyphCommand::LineTo );
+                out.points.push_back( anchor );
+                run_start = -1;
+            }
+            out.commands.push_back( GlyphCommand::BezTo );
+            out.points.push_back( s.p1 );
+            out.points.push_back( s.p2 );
+            anchor = s.p2;
+            continue;
+        }
+
+        // Short line between curves, the next curve starts at the anchor instead
+        bool next_bez = is + 1 < segs.size() ? segs[ is + 1 ].is_bez : false;
+        if ( run_start < 0 && next_bez && length( s.p2 - anchor ) <= half_tol ) continue;
+
+        if ( run_start >= 0 ) {
+            bool fits = (int) is - run_start < max_merged_lines;
+            for ( int iv = run_start; fits && iv < (int) is; ++iv ) {
+                fits = segment_dist( segs[ iv ].p2, anchor, s.p2 ) <= half_tol;
+            }
+            if ( !fits ) {
+                anchor = segs[ is - 1 ].p2;
+                out.commands.push_back( GlyphCommand::LineTo );
+                out.points.push_back( anchor );
+                run_start = is;
+            }
+        } else {
+            run_start = is;
+        }
+    }
+    if ( run_start >= 0 ) {
+        out.commands.push_back( GlyphCommand::LineTo );
+        out.points.push_back( segs.back().p2 );
+    }
+
+    if ( closed ) out.commands.push_back( GlyphCommand::ClosePath );
+}
+
+void simplify_outline( const Font *font, int glyph_index, float tolerance, GlyphOutline& out ) {
+    out.commands.clear();
+    out.points.clear();
+
+    const Glyph& g = font->glyphs[ glyph_index ];
+    const F2 *points = font->glyph_points.data() + g.point_start;
+    std::vector<ContourSegment> segs;
+    F2 start { 0.0f };
+    bool open = false;
+
+    for ( int ic = g.command_start; ic < g.command_start + g.command_count; ++ic ) {
+        ContourSegment s;
+        switch ( font->glyph_commands[ ic ] ) {
+        case GlyphCommand::MoveTo:
+            if ( open ) simplify_contour( start, segs, false, tolerance, out );
+            segs.clear();
+            start = *points++;
+            open = true;
+            break;
+        case GlyphCommand::LineTo:
+            s.p1 = s.p2 = *points++;
+            segs.push_back( s );
+            break;
+        case GlyphCommand::BezTo:
+            s.p1 = points[0];
+            s.p2 = points[1];
+            s.is_bez = true;
+            points += 2;
+            segs.push_back( s );
+            break;
+        case GlyphCommand::ClosePath:
+            // The closing line takes part in the merging, the contour ends at its start point
+            if ( !segs.empty() && sqr_length( segs.back().p2 - start ) > 0.0f ) {
+                s.p1 = s.p2 = start;
+                segs.push_back( s );
+            }
+            simplify_contour( start, segs, true, tolerance, out );
+            segs.clear();
+            open = false;
+            break;
+        }
+    }
+    if ( open ) simplify_contour( start, segs, false, tolerance, out );
+}
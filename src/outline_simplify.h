@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "float2.h"
+#include "font.h"
+
+// Outline simplification between Font and the painters.
+// Dense outlines (traced or decorative fonts) have many tiny segments, every one of them
+// is a line quad of about 2 * sdf_size pixels. Nearly straight curves become lines,
+// runs of nearly collinear lines are merged and short lines between curves are dropped,
+// keeping the outline within the tolerance of the original one.
+
+// Glyph display list with its own storage, same layout as in Font
+struct GlyphOutline {
+    std::vector<GlyphCommand> commands;
+    std::vector<F2>           points;
+};
+
+// Display list of the glyph simplified within 'tolerance' font units, without the command offset.
+// Contours keep their start points and orientation.
+void simplify_outline( const Font *font, int glyph_index, float tolerance, GlyphOutline& out );
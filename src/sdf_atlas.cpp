@@ -23,7 +23,9 @@
 #include "sdf_atlas.h"
 
 #include <algorithm>
-#include <unordered_set>
+#include <cmath>
+#include <map>
+#include <set>
 #include <iostream>
 #include <sstream>
 
@@ -91,58 +93,105 @@ void SdfAtlas::allocate_unicode_range( uint32_t start, uint32_t end ) {
     }
 }
 
-void SdfAtlas::draw_glyphs( GlyphPainter& gp ) const {
+float SdfAtlas::glyph_scale() const {
     float fheight = font->ascent - font->descent;
-    float scale = row_height / fheight;
+    return row_height / fheight;
+}
+
+F2 SdfAtlas::glyph_origin( const GlyphRect& gr ) const {
+    float scale = glyph_scale();
     float baseline = -font->descent * scale;
-    
+    /* Take bearingX and bearingY into account. */
+    float left = font->glyphs[ gr.glyph_idx ].left_side_bearing * scale;
+    float top = (font->glyphs[gr.glyph_idx].min.y - font->descent) * scale;
+    return F2 { gr.x0, gr.y0 + baseline } + F2 { sdf_size - left, sdf_size - top };
+}
+
+// Glyphs of an atlas row make a draw batch, a rect left of the previous one starts a new row
+static DrawBatch* row_batch( std::vector<DrawBatch>& batches, const GlyphRect& gr, const GlyphRect* prev ) {
+    if ( !prev || gr.x0 < prev->x0 ) {
+        DrawBatch batch;
+        batch.x0 = floorf( gr.x0 );
+        batch.y0 = floorf( gr.y0 );
+        batch.x1 = ceilf( gr.x1 );
+        batch.y1 = ceilf( gr.y1 );
+        batches.push_back( batch );
+        return &batches.back();
+    }
+    DrawBatch& batch = batches.back();
+    batch.x0 = std::min( batch.x0, (int) floorf( gr.x0 ) );
+    batch.y0 = std::min( batch.y0, (int) floorf( gr.y0 ) );
+    batch.x1 = std::max( batch.x1, (int) ceilf( gr.x1 ) );
+    batch.y1 = std::max( batch.y1, (int) ceilf( gr.y1 ) );
+    return nullptr;
+}
+
+void SdfAtlas::draw_glyphs( GlyphPainter& gp ) const {
+    float scale = glyph_scale();
     for ( size_t iglyph = 0; iglyph < glyph_rects.size(); ++iglyph ) {
         const GlyphRect& gr = glyph_rects[ iglyph ];
-        /* Take bearingX and bearingY into account. */
-        float left = font->glyphs[ gr.glyph_idx ].left_side_bearing * scale;
-        float top = (font->glyphs[gr.glyph_idx].min.y - font->descent) * scale;
-        F2 glyph_pos = F2 { gr.x0, gr.y0 + baseline } + F2 { sdf_size - left, sdf_size - top };
-        gp.draw_glyph( font, gr.glyph_idx, glyph_pos, scale, sdf_size );
+        if ( DrawBatch *batch = row_batch( gp.batches, gr, iglyph ? &glyph_rects[ iglyph - 1 ] : nullptr ) ) {
+            batch->fill_start = gp.fp.vertices.size();
+            batch->line_start[0] = gp.lp.vertices.size();
+            batch->straight_start[0] = gp.lp.straight_vertices.size();
+        }
+        gp.draw_glyph( font, gr.glyph_idx, glyph_origin( gr ), scale, sdf_size );
+        gp.batches.back().fill_end = gp.fp.vertices.size();
+        gp.batches.back().line_end[0] = gp.lp.vertices.size();
+        gp.batches.back().straight_end[0] = gp.lp.straight_vertices.size();
     }
 }
 
-template<typename K, typename V>
-std::unordered_map<V, K> inverse_map(std::unordered_map<K, V>& map)
-{
-    std::unordered_map<V, K> inv;
-    std::for_each(map.begin(), map.end(),
-        [&inv](const std::pair<K, V>& p)
-        {
-            inv.insert(std::make_pair(p.second, p.first));
-        });
-    return inv;
+void SdfAtlas::draw_glyphs( MsdfPainter& mp ) const {
+    float scale = glyph_scale();
+    for ( size_t iglyph = 0; iglyph < glyph_rects.size(); ++iglyph ) {
+        const GlyphRect& gr = glyph_rects[ iglyph ];
+        if ( DrawBatch *batch = row_batch( mp.batches, gr, iglyph ? &glyph_rects[ iglyph - 1 ] : nullptr ) ) {
+            batch->fill_start = mp.fp.vertices.size();
+            for ( int ic = 0; ic < 3; ++ic ) {
+                batch->line_start[ic] = mp.lp[ic].vertices.size();
+                batch->straight_start[ic] = mp.lp[ic].straight_vertices.size();
+            }
+        }
+        mp.draw_glyph( font, gr.glyph_idx, glyph_origin( gr ), scale, sdf_size );
+        mp.batches.back().fill_end = mp.fp.vertices.size();
+        for ( int ic = 0; ic < 3; ++ic ) {
+            mp.batches.back().line_end[ic] = mp.lp[ic].vertices.size();
+            mp.batches.back().straight_end[ic] = mp.lp[ic].straight_vertices.size();
+        }
+    }
 }
 
-std::string SdfAtlas::json(float tex_height) const {
+std::string SdfAtlas::json(float tex_height, const char *image_format, const char *mode) const {
     float fheight = font->ascent - font->descent;
     float scaley = row_height / tex_height / fheight;
     float scalex = row_height / tex_width / fheight;
 
-    const Glyph& gspace = font->glyphs[font->glyph_idx(' ')];
-    const Glyph& gx = font->glyphs[font->glyph_idx('x')];
-    const Glyph& gxcap = font->glyphs[font->glyph_idx('X')];
-
-    std::unordered_set<uint32_t> codepoints;
-    for (size_t igr = 0; igr < glyph_rects.size(); ++igr) {
-        codepoints.insert(glyph_rects[igr].codepoint);
-    }
+    // Glyph 0 (.notdef) stands in for missing characters
+    auto glyph = [this]( uint32_t codepoint ) -> const Glyph& {
+        return font->glyphs[ std::max( font->glyph_idx( codepoint ), 0 ) ];
+    };
+    const Glyph& gspace = glyph(' ');
+    const Glyph& gx = glyph('x');
+    const Glyph& gxcap = glyph('X');
 
     std::stringstream ss;
     ss << "/* The char metrics are stored in an object with the Unicode code point as the key and with values of the form:" << std::endl;
     ss << "[left, top, right, bottom, bearingX, bearingY, advanceX, flags]." << std::endl;
     ss << "The flags indicate the char type (Lower = 1, Upper = 2, Punct = 4, Space = 8)." << std::endl;
     ss << "The kerning pairs are stored in an object with the Unicode code point of the left character as the key and with values of the form:" << std::endl;
-    ss << "{ rightCharCode1: kerningValue1, ..., rightCharCodeN: kerningValueN }. */" << std::endl;
+    ss << "{ rightCharCode1: kerningValue1, ..., rightCharCodeN: kerningValueN }." << std::endl;
+    ss << "Class based kerning is stored in kerningClasses, a list of tables of the form:" << std::endl;
+    ss << "{ left: { charCode: leftClass, ... }, right: { charCode: rightClass, ... }, rightClassCount: N, values: [...] }." << std::endl;
+    ss << "The kerning of a pair is the value in the kerning object if present. Otherwise it is the sum over the tables listing the left char" << std::endl;
+    ss << "of values[leftClass * rightClassCount + rightClass], a right char not listed in a table has class 0. */" << std::endl;
     ss << "export default {" << std::endl;
     ss << "  textureWidth: " << tex_width << ", /* Width of the glyph atlas texture in pixel. */" << std::endl;
     ss << "  textureHeight: " << tex_height << ", /* Height of the glyph atlas texture in pixel. */" << std::endl;
     ss << "  falloff: " << sdf_size << ", /* SDF border on each side in pixel. */" << std::endl;
     ss << "  glyphHeight: " << row_height << ", /* Maximum height (without border, just ascent + abs(descent)) of an individual glyph texture in pixel. */" << std::endl;
+    ss << "  mode: \"" << mode << "\", /* sdf - single channel, msdf - multi-channel (RGB, distance is the median of the channels). */" << std::endl;
+    ss << "  imageFormat: \"" << image_format << "\", /* Atlas image format: png, png16, r16 (raw uint16) or r32f (raw float32), little-endian rows top to bottom. */" << std::endl;
     ss << "  /* Below this line, all metrics are normalized to the ascent (ascent = 1)." << std::endl;
     ss << "  Only the glyph bounding box [left, top, right, bottom] is given in absolute pixels where (0,0) is top left of the glyph atlas. */" << std::endl;
     ss << "  descent: " << font->descent / font->ascent << "," << std::endl;
@@ -167,47 +216,50 @@ std::string SdfAtlas::json(float tex_height) const {
 
     ss << " }," << std::endl;   
 
-    /* Inverted glyph map: glyph index -> codepoint */
-    std::unordered_map<int, uint32_t> invertedGlyphMap = inverse_map(font->glyph_map);
+    /* Glyph index -> codepoints of the atlas chars using it. */
+    std::map<int, std::vector<uint32_t>> atlas_codepoints;
+    for (const GlyphRect& gr : glyph_rects) {
+        atlas_codepoints[gr.glyph_idx].push_back(gr.codepoint);
+    }
 
-    /* Order the kernings by the first character (create a map from the unicode of the first char to all belonging kerning pairs with the second char and the kerning value). */
-    std::unordered_map<uint32_t, std::unordered_map<uint32_t, float>>  kernings_all;
+    /* Glyph pairs with an explicit kerning value: legacy kern table pairs or GPOS format 1 pairs.
+    The value is the sum over all lookups, so class based kerning is already included. */
+    std::set<uint32_t> kern_pairs;
     for (auto kv : font->kern_map) {
-        uint32_t kern_pair = kv.first;
-        float kern_value = kv.second;
+        kern_pairs.insert(kv.first);
+    }
+    for (const KernLookup& kl : font->kern_lookups) {
+        for (const KernSubtable& st : kl.subtables) {
+            kern_pairs.insert(st.pairs.begin(), st.pairs.end());
+        }
+    }
+
+    /* Order the kernings by the first character (create a map from the unicode of the first char to all belonging kerning pairs with the second char and the kerning value). */
+    std::map<uint32_t, std::map<uint32_t, float>> kernings_all;
+    for (uint32_t kern_pair : kern_pairs) {
         int kern_first_glyph_idx = (kern_pair >> 16) & 0xffff;
         int kern_second_glyph_idx = kern_pair & 0xffff;
-        uint32_t kern_first_code_point = invertedGlyphMap.at(kern_first_glyph_idx);
-        uint32_t kern_second_code_point = invertedGlyphMap.at(kern_second_glyph_idx);
-
-        bool first_found = codepoints.find(kern_first_code_point) != codepoints.end();
-        bool second_found = codepoints.find(kern_second_code_point) != codepoints.end();
-        if (first_found && second_found) {
-            auto it = kernings_all.find(kern_first_code_point);        
-            if (it == kernings_all.end()) {
-                /* No kerning pair has been added so far in which this char is the left one -> add a new map for this char. */
-                std::unordered_map<uint32_t, float> new_kernings_single;
-                new_kernings_single.insert({ kern_second_code_point , kern_value });
-                kernings_all.insert({ kern_first_code_point, new_kernings_single });
-            }
-            else {
-                it->second.insert({ kern_second_code_point , kern_value });
+        auto first = atlas_codepoints.find(kern_first_glyph_idx);
+        auto second = atlas_codepoints.find(kern_second_glyph_idx);
+        if (first == atlas_codepoints.end() || second == atlas_codepoints.end()) continue;
+
+        int kern_value = font->glyph_kern_advance(kern_first_glyph_idx, kern_second_glyph_idx);
+        for (uint32_t kern_first_code_point : first->second) {
+            for (uint32_t kern_second_code_point : second->second) {
+                kernings_all[kern_first_code_point][kern_second_code_point] = kern_value;
             }
-            
         }
     }
 
     /* Create json output for the map created above. */
     ss << "  kerning: {";
     bool is_start_all = true;
-    for (auto kv_all : kernings_all) {
-        uint32_t kern_first_code_point = kv_all.first;
-        std::unordered_map<uint32_t, float> kernings_single = kv_all.second;
+    for (const auto& kv_all : kernings_all) {
         if (!is_start_all) { ss << ",";  }
-        ss << " " << kern_first_code_point << ": {";
+        ss << " " << kv_all.first << ": {";
 
         bool is_start_single = true;
-        for (auto kv_single : kernings_single) {
+        for (const auto& kv_single : kv_all.second) {
             if (!is_start_single) { ss << ","; }
             ss << " " << kv_single.first << ": " << kv_single.second / font->ascent;
             is_start_single = false;
@@ -217,7 +269,83 @@ std::string SdfAtlas::json(float tex_height) const {
         is_start_all = false;
     }
 
-    ss << " }" << std::endl;
+    ss << " }," << std::endl;
+
+    /* GPOS format 2 subtables stay class based: only the classes used by the atlas chars are written. */
+    ss << "  kerningClasses: [";
+    bool is_start_table = true;
+    for (const KernLookup& kl : font->kern_lookups) {
+        for (size_t ist = 0; ist < kl.subtables.size(); ++ist) {
+            const KernSubtable& st = kl.subtables[ist];
+            if (!st.is_class_based()) continue;
+
+            /* Left chars this subtable applies to: the first class based subtable of the lookup covering the glyph.
+            Format 1 subtables are ignored here, their pairs are complete in the kerning object. */
+            std::map<uint32_t, uint16_t> left;
+            std::map<uint16_t, uint16_t> left_compact;
+            for (const auto& kv : atlas_codepoints) {
+                uint16_t c1 = st.left_class(kv.first);
+                if (c1 == KernSubtable::no_class) continue;
+                bool shadowed = false;
+                for (size_t iprev = 0; iprev < ist && !shadowed; ++iprev) {
+                    const KernSubtable& prev = kl.subtables[iprev];
+                    shadowed = prev.is_class_based() && prev.left_class(kv.first) != KernSubtable::no_class;
+                }
+                if (shadowed) continue;
+                left_compact.insert({ c1, (uint16_t)left_compact.size() });
+                for (uint32_t cp : kv.second) left[cp] = c1;
+            }
+            if (left.empty()) continue;
+
+            /* Right class 0 is implicit for the chars not listed. */
+            std::map<uint32_t, uint16_t> right;
+            std::map<uint16_t, uint16_t> right_compact;
+            right_compact.insert({ 0, 0 });
+            for (const auto& kv : atlas_codepoints) {
+                uint16_t c2 = st.right_class(kv.first);
+                if (c2 == 0 || c2 >= st.class2_count) continue;
+                right_compact.insert({ c2, (uint16_t)right_compact.size() });
+                for (uint32_t cp : kv.second) right[cp] = c2;
+            }
+
+            /* Renumber the classes in order of appearance and drop the tables without any kerning. */
+            std::vector<uint16_t> left_classes(left_compact.size()), right_classes(right_compact.size());
+            for (const auto& kv : left_compact) left_classes[kv.second] = kv.first;
+            for (const auto& kv : right_compact) right_classes[kv.second] = kv.first;
+            bool has_values = false;
+            for (uint16_t c1 : left_classes) {
+                for (uint16_t c2 : right_classes) {
+                    has_values |= st.class_values[(size_t)c1 * st.class2_count + c2] != 0;
+                }
+            }
+            if (!has_values) continue;
+
+            if (!is_start_table) { ss << ","; }
+            ss << std::endl << "    { left: {";
+            bool is_start = true;
+            for (const auto& kv : left) {
+                ss << (is_start ? " " : ", ") << kv.first << ": " << left_compact[kv.second];
+                is_start = false;
+            }
+            ss << " }," << std::endl << "      right: {";
+            is_start = true;
+            for (const auto& kv : right) {
+                ss << (is_start ? " " : ", ") << kv.first << ": " << right_compact[kv.second];
+                is_start = false;
+            }
+            ss << " }," << std::endl << "      rightClassCount: " << right_classes.size() << "," << std::endl << "      values: [";
+            is_start = true;
+            for (uint16_t c1 : left_classes) {
+                for (uint16_t c2 : right_classes) {
+                    ss << (is_start ? " " : ", ") << st.class_values[(size_t)c1 * st.class2_count + c2] / font->ascent;
+                    is_start = false;
+                }
+            }
+            ss << " ] }";
+            is_start_table = false;
+        }
+    }
+    ss << " ]" << std::endl;
 
     ss << "};" << std::endl;
 
@@ -21,7 +21,10 @@
  */
 #pragma once
 
+#include <string>
+
 #include "glyph_painter.h"
+#include "msdf_painter.h"
 
 struct GlyphRect {
     uint32_t codepoint = 0;
@@ -50,7 +53,15 @@ struct SdfAtlas {
 
     void allocate_unicode_range( uint32_t start, uint32_t end ); // end is inclusive    
     
+    // Glyph origin in atlas pixels and font units to pixels scale
+    float glyph_scale() const;
+
+    F2 glyph_origin( const GlyphRect& gr ) const;
+
+    // Tessellates the glyphs into the painter, every atlas row goes to its own draw batch
     void draw_glyphs( GlyphPainter& gp ) const;
 
-    std::string json( float tex_height) const;
+    void draw_glyphs( MsdfPainter& mp ) const;
+
+    std::string json( float tex_height, const char *image_format, const char *mode ) const;
 };
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sdf_compute.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "parabola.h"
+#include "sdf_cpu.h"
+#include "stats.h"
+
+#include "shaders/tile_csh.cpp"
+
+
+static const uint32_t dist_bit = 0x40000000u;     // DIST_BIT of the compute shader
+static const uint32_t wind_bit = 0x80000000u;     // WIND_BIT
+static const uint32_t segment_mask = 0x3fffffffu; // SEGMENT_MASK
+
+bool SdfCompute::init() {
+    if ( !GLEW_VERSION_4_3 ) return false;
+    prog = createComputeProgram( "tile", tile_csh );
+    if ( !prog ) return false;
+    initUniformStruct( prog, unf );
+    glGenBuffers( 5, buffers );
+    return true;
+}
+
+static SdfCompute::Segment compute_segment( const SdfCpu::Segment& s ) {
+    SdfCompute::Segment res;
+    res.p0 = s.p0;
+    res.p1 = s.is_bez ? s.p1 : s.p0;
+    res.p2 = s.p2;
+    if ( s.is_bez ) {
+        Parabola par = Parabola::from_qbez( s.p0, s.p1, s.p2 );
+        res.vertex = par.mat[2];
+        res.xaxis  = par.mat[0];
+        res.yaxis  = par.mat[1];
+        res.scale  = par.scale;
+        res.xstart = par.xstart;
+        res.xend   = par.xend;
+        res.curve  = 1.0f;
+    } else {
+        res.vertex = res.xaxis = res.yaxis = F2( 0.0f );
+    }
+    return res;
+}
+
+// Winding contribution of a segment lying to the right of the texel, only the direction
+// of the crossing in the row matters. Same half-open y tests as in the compute shader.
+
+static int far_winding( const SdfCompute::Segment& s, float py ) {
+    auto dir = [py]( float y0, float y1 ) {
+        return y0 <= py && py < y1 ? 1 : y1 <= py && py < y0 ? -1 : 0;
+    };
+    if ( s.curve == 0.0f ) return dir( s.p0.y, s.p2.y );
+
+    // Splitting at the y extremum
+    float den = s.p0.y - 2.0f * s.p1.y + s.p2.y;
+    float te  = den != 0.0f ? ( s.p0.y - s.p1.y ) / den : -1.0f;
+    if ( te > 0.0f && te < 1.0f ) {
+        float mt = 1.0f - te;
+        float ye = mt * mt * s.p0.y + 2.0f * mt * te * s.p1.y + te * te * s.p2.y;
+        return dir( s.p0.y, ye ) + dir( ye, s.p2.y );
+    }
+    return dir( s.p0.y, s.p2.y );
+}
+
+void SdfCompute::bin( const SdfAtlas& atlas, int width, int height ) {
+    segments.clear();
+    tiles.clear();
+    entries.clear();
+    row_windings.clear();
+
+    int tiles_x = ( width + tile_size - 1 ) / tile_size;
+    float scale = atlas.glyph_scale();
+    float sqr_sdf_size = atlas.sdf_size * atlas.sdf_size;
+
+    // Tile index, entry and the distance from the tile to the segment bounding box.
+    // Far segments lie to the right of the tile and go to the winding numbers of its rows.
+    struct TileEntry {
+        uint32_t tile, entry;
+        float    sqr_dist;
+        bool     far;
+    };
+    std::vector<TileEntry> tile_entries;
+    std::vector<SdfCpu::Segment> glyph;
+
+    for ( const GlyphRect& gr : atlas.glyph_rects ) {
+        SdfCpu::glyph_segments( atlas.font, gr.glyph_idx, atlas.glyph_origin( gr ), scale, glyph );
+        uint32_t first = segments.size();
+        for ( const SdfCpu::Segment& s : glyph ) segments.push_back( compute_segment( s ) );
+
+        // Tiles of the texels with centers inside the rect
+        int x0 = std::max( 0, (int) ceilf( gr.x0 - 0.5f ) );
+        int x1 = std::min( width, (int) ceilf( gr.x1 - 0.5f ) );
+        int y0 = std::max( 0, (int) ceilf( gr.y0 - 0.5f ) );
+        int y1 = std::min( height, (int) ceilf( gr.y1 - 0.5f ) );
+        if ( x0 >= x1 || y0 >= y1 ) continue;
+
+        for ( int ty = y0 / tile_size; ty <= ( y1 - 1 ) / tile_size; ++ty ) {
+            for ( int tx = x0 / tile_size; tx <= ( x1 - 1 ) / tile_size; ++tx ) {
+                // Texel centers of the tile
+                float cx0 = tx * tile_size + 0.5f, cx1 = std::min( ( tx + 1 ) * tile_size, width ) - 0.5f;
+                float cy0 = ty * tile_size + 0.5f, cy1 = std::min( ( ty + 1 ) * tile_size, height ) - 0.5f;
+                uint32_t tile = ty * tiles_x + tx;
+
+                // Closed contours of the glyph add up to zero winding outside of their bounding box,
+                // so segments of the glyphs overlapping the tile are enough for every tile texel
+                for ( size_t is = 0; is < glyph.size(); ++is ) {
+                    const SdfCpu::Segment& s = glyph[ is ];
+                    uint32_t flags = 0;
+                    float dx = std::max( 0.0f, std::max( s.lo.x - cx1, cx0 - s.hi.x ) );
+                    float dy = std::max( 0.0f, std::max( s.lo.y - cy1, cy0 - s.hi.y ) );
+                    if ( dx * dx + dy * dy < sqr_sdf_size ) flags |= dist_bit;
+                    // Rays of the tile cross the segments past its right edge at x > lo.x,
+                    // half a pixel of margin is left for the rounding of the crossing
+                    bool crossing = s.hi.y >= cy0 && s.lo.y <= cy1 && s.hi.x >= cx0;
+                    bool far = crossing && s.lo.x > cx1 + 0.5f;
+                    if ( crossing && !far ) flags |= wind_bit;
+                    if ( flags || far ) tile_entries.push_back( TileEntry { tile, (uint32_t) ( first + is ) | flags, dx * dx + dy * dy, far } );
+                }
+            }
+        }
+    }
+
+    // Nearer segments first, so that the bounding box test skips more of the farther ones
+    std::sort( tile_entries.begin(), tile_entries.end(), []( const TileEntry& a, const TileEntry& b ) {
+        return a.tile != b.tile ? a.tile < b.tile : a.sqr_dist < b.sqr_dist;
+    } );
+
+    entries.reserve( tile_entries.size() );
+    for ( size_t ie = 0; ie < tile_entries.size(); ) {
+        uint32_t tile  = tile_entries[ ie ].tile;
+        uint32_t first = entries.size();
+        int ty = tile / tiles_x;
+        int rows[ tile_size ] = {};
+        for ( ; ie < tile_entries.size() && tile_entries[ ie ].tile == tile; ++ie ) {
+            const TileEntry& te = tile_entries[ ie ];
+            if ( te.entry & ( dist_bit | wind_bit ) ) entries.push_back( te.entry );
+            if ( !te.far ) continue;
+            const Segment& s = segments[ te.entry & segment_mask ];
+            for ( int r = 0; r < tile_size; ++r ) rows[ r ] += far_winding( s, ty * tile_size + r + 0.5f );
+        }
+
+        // Tiles inside of the glyphs farther than sdf_size from the outline have the row windings only
+        bool inside = std::any_of( rows, rows + tile_size, []( int w ) { return w != 0; } );
+        if ( entries.size() == first && !inside ) continue;
+        tiles.insert( tiles.end(), { tile % tiles_x, tile / tiles_x, first, (uint32_t) entries.size() } );
+        row_windings.insert( row_windings.end(), rows, rows + tile_size );
+    }
+}
+
+bool SdfCompute::render( const SdfAtlas& atlas, int width, int height, std::vector<float>& out ) {
+    {
+        StatsTimer st( "tile binning" );
+        bin( atlas, width, height );
+    }
+    int tile_count = tiles.size() / 4;
+    stats.count( "compute tiles", tile_count );
+    stats.count( "tile entries", entries.size() );
+
+    GLint64 max_block_size = 0;
+    glGetInteger64v( GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &max_block_size );
+    size_t image_size = (size_t) width * height * sizeof( float );
+    if ( (GLint64) image_size > max_block_size || (GLint64) ( segments.size() * sizeof( Segment ) ) > max_block_size ) {
+        std::cerr << "Atlas is too large for the compute backend" << std::endl;
+        return false;
+    }
+
+    const void *data[4] = { segments.data(), tiles.data(), entries.data(), row_windings.data() };
+    size_t sizes[4] = { segments.size() * sizeof( Segment ), tiles.size() * sizeof( uint32_t ),
+                        entries.size() * sizeof( uint32_t ), row_windings.size() * sizeof( int32_t ) };
+    for ( int ib = 0; ib < 4; ++ib ) {
+        glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers[ ib ] );
+        glBufferData( GL_SHADER_STORAGE_BUFFER, std::max<size_t>( sizes[ ib ], 16 ), nullptr, GL_STREAM_DRAW );
+        glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizes[ ib ], data[ ib ] );
+        glBindBufferBase( GL_SHADER_STORAGE_BUFFER, ib, buffers[ ib ] );
+    }
+
+    // Texels of the tiles without segments stay outside at the maximum distance
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers[4] );
+    glBufferData( GL_SHADER_STORAGE_BUFFER, image_size, nullptr, GL_STREAM_READ );
+    glClearBufferData( GL_SHADER_STORAGE_BUFFER, GL_R32F, GL_RED, GL_FLOAT, nullptr );
+    glBindBufferBase( GL_SHADER_STORAGE_BUFFER, 4, buffers[4] );
+
+    if ( tile_count > 0 ) {
+        // Work groups of the occupied tiles, wrapped to a second dimension past the group count limit
+        int groups_x = std::min( tile_count, 65535 );
+        int groups_y = ( tile_count + groups_x - 1 ) / groups_x;
+
+        glUseProgram( prog );
+        unf.tex_width.set( width );
+        unf.tex_height.set( height );
+        unf.tile_count.set( tile_count );
+        unf.groups_x.set( groups_x );
+        unf.sdf_size.set( atlas.sdf_size );
+        unf.tolerance.set( tolerance );
+        unf.even_odd.set( fill_rule == FillRule::EvenOdd ? 1.0f : 0.0f );
+        glDispatchCompute( groups_x, groups_y, 1 );
+        glUseProgram( 0 );
+    }
+
+    glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+    out.resize( (size_t) width * height );
+    glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, image_size, out.data() );
+    glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+    return true;
+}
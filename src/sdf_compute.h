@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "float2.h"
+#include "gl_utils.h"
+#include "sdf_gl.h"
+#include "sdf_atlas.h"
+
+// GL compute backend of the SDF mode, needs GL 4.3.
+// Outline segments are binned into square tiles of the atlas: a tile lists the segments closer
+// than sdf_size to it and the ones the +x rays of its texels can cross for the winding number.
+// Crossings of the segments past the right edge of the tile don't depend on x and are summed
+// per tile row at binning.
+// A work group per occupied tile evaluates its texels against the list only, so there is no
+// overdraw of the line quads and no min-reduction through the depth buffer.
+
+struct ComputeUnf {
+    UNIFORM( 1i, tex_width );
+    UNIFORM( 1i, tex_height );
+    UNIFORM( 1i, tile_count );
+    UNIFORM( 1i, groups_x );
+    UNIFORM( 1f, sdf_size );
+    UNIFORM( 1f, tolerance );
+    UNIFORM( 1f, even_odd );
+};
+
+struct SdfCompute {
+    static constexpr int tile_size = 8;        // TILE_SIZE of the compute shader
+
+    // Segment as laid out in the shader storage buffer
+    struct Segment {
+        F2    p0, p1;               // p1 is the control point of curves, p0 for straight segments
+        F2    p2, vertex;           // Parabola vertex in atlas pixels
+        F2    xaxis, yaxis;         // Parabola axes
+        float scale = 0.0f, xstart = 0.0f, xend = 0.0f;
+        float curve = 0.0f;         // 1.0 - parabolic segment, 0.0 - straight
+    };
+
+    FillRule fill_rule = FillRule::NonZero;
+
+    // Distance error the root solver iterates down to, in units of the SDF size
+    float tolerance = 1e-3f;
+
+    GLuint     prog = 0;
+    ComputeUnf unf;
+    GLuint     buffers[5] {};       // Segments, tiles, tile entries, row windings, image
+
+    // Binning of the last render
+    std::vector<Segment>  segments;
+    std::vector<uint32_t> tiles;    // Tile x, y, first and end entry
+    std::vector<uint32_t> entries;  // Segment index with the distance and winding flags
+    std::vector<int32_t>  row_windings; // Tile rows' winding numbers from the segments right of the tile
+
+    // False if compute shaders are not supported
+    bool init();
+
+    // Renders the atlas into 'out' as width * height normalized distances,
+    // 0.5 on the outline, rows from bottom to top, same as SdfCpu::render.
+    // False if the atlas doesn't fit into a shader storage buffer
+    bool render( const SdfAtlas& atlas, int width, int height, std::vector<float>& out );
+
+    // Builds the segment and tile lists
+    void bin( const SdfAtlas& atlas, int width, int height );
+};
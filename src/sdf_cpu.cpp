@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sdf_cpu.h"
+#include "parabola.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+
+static const double pi = 3.14159265358979323846;
+
+// Real roots of t^3 + a*t^2 + b*t + c = 0
+static int solve_cubic_normed( double a, double b, double c, double *roots ) {
+    double a3 = a / 3.0;
+    double q  = ( a * a - 3.0 * b ) / 9.0;
+    double r  = ( a * ( 2.0 * a * a - 9.0 * b ) + 27.0 * c ) / 54.0;
+    double q3 = q * q * q;
+
+    if ( r * r < q3 ) {
+        double t  = acos( std::max( -1.0, std::min( 1.0, r / sqrt( q3 ) ) ) );
+        double sq = -2.0 * sqrt( q );
+        roots[0] = sq * cos( t / 3.0 ) - a3;
+        roots[1] = sq * cos( ( t + 2.0 * pi ) / 3.0 ) - a3;
+        roots[2] = sq * cos( ( t - 2.0 * pi ) / 3.0 ) - a3;
+        return 3;
+    }
+
+    double u = -copysign( cbrt( fabs( r ) + sqrt( r * r - q3 ) ), r );
+    double v = u == 0.0 ? 0.0 : q / u;
+    roots[0] = ( u + v ) - a3;
+    return 1;
+}
+
+static double line_sqr_dist( double x0, double y0, double x1, double y1, double px, double py ) {
+    double dx = x1 - x0, dy = y1 - y0;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0.0 ? ( ( px - x0 ) * dx + ( py - y0 ) * dy ) / len2 : 0.0;
+    t = std::max( 0.0, std::min( 1.0, t ) );
+    double ex = x0 + dx * t - px, ey = y0 + dy * t - py;
+    return ex * ex + ey * ey;
+}
+
+static double segment_sqr_dist( const SdfCpu::Segment& s, double px, double py ) {
+    if ( !s.is_bez ) return line_sqr_dist( s.p0.x, s.p0.y, s.p2.x, s.p2.y, px, py );
+
+    // B(t) = p0 + 2t*a + t^2*b, closest point where dot( B(t) - p, B'(t) ) = 0
+    double ax = s.p1.x - s.p0.x,                  ay = s.p1.y - s.p0.y;
+    double bx = s.p2.x - 2.0 * s.p1.x + s.p0.x,   by = s.p2.y - 2.0 * s.p1.y + s.p0.y;
+    double mx = s.p0.x - px,                      my = s.p0.y - py;
+
+    double k3 = bx * bx + by * by;
+    double k2 = 3.0 * ( ax * bx + ay * by );
+    double k1 = 2.0 * ( ax * ax + ay * ay ) + mx * bx + my * by;
+    double k0 = mx * ax + my * ay;
+
+    double scale = ax * ax + ay * ay + k3;
+    if ( k3 <= 1e-12 * scale ) return line_sqr_dist( s.p0.x, s.p0.y, s.p2.x, s.p2.y, px, py );
+
+    double roots[3];
+    int nroots = solve_cubic_normed( k2 / k3, k1 / k3, k0 / k3, roots );
+
+    double ex = s.p2.x - px, ey = s.p2.y - py;
+    double res = std::min( mx * mx + my * my, ex * ex + ey * ey );
+    for ( int i = 0; i < nroots; ++i ) {
+        double t = roots[i];
+        if ( t <= 0.0 || t >= 1.0 ) continue;
+        double qx = mx + ( 2.0 * ax + bx * t ) * t;
+        double qy = my + ( 2.0 * ay + by * t ) * t;
+        res = std::min( res, qx * qx + qy * qy );
+    }
+    return res;
+}
+
+// Crossing of a y-monotonic part [t0, t1] of a quadratic curve with the line y = py,
+// returns its direction and x, 0 if there is none
+static int monotonic_crossing( const SdfCpu::Segment& s, double t0, double t1, double py, double& x ) {
+    double a = s.p0.y - 2.0 * s.p1.y + s.p2.y;
+    double b = 2.0 * ( s.p1.y - s.p0.y );
+    double c = s.p0.y;
+
+    double y0 = ( a * t0 + b ) * t0 + c;
+    double y1 = ( a * t1 + b ) * t1 + c;
+
+    // Half-open in y, so that the points shared by neighbouring parts count once
+    int dir;
+    if ( y0 <= py && py < y1 )      dir = 1;
+    else if ( y1 <= py && py < y0 ) dir = -1;
+    else return 0;
+
+    double t;
+    c -= py;
+    if ( fabs( a ) < 1e-12 ) {
+        t = -c / b;
+    } else {
+        double d = sqrt( std::max( 0.0, b * b - 4.0 * a * c ) );
+        double q = -0.5 * ( b + copysign( d, b ) );
+        double r0 = q / a;
+        double r1 = q != 0.0 ? c / q : r0;
+        double tm = 0.5 * ( t0 + t1 );
+        t = fabs( r0 - tm ) < fabs( r1 - tm ) ? r0 : r1;
+    }
+    t = std::max( t0, std::min( t1, t ) );
+
+    double mt = 1.0 - t;
+    x = mt * mt * s.p0.x + 2.0 * mt * t * s.p1.x + t * t * s.p2.x;
+    return dir;
+}
+
+// Crossings of the segment with the line y = py, returns their count
+static int row_crossings( const SdfCpu::Segment& s, double py, double xs[2], int dirs[2] ) {
+    if ( !s.is_bez ) {
+        double y0 = s.p0.y, y1 = s.p2.y;
+        if ( y0 <= py && py < y1 )      dirs[0] = 1;
+        else if ( y1 <= py && py < y0 ) dirs[0] = -1;
+        else return 0;
+        xs[0] = s.p0.x + ( py - y0 ) / ( y1 - y0 ) * ( s.p2.x - s.p0.x );
+        return 1;
+    }
+
+    // Splitting at the y extremum
+    double den = s.p0.y - 2.0 * s.p1.y + s.p2.y;
+    double te  = den != 0.0 ? ( s.p0.y - s.p1.y ) / den : -1.0;
+    int count = 0;
+    if ( te > 0.0 && te < 1.0 ) {
+        if ( ( dirs[ count ] = monotonic_crossing( s, 0.0, te, py, xs[ count ] ) ) ) count++;
+        if ( ( dirs[ count ] = monotonic_crossing( s, te, 1.0, py, xs[ count ] ) ) ) count++;
+    } else {
+        if ( ( dirs[ count ] = monotonic_crossing( s, 0.0, 1.0, py, xs[ count ] ) ) ) count++;
+    }
+    return count;
+}
+
+// Winding number of the ray from p in +x direction
+static int segment_winding( const SdfCpu::Segment& s, double px, double py ) {
+    double xs[2];
+    int dirs[2];
+    int count = row_crossings( s, py, xs, dirs );
+    int winding = 0;
+    for ( int i = 0; i < count; ++i ) {
+        if ( xs[i] > px ) winding += dirs[i];
+    }
+    return winding;
+}
+
+
+static void push_line( std::vector<SdfCpu::Segment>& segments, F2 p0, F2 p2 ) {
+    SdfCpu::Segment s;
+    s.p0 = s.p1 = p0;
+    s.p2 = p2;
+    s.is_bez = false;
+    s.lo = min( p0, p2 );
+    s.hi = max( p0, p2 );
+    segments.push_back( s );
+}
+
+
+void SdfCpu::glyph_segments( const Font *font, int glyph_index, F2 pos, float scale, std::vector<Segment>& segments ) {
+    segments.clear();
+    const Glyph& g = font->glyphs[ glyph_index ];
+    pos += g.command_offset * scale;
+
+    F2 start_pos { 0.0f }, prev_pos { 0.0f };
+    Segment s;
+    const F2 *points = font->glyph_points.data() + g.point_start;
+    for ( int ic = g.command_start; ic < g.command_start + g.command_count; ++ic ) {
+        switch ( font->glyph_commands[ ic ] ) {
+        case GlyphCommand::MoveTo:
+            start_pos = prev_pos = *points++ * scale + pos;
+            break;
+        case GlyphCommand::LineTo: {
+            F2 p1 = *points++ * scale + pos;
+            push_line( segments, prev_pos, p1 );
+            prev_pos = p1;
+            break;
+        }
+        case GlyphCommand::BezTo: {
+            F2 p1 = points[0] * scale + pos;
+            F2 p2 = points[1] * scale + pos;
+            points += 2;
+
+            // Degenerate curves go to the line kernel, as in LinePainter::qbez_to
+            switch ( qbez_type( normalize( prev_pos - p1 ), normalize( p2 - p1 ) ) ) {
+            case QbezType::Parabola:
+                s.p0 = prev_pos;
+                s.p1 = p1;
+                s.p2 = p2;
+                s.is_bez = true;
+                s.lo = min( min( s.p0, s.p1 ), s.p2 );
+                s.hi = max( max( s.p0, s.p1 ), s.p2 );
+                segments.push_back( s );
+                break;
+            case QbezType::Line:
+                push_line( segments, prev_pos, p2 );
+                break;
+            case QbezType::TwoLines: {
+                // Control point outside of the end points, the curve turns back at the farthest point
+                float l10 = length( prev_pos - p1 );
+                float l12 = length( p2 - p1 );
+                float qt = l10 / ( l10 + l12 );
+                float nqt = 1.0f - qt;
+                F2 qtop = prev_pos * ( nqt * nqt ) + p1 * ( 2.0f * nqt * qt ) + p2 * ( qt * qt );
+                push_line( segments, prev_pos, qtop );
+                push_line( segments, qtop, p2 );
+                break;
+            }
+            }
+            prev_pos = p2;
+            break;
+        }
+        case GlyphCommand::ClosePath:
+            if ( sqr_length( start_pos - prev_pos ) > 0.0f ) push_line( segments, prev_pos, start_pos );
+            prev_pos = start_pos;
+            break;
+        }
+    }
+}
+
+int SdfCpu::segment_crossings( const Segment& s, float py, Crossing crossings[2] ) {
+    double xs[2];
+    int dirs[2];
+    int count = row_crossings( s, py, xs, dirs );
+    for ( int i = 0; i < count; ++i ) crossings[i] = Crossing { (float) xs[i], dirs[i] };
+    return count;
+}
+
+float SdfCpu::signed_distance( const std::vector<Segment>& segments, F2 p, FillRule fill_rule, float max_dist ) {
+    double min_dist = (double) max_dist * max_dist;
+    int winding = 0;
+    for ( const Segment& s : segments ) {
+        winding += segment_winding( s, p.x, p.y );
+
+        // Distance to the bounding box is a lower bound, skipping the cubic solve when it can't be closer
+        double bx = std::max( 0.0, std::max( (double) s.lo.x - p.x, p.x - (double) s.hi.x ) );
+        double by = std::max( 0.0, std::max( (double) s.lo.y - p.y, p.y - (double) s.hi.y ) );
+        if ( bx * bx + by * by >= min_dist ) continue;
+
+        min_dist = std::min( min_dist, segment_sqr_dist( s, p.x, p.y ) );
+    }
+    float dist = sqrt( min_dist );
+    bool inside = fill_rule == FillRule::EvenOdd ? ( winding & 1 ) != 0 : winding != 0;
+    return inside ? dist : -dist;
+}
+
+std::vector<F2> SdfCpu::sample_offsets( int samples ) {
+    // Standard multisample patterns in 1/16 pixel units
+    static const int pattern2[]  = { 4, 4,  -4, -4 };
+    static const int pattern4[]  = { -2, -6,  6, -2,  -6, 2,  2, 6 };
+    static const int pattern8[]  = { 1, -3,  -1, 3,  5, 1,  -3, -5,  -5, 5,  -7, -1,  3, 7,  7, -7 };
+    static const int pattern16[] = { 1, 1,  -1, -3,  -3, 2,  4, -1,  -5, -2,  2, 5,  5, 3,  3, -5,
+                                     -2, 6,  0, -7,  -4, -6,  -6, 4,  -8, 0,  7, -4,  6, 7,  -7, -8 };
+    const int *pattern = samples == 2 ? pattern2 : samples == 4 ? pattern4 :
+                         samples == 8 ? pattern8 : samples == 16 ? pattern16 : nullptr;
+    if ( !pattern ) return { F2( 0.0f ) };
+
+    std::vector<F2> offsets;
+    for ( int i = 0; i < samples; ++i ) offsets.push_back( F2( pattern[ 2 * i ], pattern[ 2 * i + 1 ] ) * ( 1.0f / 16.0f ) );
+    return offsets;
+}
+
+void SdfCpu::render( const SdfAtlas& atlas, int width, int height, std::vector<float>& out ) const {
+    out.assign( (size_t) width * height, 0.0f );
+
+    float scale = atlas.glyph_scale();
+    float rcp_sdf_size = 1.0f / atlas.sdf_size;
+    std::vector<F2> offsets = sample_offsets( samples );
+    float rcp_samples = 1.0f / offsets.size();
+    std::atomic<size_t> next_glyph { 0 };
+
+    auto worker = [&]() {
+        std::vector<Segment> segments;
+        for (;;) {
+            size_t iglyph = next_glyph++;
+            if ( iglyph >= atlas.glyph_rects.size() ) break;
+            const GlyphRect& gr = atlas.glyph_rects[ iglyph ];
+
+            glyph_segments( atlas.font, gr.glyph_idx, atlas.glyph_origin( gr ), scale, segments );
+
+            // Texels with centers inside the rect
+            int x0 = std::max( 0, (int) ceilf( gr.x0 - 0.5f ) );
+            int x1 = std::min( width, (int) ceilf( gr.x1 - 0.5f ) );
+            int y0 = std::max( 0, (int) ceilf( gr.y0 - 0.5f ) );
+            int y1 = std::min( height, (int) ceilf( gr.y1 - 0.5f ) );
+
+            for ( int y = y0; y < y1; ++y ) {
+                float *row = out.data() + (size_t) y * width;
+                for ( int x = x0; x < x1; ++x ) {
+                    float sum = 0.0f;
+                    for ( F2 offset : offsets ) {
+                        F2 p = F2( x + 0.5f, y + 0.5f ) + offset;
+                        float sd = signed_distance( segments, p, fill_rule, atlas.sdf_size ) * rcp_sdf_size;
+                        sum += 0.5f + 0.5f * std::max( -1.0f, std::min( 1.0f, sd ) );
+                    }
+                    row[x] = sum * rcp_samples;
+                }
+            }
+        }
+    };
+
+    int nthreads = threads > 0 ? threads : std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector<std::thread> pool;
+    for ( int i = 1; i < nthreads; ++i ) pool.emplace_back( worker );
+    worker();
+    for ( std::thread& t : pool ) t.join();
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "float2.h"
+#include "font.h"
+#include "sdf_atlas.h"
+
+// CPU signed distance field renderer.
+// Computes exact distances to the outline segments (closest point on quadratic
+// curves from the cubic equation) and the sign from the winding number and the fill rule,
+// at texel centers of every glyph rect. Serves as the quality reference for the
+// GL renderer and as the "cpu" backend. Glyphs are shared between threads.
+
+struct SdfCpu {
+    struct Segment {
+        F2   p0, p1, p2;            // p1 is the control point for curves
+        F2   lo, hi;                // Bounding box of the control points, contains the segment
+        bool is_bez = false;
+    };
+
+    // Outline crossing of a horizontal line, +1 going up
+    struct Crossing {
+        float x;
+        int   dir;
+    };
+
+    int threads = 0;                // 0 - hardware concurrency
+
+    FillRule fill_rule = FillRule::NonZero;
+
+    // Samples per texel averaged into it, as the multisampled GL passes: 1, 2, 4, 8 or 16
+    int samples = 1;
+
+    // Renders the atlas into 'out' as width * height normalized distances,
+    // 0.5 on the outline, rows from bottom to top like the GL framebuffer
+    void render( const SdfAtlas& atlas, int width, int height, std::vector<float>& out ) const;
+
+    // Glyph outline in atlas pixels
+    static void glyph_segments( const Font *font, int glyph_index, F2 pos, float scale, std::vector<Segment>& segments );
+
+    // Distance to the outline, positive inside. Distances beyond max_dist come out as max_dist,
+    // segments whose bounding box is farther than the nearest one so far are skipped
+    static float signed_distance( const std::vector<Segment>& segments, F2 p, FillRule fill_rule = FillRule::NonZero,
+                                  float max_dist = 1e30f );
+
+    // Standard sample positions of the sample count relative to the texel center, in pixels
+    static std::vector<F2> sample_offsets( int samples );
+
+    // Crossings of the segment with the line y = py, half-open in y as in the winding number.
+    // Returns their count, at most 2
+    static int segment_crossings( const Segment& s, float py, Crossing crossings[2] );
+};
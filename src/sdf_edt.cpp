@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sdf_edt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "sdf_cpu.h"
+
+static const float edt_inf = 1e20f;
+
+// Squared distance transform of n samples of f, the lower envelope of the parabolas
+// rooted at the samples. v and z hold the envelope's parabolas and their boundaries.
+static void edt_1d( const float *f, float *d, int n, int *v, float *z ) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -edt_inf;
+    z[1] = edt_inf;
+    for ( int q = 1; q < n; ++q ) {
+        float s;
+        for (;;) {
+            int r = v[k];
+            s = ( ( f[q] + (float) q * q ) - ( f[r] + (float) r * r ) ) / ( 2.0f * ( q - r ) );
+            if ( s > z[k] || k == 0 ) break;
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = edt_inf;
+    }
+
+    k = 0;
+    for ( int q = 0; q < n; ++q ) {
+        while ( z[k + 1] < q ) ++k;
+        float dq = (float) ( q - v[k] );
+        d[q] = dq * dq + f[ v[k] ];
+    }
+}
+
+// Distances in y from the samples of a w * h grid to the nearest sample with the given coverage
+// in the same column, swept for every column at once as in the first phase of Meijster's algorithm
+static void column_distances( const uint8_t *coverage, uint8_t feature, float *grid, int w, int h ) {
+    for ( int x = 0; x < w; ++x ) grid[x] = coverage[x] == feature ? 0.0f : edt_inf;
+    for ( int y = 1; y < h; ++y ) {
+        const float *prev = grid + (size_t) ( y - 1 ) * w;
+        float *row = grid + (size_t) y * w;
+        const uint8_t *crow = coverage + (size_t) y * w;
+        for ( int x = 0; x < w; ++x ) row[x] = crow[x] == feature ? 0.0f : prev[x] + 1.0f;
+    }
+    for ( int y = h - 2; y >= 0; --y ) {
+        const float *next = grid + (size_t) ( y + 1 ) * w;
+        float *row = grid + (size_t) y * w;
+        for ( int x = 0; x < w; ++x ) row[x] = std::min( row[x], next[x] + 1.0f );
+    }
+}
+
+// Column distances of a row to the squared Euclidean distances in place
+static void row_sqr_distances( float *row, int w, std::vector<float>& f, std::vector<int>& v, std::vector<float>& z ) {
+    f.resize( w );
+    v.resize( w );
+    z.resize( w + 1 );
+    for ( int x = 0; x < w; ++x ) f[x] = row[x] < edt_inf * 0.5f ? row[x] * row[x] : edt_inf;
+    edt_1d( f.data(), row, w, v.data(), z.data() );
+}
+
+void SdfEdt::render( const SdfAtlas& atlas, int width, int height, std::vector<float>& out ) const {
+    out.assign( (size_t) width * height, 0.0f );
+
+    float scale = atlas.glyph_scale();
+    int   ss = std::max( 1, supersample );
+    float rcp_ss = 1.0f / ss;
+    float rcp_sdf_size = 1.0f / atlas.sdf_size;
+    std::atomic<size_t> next_glyph { 0 };
+
+    // Samples farther than sdf_size from the texels don't change their distances
+    int margin = (int) ceilf( atlas.sdf_size );
+
+    auto worker = [&]() {
+        // Outline crossing of a sample row
+        struct RowCrossing {
+            int   row;
+            float x;
+            int   dir;
+        };
+
+        std::vector<SdfCpu::Segment> segments;
+        std::vector<RowCrossing> crossings;
+        std::vector<uint8_t> inside;
+        std::vector<float>   to_inside, to_outside;     // Squared distances in samples
+        std::vector<float>   f, z;
+        std::vector<int>     v;
+
+        for (;;) {
+            size_t iglyph = next_glyph++;
+            if ( iglyph >= atlas.glyph_rects.size() ) break;
+            const GlyphRect& gr = atlas.glyph_rects[ iglyph ];
+
+            // Texels with centers inside the rect, as in SdfCpu
+            int x0 = std::max( 0, (int) ceilf( gr.x0 - 0.5f ) );
+            int x1 = std::min( width, (int) ceilf( gr.x1 - 0.5f ) );
+            int y0 = std::max( 0, (int) ceilf( gr.y0 - 0.5f ) );
+            int y1 = std::min( height, (int) ceilf( gr.y1 - 0.5f ) );
+            if ( x0 >= x1 || y0 >= y1 ) continue;
+
+            SdfCpu::glyph_segments( atlas.font, gr.glyph_idx, atlas.glyph_origin( gr ), scale, segments );
+
+            // Sample grid over the texels, extended to the parts of the outline
+            // within sdf_size of them that stick out of the rect
+            int gx0 = x0, gx1 = x1, gy0 = y0, gy1 = y1;
+            for ( const SdfCpu::Segment& s : segments ) {
+                gx0 = std::min( gx0, (int) floorf( s.lo.x ) );
+                gy0 = std::min( gy0, (int) floorf( s.lo.y ) );
+                gx1 = std::max( gx1, (int) ceilf( s.hi.x ) );
+                gy1 = std::max( gy1, (int) ceilf( s.hi.y ) );
+            }
+            gx0 = std::max( gx0, x0 - margin );
+            gy0 = std::max( gy0, y0 - margin );
+            gx1 = std::min( gx1, x1 + margin );
+            gy1 = std::min( gy1, y1 + margin );
+
+            int w = ( gx1 - gx0 ) * ss, h = ( gy1 - gy0 ) * ss;
+            size_t sample_count = (size_t) w * h;
+
+            // Crossings of the sample rows, every segment goes to the rows it spans only
+            crossings.clear();
+            for ( const SdfCpu::Segment& s : segments ) {
+                int r0 = std::max( 0, (int) ceilf( ( s.lo.y - gy0 ) * ss - 0.5f ) );
+                int r1 = std::min( h - 1, (int) floorf( ( s.hi.y - gy0 ) * ss - 0.5f ) );
+                for ( int r = r0; r <= r1; ++r ) {
+                    SdfCpu::Crossing sc[2];
+                    int count = SdfCpu::segment_crossings( s, gy0 + ( r + 0.5f ) * rcp_ss, sc );
+                    for ( int i = 0; i < count; ++i ) crossings.push_back( RowCrossing { r, sc[i].x, sc[i].dir } );
+                }
+            }
+            std::sort( crossings.begin(), crossings.end(), []( const RowCrossing& a, const RowCrossing& b ) {
+                return a.row != b.row ? a.row < b.row : a.x < b.x;
+            } );
+
+            // Coverage of the samples, winding numbers of the +x rays from the sorted crossings
+            inside.assign( sample_count, 0 );
+            for ( size_t ic = 0; ic < crossings.size(); ) {
+                size_t row_end = ic;
+                int winding = 0;
+                for ( ; row_end < crossings.size() && crossings[ row_end ].row == crossings[ ic ].row; ++row_end ) {
+                    winding += crossings[ row_end ].dir;
+                }
+                uint8_t *row = inside.data() + (size_t) crossings[ ic ].row * w;
+                for ( int sx = 0; sx < w; ++sx ) {
+                    float px = gx0 + ( sx + 0.5f ) * rcp_ss;
+                    for ( ; ic < row_end && crossings[ ic ].x <= px; ++ic ) winding -= crossings[ ic ].dir;
+                    row[ sx ] = fill_rule == FillRule::EvenOdd ? ( winding & 1 ) != 0 : winding != 0;
+                }
+                ic = row_end;
+            }
+            // Samples around the texel centers, one for odd supersampling and two for even
+            auto center_samples = [ss]( int t ) {
+                int c2 = 2 * t * ss + ss - 1;                   // Twice the sample coordinate of the center
+                return std::make_pair( c2 / 2, ( c2 + 1 ) / 2 );
+            };
+
+            // Squared distances at the rows of the texel centers only
+            to_inside.resize( sample_count );
+            to_outside.resize( sample_count );
+            column_distances( inside.data(), 1, to_inside.data(), w, h );
+            column_distances( inside.data(), 0, to_outside.data(), w, h );
+            for ( int y = y0; y < y1; ++y ) {
+                auto rows = center_samples( y - gy0 );
+                for ( int r : { rows.first, rows.second } ) {
+                    if ( r == rows.second && rows.first == rows.second ) break;
+                    row_sqr_distances( to_inside.data() + (size_t) r * w, w, f, v, z );
+                    row_sqr_distances( to_outside.data() + (size_t) r * w, w, f, v, z );
+                }
+            }
+
+            // The outline lies half a sample from the nearest sample on the other side of it
+            for ( int y = y0; y < y1; ++y ) {
+                auto rows = center_samples( y - gy0 );
+                float *dst = out.data() + (size_t) y * width;
+                for ( int x = x0; x < x1; ++x ) {
+                    auto cols = center_samples( x - gx0 );
+                    float sum = 0.0f;
+                    for ( int r : { rows.first, rows.second } ) {
+                        for ( int c : { cols.first, cols.second } ) {
+                            size_t i = (size_t) r * w + c;
+                            sum += inside[i] ? sqrtf( to_outside[i] ) - 0.5f : 0.5f - sqrtf( to_inside[i] );
+                        }
+                    }
+                    float sd = sum * 0.25f * rcp_ss * rcp_sdf_size;
+                    dst[x] = 0.5f + 0.5f * std::max( -1.0f, std::min( 1.0f, sd ) );
+                }
+            }
+        }
+    };
+
+    int nthreads = threads > 0 ? threads : std::max( 1u, std::thread::hardware_concurrency() );
+    std::vector<std::thread> pool;
+    for ( int i = 1; i < nthreads; ++i ) pool.emplace_back( worker );
+    worker();
+    for ( std::thread& t : pool ) t.join();
+}
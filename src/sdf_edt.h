@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "font.h"
+#include "sdf_atlas.h"
+
+// Approximate CPU signed distance field renderer, the "edt" backend.
+// Glyph coverage is rasterized from the outline segments at 'supersample' times the atlas
+// resolution, the exact Euclidean distance transform of the coverage (separable, linear time,
+// Felzenszwalb and Huttenlocher) gives the distances at the samples. Texels take the distance
+// at their center: the center sample for odd 'supersample', the average of the four samples
+// around it for even. Trades the analytic precision for a cost per sample independent
+// of the segment count, the error is about a quarter of a sample.
+
+struct SdfEdt {
+    int threads = 0;                // 0 - hardware concurrency
+    int supersample = 4;            // Coverage samples per texel in x and y
+
+    FillRule fill_rule = FillRule::NonZero;
+
+    // Renders the atlas into 'out' as width * height normalized distances,
+    // 0.5 on the outline, rows from bottom to top, same as SdfCpu::render
+    void render( const SdfAtlas& atlas, int width, int height, std::vector<float>& out ) const;
+};
@@ -22,11 +22,18 @@
 
 #include "sdf_gl.h"
 
+#include <algorithm>
+#include <iostream>
+#include <string>
+
 #include "shaders/shape_vsh.cpp"
 #include "shaders/shape_fsh.cpp"
+#include "shaders/winding_fsh.cpp"
+#include "shaders/resolve_fsh.cpp"
 
 #include "shaders/line_vsh.cpp"
 #include "shaders/line_fsh.cpp"
+#include "shaders/msdf_fsh.cpp"
 
 
 VertexAttrib vattribs[] = {
@@ -39,30 +46,206 @@ VertexAttrib vattribs[] = {
 
 constexpr size_t vattribs_count = sizeof( vattribs ) / sizeof( vattribs[0] );
 
+// Straight segment and multisampled variants of the distance shaders are compiled from the same sources
+static std::string shader_variant( const char *source, bool straight, bool multisample = false ) {
+    std::string res = multisample ? "#version 400 compatibility\n#define MULTISAMPLE\n" : "";
+    if ( straight ) res += "#define STRAIGHT_SEGMENT\n";
+    return res + source;
+}
+
 void SdfGl::init() {
     initVertexAttribs( vattribs, vattribs_count );
     fill_prog = createProgram( "fill", shape_vsh, shape_fsh, vattribs, vattribs_count );
     initUniformStruct( fill_prog, ufill );
 
+    winding_prog = createProgram( "winding", shape_vsh, winding_fsh, vattribs, vattribs_count );
+    initUniformStruct( winding_prog, uwinding );
+
     line_prog = createProgram( "line", line_vsh, line_fsh, vattribs, vattribs_count );
     initUniformStruct( line_prog, uline );
+
+    line_straight_prog = createProgram( "line straight", line_vsh, shader_variant( line_fsh, true ).c_str(), vattribs, vattribs_count );
+    initUniformStruct( line_straight_prog, uline_straight );
+
+    msdf_prog = createProgram( "msdf", line_vsh, msdf_fsh, vattribs, vattribs_count );
+    initUniformStruct( msdf_prog, umsdf );
+
+    msdf_straight_prog = createProgram( "msdf straight", line_vsh, shader_variant( msdf_fsh, true ).c_str(), vattribs, vattribs_count );
+    initUniformStruct( msdf_straight_prog, umsdf_straight );
+
+    // Per sample shading and multisampled texture fetches
+    if ( GLEW_VERSION_4_0 ) {
+        line_ms_prog = createProgram( "line multisample", line_vsh, shader_variant( line_fsh, false, true ).c_str(), vattribs, vattribs_count );
+        initUniformStruct( line_ms_prog, uline_ms );
+
+        line_straight_ms_prog = createProgram( "line straight multisample", line_vsh, shader_variant( line_fsh, true, true ).c_str(),
+                                               vattribs, vattribs_count );
+        initUniformStruct( line_straight_ms_prog, uline_straight_ms );
+
+        resolve_prog = createProgram( "resolve", shape_vsh, resolve_fsh, vattribs, vattribs_count );
+        initUniformStruct( resolve_prog, uresolve );
+    }
 }
 
-void SdfGl::render_sdf( F2 tex_size, const std::vector<SdfVertex> &fill_vertices, const std::vector<SdfVertex> &line_vertices ) {
+int SdfGl::max_samples() const {
+    if ( !line_ms_prog || !line_straight_ms_prog || !resolve_prog ) return 1;
+    GLint max_color = 1, max_depth = 1;
+    glGetIntegerv( GL_MAX_COLOR_TEXTURE_SAMPLES, &max_color );
+    glGetIntegerv( GL_MAX_SAMPLES, &max_depth );
+    return std::max( 1, std::min( max_color, max_depth ) );
+}
 
-    // full screen quad vertices    
-    SdfVertex fs_quad[6] = {
-        { F2( -1.0, -1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
-        { F2(  1.0, -1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
-        { F2(  1.0,  1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
+// full screen quad vertices    
+static const SdfVertex fs_quad[6] = {
+    { F2( -1.0, -1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
+    { F2(  1.0, -1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
+    { F2(  1.0,  1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
         
-        { F2( -1.0, -1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
-        { F2(  1.0,  1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
-        { F2( -1.0,  1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f }
-    };
+    { F2( -1.0, -1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
+    { F2(  1.0,  1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f },
+    { F2( -1.0,  1.0 ), F2( 0.0f, 1.0f ), F2( 0.0f ), 0.0f, 0.0f }
+};
+
+// identity matrix
+static const float mid[] = {
+    1, 0, 0,
+    0, 1, 0,
+    0, 0, 1
+};
+
+/* Winding numbers of the fill triangles are counted in the stencil in one pass: front (CCW) faces increase
+and back (CW) faces decrease the value, both wrapping around. Low 8 bits of the winding number are nonzero
+inside the outline for the nonzero rule, the lowest bit is its parity for the even-odd rule, so contours can have
+any orientation and nesting. */
+void SdfGl::fill_stencil() {
+    glEnable( GL_STENCIL_TEST );
+    glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+    glStencilFunc( GL_ALWAYS, 0, 0xff );
+    glStencilOpSeparate( GL_FRONT, GL_KEEP, GL_INCR_WRAP, GL_INCR_WRAP );
+    glStencilOpSeparate( GL_BACK,  GL_KEEP, GL_DECR_WRAP, GL_DECR_WRAP );
+}
+
+GLuint SdfGl::fill_stencil_mask() const {
+    return fill_rule == FillRule::EvenOdd ? 0x01 : 0xff;
+}
+
+// Sets the scissor rect of the batch, false if it is outside of the target
+static bool batch_scissor( const DrawBatch& batch, F2 tex_size ) {
+    int x0 = std::max( batch.x0, 0 ), x1 = std::min( batch.x1, (int) tex_size.x );
+    int y0 = std::max( batch.y0, 0 ), y1 = std::min( batch.y1, (int) tex_size.y );
+    if ( x0 >= x1 || y0 >= y1 ) return false;
+    glScissor( x0, y0, x1 - x0, y1 - y0 );
+    return true;
+}
+
+// Clears the buffers within the batches, all batches are cleared before drawing
+// so that overlapping ones do not wipe each other. Scissored clears are slower than
+// a full one, the whole target is cleared when the batches cover most of it.
+static void clear_batches( GLbitfield mask, F2 tex_size, const std::vector<DrawBatch>& batches ) {
+    double area = 0.0;
+    for ( const DrawBatch& batch : batches ) {
+        area += (double) ( batch.x1 - batch.x0 ) * ( batch.y1 - batch.y0 );
+    }
+    if ( area > 0.5 * tex_size.x * tex_size.y ) {
+        glClear( mask );
+        return;
+    }
 
-    size_t lcount = line_vertices.size();
-    size_t fcount = fill_vertices.size();
+    glEnable( GL_SCISSOR_TEST );
+    for ( const DrawBatch& batch : batches ) {
+        if ( batch_scissor( batch, tex_size ) ) glClear( mask );
+    }
+    glDisable( GL_SCISSOR_TEST );
+}
+
+// Draws the vertex ranges of the batches within the target without the scissor test,
+// the vertices stay inside their batches. Ranges of consecutive batches are merged.
+template <class Range>
+static void draw_batches( F2 tex_size, const std::vector<DrawBatch>& batches, Range range ) {
+    size_t start = 0, end = 0;
+    for ( const DrawBatch& batch : batches ) {
+        if ( !batch_scissor( batch, tex_size ) ) continue;
+        std::pair<size_t, size_t> r = range( batch );
+        if ( r.first != end ) {
+            if ( end > start ) glDrawArrays( GL_TRIANGLES, start, end - start );
+            start = r.first;
+        }
+        end = r.second;
+    }
+    if ( end > start ) glDrawArrays( GL_TRIANGLES, start, end - start );
+}
+
+bool SdfGl::winding_target( int width, int height ) {
+    int target_samples = samples > 1 ? samples : 0;
+    if ( winding_tex && winding_width == width && winding_height == height && winding_samples == target_samples ) {
+        glBindFramebuffer( GL_FRAMEBUFFER, winding_fbo );
+        return true;
+    }
+
+    // Texture target can't change, switching between the plain and multisampled textures needs a new one
+    if ( winding_tex && winding_samples != target_samples ) {
+        glDeleteTextures( 1, &winding_tex );
+        winding_tex = 0;
+    }
+    if ( !winding_tex ) glGenTextures( 1, &winding_tex );
+    if ( !winding_fbo ) glGenFramebuffers( 1, &winding_fbo );
+
+    GLenum target = target_samples ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+    glBindTexture( target, winding_tex );
+    if ( target_samples ) {
+        glTexImage2DMultisample( target, target_samples, GL_R16F, width, height, GL_TRUE );
+    } else {
+        glTexImage2D( target, 0, GL_R16F, width, height, 0, GL_RED, GL_FLOAT, nullptr );
+        glTexParameteri( target, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glTexParameteri( target, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        glTexParameteri( target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        glTexParameteri( target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    }
+    glBindTexture( target, 0 );
+
+    glBindFramebuffer( GL_FRAMEBUFFER, winding_fbo );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, winding_tex, 0 );
+    bool complete = glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE;
+
+    winding_width   = complete ? width : 0;
+    winding_height  = complete ? height : 0;
+    winding_samples = target_samples;
+    return complete;
+}
+
+bool SdfGl::multisample_target( int width, int height ) {
+    if ( ms_color_tex && ms_width == width && ms_height == height && ms_samples == samples ) {
+        glBindFramebuffer( GL_FRAMEBUFFER, ms_fbo );
+        return true;
+    }
+
+    if ( !ms_color_tex ) {
+        glGenTextures( 1, &ms_color_tex );
+        glGenRenderbuffers( 1, &ms_depth_rb );
+        glGenFramebuffers( 1, &ms_fbo );
+    }
+
+    glBindTexture( GL_TEXTURE_2D_MULTISAMPLE, ms_color_tex );
+    glTexImage2DMultisample( GL_TEXTURE_2D_MULTISAMPLE, samples, GL_R32F, width, height, GL_TRUE );
+    glBindTexture( GL_TEXTURE_2D_MULTISAMPLE, 0 );
+
+    glBindRenderbuffer( GL_RENDERBUFFER, ms_depth_rb );
+    glRenderbufferStorageMultisample( GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height );
+    glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+    glBindFramebuffer( GL_FRAMEBUFFER, ms_fbo );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, ms_color_tex, 0 );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, ms_depth_rb );
+    bool complete = glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE;
+
+    ms_width   = complete ? width : 0;
+    ms_height  = complete ? height : 0;
+    ms_samples = complete ? samples : 0;
+    return complete;
+}
+
+void SdfGl::render_sdf( F2 tex_size, const std::vector<SdfVertex> &fill_vertices, const std::vector<SdfVertex> &line_vertices,
+                        const std::vector<SdfVertex> &straight_vertices, const std::vector<DrawBatch> &batches ) {
 
     // screen matrix
     float mscreen3[] = {
@@ -70,76 +253,192 @@ void SdfGl::render_sdf( F2 tex_size, const std::vector<SdfVertex> &fill_vertices
           0, 2.0f / tex_size.y, 0,
           -1, -1, 1 };
 
-    // identity matrix
-    float mid[] = {
-        1, 0, 0,
-        0, 1, 0,
-        0, 0, 1
-    };
+    GLint atlas_fbo = 0;
+    glGetIntegerv( GL_FRAMEBUFFER_BINDING, &atlas_fbo );
 
     glViewport( 0, 0, tex_size.x, tex_size.y );    
 
     glBindBuffer( GL_ARRAY_BUFFER, 0 );
 
-    // Drawing lines with depth test
+    // Summing fill winding numbers, front faces add 1 and back faces subtract 1
 
-    if ( line_vertices.size() ) {
-    
-        bindAttribs( vattribs, vattribs_count, (size_t) line_vertices.data() );
+    bool multisample = samples > 1;
 
-        glUseProgram( line_prog );
-        uline.transform_matrix.setv( mscreen3 );
-        glEnable( GL_DEPTH_TEST );
-        glDepthFunc( GL_LEQUAL );
-        glDrawArrays( GL_TRIANGLES, 0, lcount );    
-        glDisable( GL_DEPTH_TEST );
+    if ( !winding_target( tex_size.x, tex_size.y ) ) {
+        std::cerr << "Error creating winding number framebuffer!" << std::endl;
+        glBindFramebuffer( GL_FRAMEBUFFER, atlas_fbo );
+        return;
+    }
 
+    // Every sample is shaded on its own, with the inputs interpolated at the sample
+    if ( multisample ) {
+        glEnable( GL_SAMPLE_SHADING );
+        glMinSampleShading( 1.0f );
     }
 
-    // Drawing fills
+    glClearColor( 0.0, 0.0, 0.0, 0.0 );
+    clear_batches( GL_COLOR_BUFFER_BIT, tex_size, batches );
 
-    if ( fill_vertices.size() ) {
-    
-        bindAttribs( vattribs, vattribs_count, (size_t) fill_vertices.data() );
-    
-        glUseProgram( fill_prog );
-        ufill.transform_matrix.setv( mscreen3 );
-    
-        glEnable( GL_STENCIL_TEST );
-        glEnable( GL_CULL_FACE );
-        glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+    bindAttribs( vattribs, vattribs_count, (size_t) fill_vertices.data() );
 
-        glStencilFunc( GL_ALWAYS, 0, 0xff );
+    glUseProgram( winding_prog );
+    uwinding.transform_matrix.setv( mscreen3 );
 
-        // Front face (CCW) increases stencil values
-        glCullFace( GL_FRONT );
-        glStencilOp( GL_KEEP, GL_INCR, GL_INCR );
-        glDrawArrays( GL_TRIANGLES, 0, fcount );
+    glEnable( GL_BLEND );
+    glBlendEquation( GL_FUNC_ADD );
+    glBlendFunc( GL_ONE, GL_ONE );
+    draw_batches( tex_size, batches, []( const DrawBatch& b ) { return std::make_pair( b.fill_start, b.fill_end ); } );
+    glDisable( GL_BLEND );
+
+    // Multisampled distances go to their own target, cleared to the outside value as the atlas
+
+    if ( multisample ) {
+        if ( !multisample_target( tex_size.x, tex_size.y ) ) {
+            std::cerr << "Error creating multisample framebuffer!" << std::endl;
+            glDisable( GL_SAMPLE_SHADING );
+            glBindFramebuffer( GL_FRAMEBUFFER, atlas_fbo );
+            return;
+        }
+        clear_batches( GL_COLOR_BUFFER_BIT, tex_size, batches );
+    } else {
+        glBindFramebuffer( GL_FRAMEBUFFER, atlas_fbo );
+    }
 
-        // Back face (CW) decreaces
-        glCullFace( GL_BACK );
-        glStencilOp( GL_KEEP, GL_DECR, GL_DECR );
-        glDrawArrays( GL_TRIANGLES, 0, fcount );
+    // Drawing signed distance with depth test, the sign comes from the winding numbers
+
+    GLenum winding_target_type = multisample ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+    glActiveTexture( GL_TEXTURE0 );
+    glBindTexture( winding_target_type, winding_tex );
+
+    glDepthFunc( GL_LEQUAL );
+
+    // Stencil is unused, clearing it along with depth is faster than keeping it
+    clear_batches( GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, tex_size, batches );
+
+    glEnable( GL_DEPTH_TEST );
+
+    auto draw_segments = [&]( GLuint prog, const LineUnf& unf, const std::vector<SdfVertex>& vertices, auto range ) {
+        bindAttribs( vattribs, vattribs_count, (size_t) vertices.data() );
+        glUseProgram( prog );
+        unf.transform_matrix.setv( mscreen3 );
+        unf.winding_tex.set( 0 );
+        unf.tex_size.set( tex_size.x, tex_size.y );
+        unf.even_odd.set( fill_rule == FillRule::EvenOdd ? 1.0f : 0.0f );
+        unf.tolerance.set( tolerance );
+        draw_batches( tex_size, batches, range );
+    };
+    draw_segments( multisample ? line_straight_ms_prog : line_straight_prog, multisample ? uline_straight_ms : uline_straight,
+                   straight_vertices,
+                   []( const DrawBatch& b ) { return std::make_pair( b.straight_start[0], b.straight_end[0] ); } );
+    draw_segments( multisample ? line_ms_prog : line_prog, multisample ? uline_ms : uline, line_vertices,
+                   []( const DrawBatch& b ) { return std::make_pair( b.line_start[0], b.line_end[0] ); } );
 
-        glDisable( GL_CULL_FACE );    
+    glDisable( GL_DEPTH_TEST );
 
-        // Drawing full screen quad, inverting colors where stencil == 1
+    glBindTexture( winding_target_type, 0 );
 
+    // Averaging the samples into the atlas, the full screen quad is limited by the batch scissor
+
+    if ( multisample ) {
+        glDisable( GL_SAMPLE_SHADING );
+        glBindFramebuffer( GL_FRAMEBUFFER, atlas_fbo );
+
+        glBindTexture( GL_TEXTURE_2D_MULTISAMPLE, ms_color_tex );
+        glUseProgram( resolve_prog );
+        uresolve.transform_matrix.setv( mid );
+        uresolve.color_tex.set( 0 );
+        uresolve.samples.set( samples );
         bindAttribs( vattribs, vattribs_count, (size_t) fs_quad );
 
-        glEnable( GL_BLEND );
-        glBlendEquation( GL_FUNC_ADD );
-        glBlendFunc( GL_ONE_MINUS_DST_COLOR, GL_ZERO );
-        glStencilFunc( GL_EQUAL, 1, 0xff );
-        glStencilOp( GL_ZERO, GL_ZERO, GL_ZERO );
-        glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
-        ufill.transform_matrix.setv( mid );
-        glDrawArrays( GL_TRIANGLES, 0, 6 );
+        glEnable( GL_SCISSOR_TEST );
+        for ( const DrawBatch& batch : batches ) {
+            if ( batch_scissor( batch, tex_size ) ) glDrawArrays( GL_TRIANGLES, 0, 6 );
+        }
+        glDisable( GL_SCISSOR_TEST );
+        glBindTexture( GL_TEXTURE_2D_MULTISAMPLE, 0 );
+    }
+
+    glUseProgram( 0 );
+}
+
+void SdfGl::render_msdf( F2 tex_size, const std::vector<SdfVertex> &fill_vertices,
+                         const std::vector<SdfVertex> &r_vertices,
+                         const std::vector<SdfVertex> &g_vertices,
+                         const std::vector<SdfVertex> &b_vertices,
+                         const std::vector<SdfVertex> &r_straight_vertices,
+                         const std::vector<SdfVertex> &g_straight_vertices,
+                         const std::vector<SdfVertex> &b_straight_vertices,
+                         const std::vector<DrawBatch> &batches ) {
+    const std::vector<SdfVertex>* channel_vertices[3] = { &r_vertices, &g_vertices, &b_vertices };
+    const std::vector<SdfVertex>* channel_straight_vertices[3] = { &r_straight_vertices, &g_straight_vertices, &b_straight_vertices };
 
+    // screen matrix
+    float mscreen3[] = {
+          2.0f / tex_size.x, 0, 0,
+          0, 2.0f / tex_size.y, 0,
+          -1, -1, 1 };
+
+    glViewport( 0, 0, tex_size.x, tex_size.y );    
+
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+    // Filling glyph interior with 1.0, the full screen quad is limited by the batch scissor
+
+    clear_batches( GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, tex_size, batches );
+
+    glUseProgram( fill_prog );
+
+    bindAttribs( vattribs, vattribs_count, (size_t) fill_vertices.data() );
+    ufill.transform_matrix.setv( mscreen3 );
+    fill_stencil();
+    draw_batches( tex_size, batches, []( const DrawBatch& b ) { return std::make_pair( b.fill_start, b.fill_end ); } );
+
+    bindAttribs( vattribs, vattribs_count, (size_t) fs_quad );
+
+    glStencilFunc( GL_NOTEQUAL, 0, fill_stencil_mask() );
+    glStencilOp( GL_ZERO, GL_ZERO, GL_ZERO );
+    glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+    ufill.transform_matrix.setv( mid );
+    glEnable( GL_SCISSOR_TEST );
+    for ( const DrawBatch& batch : batches ) {
+        if ( batch_scissor( batch, tex_size ) ) glDrawArrays( GL_TRIANGLES, 0, 6 );
     }
+    glDisable( GL_SCISSOR_TEST );
 
-    glDisable( GL_BLEND );
     glDisable( GL_STENCIL_TEST );
-    
+
+    // Drawing every channel with its own depth test,
+    // nearest edge of the channel color wins
+
+    glUseProgram( msdf_straight_prog );
+    umsdf_straight.transform_matrix.setv( mscreen3 );
+    glUseProgram( msdf_prog );
+    umsdf.transform_matrix.setv( mscreen3 );
+    umsdf.tolerance.set( tolerance );
+    glDepthFunc( GL_LEQUAL );
+
+    for ( int ic = 0; ic < 3; ++ic ) {
+        const std::vector<SdfVertex>& vertices = *channel_vertices[ic];
+        const std::vector<SdfVertex>& straight_vertices = *channel_straight_vertices[ic];
+        if ( vertices.empty() && straight_vertices.empty() ) continue;
+
+        glColorMask( ic == 0, ic == 1, ic == 2, GL_FALSE );
+        clear_batches( GL_DEPTH_BUFFER_BIT, tex_size, batches );
+
+        glEnable( GL_DEPTH_TEST );
+
+        glUseProgram( msdf_straight_prog );
+        bindAttribs( vattribs, vattribs_count, (size_t) straight_vertices.data() );
+        draw_batches( tex_size, batches, [ic]( const DrawBatch& b ) { return std::make_pair( b.straight_start[ic], b.straight_end[ic] ); } );
+
+        glUseProgram( msdf_prog );
+        bindAttribs( vattribs, vattribs_count, (size_t) vertices.data() );
+        draw_batches( tex_size, batches, [ic]( const DrawBatch& b ) { return std::make_pair( b.line_start[ic], b.line_end[ic] ); } );
+
+        glDisable( GL_DEPTH_TEST );
+    }
+
+    glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+
     glUseProgram( 0 );
 }
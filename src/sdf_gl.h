@@ -37,18 +37,120 @@ struct SdfVertex {
 };
 
 
+// Atlas region of a row of glyph rects with its vertex ranges. Batches are drawn
+// with their own scissor rect, so clears and full-region passes only touch
+// the occupied parts of the atlas, and batches outside the target are skipped.
+struct DrawBatch {
+    int    x0 = 0, y0 = 0, x1 = 0, y1 = 0;     // Pixel bounds, x1 and y1 exclusive
+    size_t fill_start = 0, fill_end = 0;
+    size_t line_start[3] {}, line_end[3] {};   // One range per MSDF channel, SDF uses the first
+    size_t straight_start[3] {}, straight_end[3] {};
+};
+
+
+// Inside of the outline: nonzero winding number or odd winding number
+enum class FillRule {
+    NonZero,
+    EvenOdd
+};
+
+
 struct GlyphUnf {
     UNIFORM_MATRIX( 3, transform_matrix );
 };
 
 
+struct LineUnf {
+    UNIFORM_MATRIX( 3, transform_matrix );
+    UNIFORM( 1i, winding_tex );
+    UNIFORM( 2f, tex_size );
+    UNIFORM( 1f, even_odd );
+    UNIFORM( 1f, tolerance );
+};
+
+
+struct ResolveUnf {
+    UNIFORM_MATRIX( 3, transform_matrix );
+    UNIFORM( 1i, color_tex );
+    UNIFORM( 1i, samples );
+};
+
+
+struct MsdfUnf {
+    UNIFORM_MATRIX( 3, transform_matrix );
+    UNIFORM( 1f, tolerance );
+};
+
+
 struct SdfGl {
     
-    GLuint fill_prog = 0, line_prog = 0;
+    GLuint fill_prog = 0, winding_prog = 0, line_prog = 0, msdf_prog = 0;
+
+    // Straight segment variants of the distance shaders
+    GLuint line_straight_prog = 0, msdf_straight_prog = 0;
+
+    // Multisampled variants of the SDF distance shaders and the resolve pass, 0 without GL 4.0
+    GLuint line_ms_prog = 0, line_straight_ms_prog = 0, resolve_prog = 0;
+
+    GlyphUnf ufill, uwinding;
+
+    LineUnf  uline, uline_straight, uline_ms, uline_straight_ms;
+
+    ResolveUnf uresolve;
+
+    MsdfUnf  umsdf, umsdf_straight;
+
+    // Winding number target of the SDF fill pass, R16F texture of the atlas size,
+    // multisampled with more than one sample
+    GLuint winding_tex = 0, winding_fbo = 0;
+    int    winding_width = 0, winding_height = 0, winding_samples = 0;
+
+    // Multisampled distance target of the SDF mode, R32F color and depth
+    GLuint ms_color_tex = 0, ms_depth_rb = 0, ms_fbo = 0;
+    int    ms_width = 0, ms_height = 0, ms_samples = 0;
 
-    GlyphUnf ufill, uline;
+    // Samples per texel of the SDF passes. With more than one the winding numbers, signs and distances
+    // are evaluated per sample of multisampled targets and the texel gets their average, as a
+    // supersampled atlas scaled down with a box filter
+    int samples = 1;
+
+    FillRule fill_rule = FillRule::NonZero;
+
+    // Distance error the root solver iterates down to, in units of the SDF size
+    float tolerance = 1e-3f;
 
     void init();
 
-    void render_sdf( F2 tex_size, const std::vector<SdfVertex> &fill_vertices, const std::vector<SdfVertex> &line_vertices );
+    // MSDF fill: stencil state counting the winding of the fill triangles and the stencil mask of the inside
+    void fill_stencil();
+
+    GLuint fill_stencil_mask() const;
+
+    // Largest sample count of the multisampled SDF passes, 1 if they are not supported
+    int max_samples() const;
+
+    // Binds the winding framebuffer, (re)creating it for the atlas size and the sample count
+    bool winding_target( int width, int height );
+
+    // Binds the multisampled distance framebuffer, (re)creating it for the atlas size and the sample count
+    bool multisample_target( int width, int height );
+
+    // Signed distance field in two passes: winding numbers of the fill triangles are summed
+    // in the winding target, then line and interior quads write the signed distance once.
+    // Parabolic segments and straight ones (with the interior quads) are drawn with their own shader variants.
+    // With more than one sample both passes go to multisampled targets resolved into the atlas.
+    // Only the color buffer is expected to be cleared, depth and stencil are cleared per batch.
+    void render_sdf( F2 tex_size, const std::vector<SdfVertex> &fill_vertices, const std::vector<SdfVertex> &line_vertices,
+                     const std::vector<SdfVertex> &straight_vertices, const std::vector<DrawBatch> &batches );
+
+    // Multi-channel SDF, separate line vertices for R, G and B channels,
+    // parabolic segments and straight ones in separate vertex arrays
+    void render_msdf( F2 tex_size, const std::vector<SdfVertex> &fill_vertices,
+                      const std::vector<SdfVertex> &r_vertices,
+                      const std::vector<SdfVertex> &g_vertices,
+                      const std::vector<SdfVertex> &b_vertices,
+                      const std::vector<SdfVertex> &r_straight_vertices,
+                      const std::vector<SdfVertex> &g_straight_vertices,
+                      const std::vector<SdfVertex> &b_straight_vertices,
+                      const std::vector<DrawBatch> &batches );
 };
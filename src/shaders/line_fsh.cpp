@@ -20,7 +20,19 @@ static const char *line_fsh =  R"(  // "
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */    
-uniform float line_width;
+#ifdef MULTISAMPLE
+uniform sampler2DMS winding_tex;    // Winding numbers of the fill pass per sample
+#else
+uniform sampler2D winding_tex;  // Winding numbers of the fill pass
+#endif
+uniform vec2 tex_size;
+uniform float even_odd;         // 1.0 - even-odd fill rule, 0.0 - nonzero
+uniform float tolerance;        // Root solver tolerance in distance range units
+
+// Compiled in two variants: STRAIGHT_SEGMENT for segments from Parabola::from_line
+// and the interior quads, the general one for parabolic segments.
+// Both have MULTISAMPLE versions shaded per sample, with the sign of every sample
+#define MAX_ITER 8
     
 varying vec2 vpar;
 varying vec2 vlimits;
@@ -84,8 +96,10 @@ float solve_par_dist_old( vec2 pcoord ) {
 
 // Updated root finding algorithm that copes better with degenerate cases (straight lines)
 // From "The Low-Rank LDL^T Quartic Solver" by Peter Strobach, 2015
+// Iterates until the step along the parabola is below the tolerance, the step bounds
+// the remaining distance error as the iterations converge quadratically.
 
-float solve_par_dist( vec2 pcoord, int iter ) {
+float solve_par_dist( vec2 pcoord ) {
     float sigx = pcoord.x > 0.0 ? 1.0 : -1.0;  
     float px = abs( pcoord.x );
     float py = pcoord.y;
@@ -96,11 +110,14 @@ float solve_par_dist( vec2 pcoord, int iter ) {
                g > xr ? h / abs( g ) :
                xr;
 
-    for ( int i = 0; i < iter; ++i ) {
+    for ( int i = 0; i < MAX_ITER; ++i ) {
         float rcx0 = 1.0 / x0;
         float pb = h * rcx0 * rcx0;
         float pc = -px * rcx0 + g;
-        x0 = 2.0 * pc / ( -pb - sqrt( abs( pb*pb - 4.0*pc ) ) );
+        float x1 = 2.0 * pc / ( -pb - sqrt( abs( pb*pb - 4.0*pc ) ) );
+        float step = abs( x1 - x0 ) * sqrt( 1.0 + 4.0 * x1*x1 );
+        x0 = x1;
+        if ( step * dist_scale < tolerance ) break;
     }
 
     x0 = sigx * x0;
@@ -118,14 +135,61 @@ float solve_par_dist( vec2 pcoord, int iter ) {
 }
 
 
+// Lower bound of the distance to the parabola segment: distance to the bounding box
+// of the arc in parabola space. Costs a few instructions against the root solve,
+// rejects most of the fragments in the corners of the segment rect.
+
+float par_box_dist( vec2 pcoord, vec2 lim ) {
+    float ymin = lim.x > 0.0 ? lim.x*lim.x : lim.y < 0.0 ? lim.y*lim.y : 0.0;
+    float ymax = max( lim.x*lim.x, lim.y*lim.y );
+    vec2 d = max( max( vec2( lim.x, ymin ) - pcoord, pcoord - vec2( lim.y, ymax ) ), 0.0 );
+    return length( d );
+}
+
+
+#ifdef STRAIGHT_SEGMENT
+
+// Straight segment parabolas are flat within float precision, the nearest point is the projection
+
+float par_dist( vec2 pcoord ) {
+    float x = clamp( pcoord.x, vlimits.x, vlimits.y );
+    return length( vec2( x, x*x ) - pcoord );
+}
+
+#else
+
+float par_dist( vec2 pcoord ) {
+    if ( par_box_dist( pcoord, vlimits ) * dist_scale >= 1.0 ) discard;
+    return solve_par_dist( pcoord );
+}
+
+#endif
+
+
+// Writes the final signed distance: the sign comes from the winding number of the texel,
+// the distance goes to the depth buffer, so the depth test picks the nearest segment.
+// Interior quads have zero scale and write the inside value at the maximum distance,
+// they cover every inside texel beyond the line width, so far line fragments are dropped.
+
 void main() {
-    //float dist = solve_par_dist_old( vpar );
-    float dist = solve_par_dist( vpar, 3 );
-    float pdist = min( dist * dist_scale, 1.0 );
-    
-    float color = 0.5 - 0.5 * pdist;
+    float pdist = 1.0;
+    if ( dist_scale > 0.0 ) {
+        //float dist = solve_par_dist_old( vpar );
+        float dist = par_dist( vpar );
+        pdist = dist * dist_scale;
+        if ( pdist >= 1.0 ) discard;
+    }
+
+#ifdef MULTISAMPLE
+    float winding = abs( texelFetch( winding_tex, ivec2( gl_FragCoord.xy ), gl_SampleID ).r );
+#else
+    float winding = abs( texture2D( winding_tex, gl_FragCoord.xy / tex_size ).r );
+#endif
+    bool inside = even_odd > 0.5 ? mod( winding + 0.5, 2.0 ) > 1.0 : winding > 0.5;
+
+    if ( !inside && pdist >= 1.0 ) discard;
 
-    if ( color == 0.0 ) discard;
+    float color = inside ? 0.5 + 0.5 * pdist : 0.5 - 0.5 * pdist;
 
     gl_FragColor = vec4( color );
     gl_FragDepth = pdist;        
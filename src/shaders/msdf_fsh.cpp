@@ -0,0 +1,137 @@
+static const char *msdf_fsh =  R"(  // "
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */    
+    
+varying vec2 vpar;
+varying vec2 vlimits;    // Parabolic segment limits in contour travel order
+varying float dist_scale;
+
+uniform float tolerance;    // Root solver tolerance in distance range units
+
+// Compiled in STRAIGHT_SEGMENT and parabolic segment variants as line_fsh
+#define MAX_ITER 8
+
+
+// Nearest point on the parabola segment, same solver as in line_fsh
+
+#ifdef STRAIGHT_SEGMENT
+
+float solve_par_x( vec2 pcoord, vec2 lim ) {
+    return clamp( pcoord.x, lim.x, lim.y );
+}
+
+#else
+
+float solve_par_x( vec2 pcoord, vec2 lim ) {
+    float sigx = pcoord.x > 0.0 ? 1.0 : -1.0;  
+    float px = abs( pcoord.x );
+    float py = pcoord.y;
+    float h = 0.5 * px;
+    float g = 0.5 - py;
+    float xr = sqrt( 0.5 * px );
+    float x0 = g < -h ? sqrt( abs( g ) ) :
+               g > xr ? h / abs( g ) :
+               xr;
+
+    for ( int i = 0; i < MAX_ITER; ++i ) {
+        float rcx0 = 1.0 / x0;
+        float pb = h * rcx0 * rcx0;
+        float pc = -px * rcx0 + g;
+        float x1 = 2.0 * pc / ( -pb - sqrt( abs( pb*pb - 4.0*pc ) ) );
+        float step = abs( x1 - x0 ) * sqrt( 1.0 + 4.0 * x1*x1 );
+        x0 = x1;
+        if ( step * dist_scale < tolerance ) break;
+    }
+
+    x0 = sigx * x0;
+    float dx = sigx * sqrt( -0.75 * x0*x0 - g );
+    float x1 = -0.5 * x0 - dx;
+    
+    x0 = clamp( x0, lim.x, lim.y );        
+    x1 = clamp( x1, lim.x, lim.y );
+
+    float d0 = length( vec2( x0, x0*x0 ) - pcoord );
+    float d1 = length( vec2( x1, x1*x1 ) - pcoord );
+
+    return d0 < d1 ? x0 : x1;
+}
+
+#endif
+
+
+// Lower bound of the distance, same as in line_fsh
+
+float par_box_dist( vec2 pcoord, vec2 lim ) {
+    float ymin = lim.x > 0.0 ? lim.x*lim.x : lim.y < 0.0 ? lim.y*lim.y : 0.0;
+    float ymax = max( lim.x*lim.x, lim.y*lim.y );
+    vec2 d = max( max( vec2( lim.x, ymin ) - pcoord, pcoord - vec2( lim.y, ymax ) ), 0.0 );
+    return length( d );
+}
+
+
+// Writes signed pseudo-distance of the nearest segment into the color channel
+// selected with the color mask. True distance goes to the depth buffer, so the
+// depth test picks the nearest segment of the channel.
+
+void main() {
+    vec2  lim    = vec2( min( vlimits.x, vlimits.y ), max( vlimits.x, vlimits.y ) );
+    float travel = vlimits.y >= vlimits.x ? 1.0 : -1.0;
+
+#ifndef STRAIGHT_SEGMENT
+    if ( par_box_dist( vpar, lim ) * dist_scale >= 1.0 ) discard;
+#endif
+
+    float x    = solve_par_x( vpar, lim );
+    vec2  pt   = vec2( x, x*x );
+    vec2  dp   = vpar - pt;
+    float dist = length( dp );
+
+    float pdist = dist * dist_scale;
+    if ( pdist >= 1.0 ) discard;
+
+    vec2  tangent = travel * normalize( vec2( 1.0, 2.0 * x ) );
+    float side    = tangent.x * dp.y - tangent.y * dp.x;
+    float along   = dot( dp, tangent );
+
+    // Beyond the segment endpoints distance to the tangent line is used (pseudo-distance),
+    // it keeps the corners sharp when channels are combined with median
+    float pseudo = dist;
+    bool at_start = x == ( travel > 0.0 ? lim.x : lim.y );
+    bool at_end   = x == ( travel > 0.0 ? lim.y : lim.x );
+    if ( ( at_start && along < 0.0 ) || ( at_end && along > 0.0 ) ) {
+        pseudo = abs( side );
+    }
+
+    // Outer contours are clockwise, inside is on the right side of the segment
+    float sdist = side < 0.0 ? pseudo : -pseudo;
+    float color = 0.5 + 0.5 * clamp( sdist * dist_scale, -1.0, 1.0 );
+
+    // Segments sharing the nearest corner point are at the same true distance,
+    // prefering the one the point is most perpendicular to
+    float tie = dist > 0.0 ? abs( along ) / dist : 0.0;
+
+    gl_FragColor = vec4( color );
+    gl_FragDepth = min( pdist + 1e-3 * tie, 1.0 );
+}
+    
+
+)"; // "
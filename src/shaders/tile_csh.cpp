@@ -0,0 +1,209 @@
+static const char *tile_csh = R"( //"
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 430
+
+// Signed distance of the texels of one atlas tile per work group. The tile's list holds
+// the segments near enough to change its distances and the ones its texels' rays can cross
+// inside of the tile, crossings to the right of the tile come summed per row.
+
+#define TILE_SIZE 8
+
+#define SEGMENT_MASK 0x3fffffffu
+#define DIST_BIT     0x40000000u      // Segment can be closer than sdf_size to the tile
+#define WIND_BIT     0x80000000u      // Segment can cross rays from the tile texels in +x direction
+
+#define MAX_ITER 8
+
+layout( local_size_x = TILE_SIZE, local_size_y = TILE_SIZE ) in;
+
+struct Segment {
+    vec4 p01;       // End point p0, control point p1 (p0 for straight segments)
+    vec4 p2v;       // End point p2, parabola vertex
+    vec4 axes;      // Parabola x and y axes
+    vec4 par;       // Parabola scale, xstart, xend, 1.0 - parabolic segment, 0.0 - straight
+};
+
+layout( std430, binding = 0 ) readonly buffer Segments { Segment segments[]; };
+layout( std430, binding = 1 ) readonly buffer Tiles { uvec4 tiles[]; };     // Tile x, y, first and end entry
+layout( std430, binding = 2 ) readonly buffer Entries { uint entries[]; };  // Segment index and flags
+layout( std430, binding = 3 ) readonly buffer RowWindings { int row_windings[]; };
+layout( std430, binding = 4 ) writeonly buffer Image { float image[]; };
+
+uniform int   tex_width;
+uniform int   tex_height;
+uniform int   tile_count;
+uniform int   groups_x;
+uniform float sdf_size;
+uniform float tolerance;        // Root solver tolerance in sdf_size units
+uniform float even_odd;         // 1.0 - even-odd fill rule, 0.0 - nonzero
+
+
+// Nearest point on the parabola segment, same solver as in line_fsh
+
+float solve_par_dist( vec2 pcoord, vec2 lim, float dist_scale ) {
+    float sigx = pcoord.x > 0.0 ? 1.0 : -1.0;
+    float px = abs( pcoord.x );
+    float py = pcoord.y;
+    float h = 0.5 * px;
+    float g = 0.5 - py;
+    float xr = sqrt( 0.5 * px );
+    float x0 = g < -h ? sqrt( abs( g ) ) :
+               g > xr ? h / abs( g ) :
+               xr;
+
+    for ( int i = 0; i < MAX_ITER; ++i ) {
+        float rcx0 = 1.0 / x0;
+        float pb = h * rcx0 * rcx0;
+        float pc = -px * rcx0 + g;
+        float x1 = 2.0 * pc / ( -pb - sqrt( abs( pb*pb - 4.0*pc ) ) );
+        float step = abs( x1 - x0 ) * sqrt( 1.0 + 4.0 * x1*x1 );
+        x0 = x1;
+        if ( step * dist_scale < tolerance ) break;
+    }
+
+    x0 = sigx * x0;
+    float dx = sigx * sqrt( -0.75 * x0*x0 - g );
+    float x1 = -0.5 * x0 - dx;
+
+    x0 = clamp( x0, lim.x, lim.y );
+    x1 = clamp( x1, lim.x, lim.y );
+
+    float d0 = length( vec2( x0, x0*x0 ) - pcoord );
+    float d1 = length( vec2( x1, x1*x1 ) - pcoord );
+
+    return min( d0, d1 );
+}
+
+// Distance in pixels if the segment is closer than max_dist, max_dist otherwise.
+// The bounding box of the control points is checked before the root solve.
+
+float segment_dist( Segment s, vec2 p, float max_dist ) {
+    vec2 lo = min( min( s.p01.xy, s.p01.zw ), s.p2v.xy );
+    vec2 hi = max( max( s.p01.xy, s.p01.zw ), s.p2v.xy );
+    if ( length( max( max( lo - p, p - hi ), 0.0 ) ) >= max_dist ) return max_dist;
+
+    if ( s.par.w == 0.0 ) {
+        vec2 d = s.p2v.xy - s.p01.xy;
+        float len2 = dot( d, d );
+        float t = len2 > 0.0 ? clamp( dot( p - s.p01.xy, d ) / len2, 0.0, 1.0 ) : 0.0;
+        return min( max_dist, length( s.p01.xy + d * t - p ) );
+    }
+
+    float scale = s.par.x;
+    vec2  dp    = p - s.p2v.zw;
+    vec2  pcoord = vec2( dot( dp, s.axes.xy ), dot( dp, s.axes.zw ) ) / scale;
+    float dist = solve_par_dist( pcoord, s.par.yz, scale / sdf_size ) * scale;
+    return min( max_dist, dist );
+}
+
+
+// Winding numbers from crossings of the ray in +x direction, half-open in y
+// so that the points shared by neighbouring segments count once, as in SdfCpu
+
+int line_winding( vec2 a, vec2 b, vec2 p ) {
+    int dir = a.y <= p.y && p.y < b.y ? 1 :
+              b.y <= p.y && p.y < a.y ? -1 : 0;
+    if ( dir == 0 ) return 0;
+    float x = a.x + ( p.y - a.y ) / ( b.y - a.y ) * ( b.x - a.x );
+    return x > p.x ? dir : 0;
+}
+
+// Winding contribution of a y-monotonic part [t0, t1] of a quadratic curve
+
+int monotonic_winding( Segment s, float t0, float t1, vec2 p ) {
+    float a = s.p01.y - 2.0 * s.p01.w + s.p2v.y;
+    float b = 2.0 * ( s.p01.w - s.p01.y );
+    float c = s.p01.y;
+
+    float y0 = ( a * t0 + b ) * t0 + c;
+    float y1 = ( a * t1 + b ) * t1 + c;
+
+    int dir = y0 <= p.y && p.y < y1 ? 1 :
+              y1 <= p.y && p.y < y0 ? -1 : 0;
+    if ( dir == 0 ) return 0;
+
+    float t;
+    c -= p.y;
+    if ( a == 0.0 ) {
+        t = -c / b;
+    } else {
+        float d = sqrt( max( 0.0, b * b - 4.0 * a * c ) );
+        float q = -0.5 * ( b + ( b < 0.0 ? -d : d ) );
+        float r0 = q / a;
+        float r1 = q != 0.0 ? c / q : r0;
+        float tm = 0.5 * ( t0 + t1 );
+        t = abs( r0 - tm ) < abs( r1 - tm ) ? r0 : r1;
+    }
+    t = clamp( t, t0, t1 );
+
+    float mt = 1.0 - t;
+    float x = mt * mt * s.p01.x + 2.0 * mt * t * s.p01.z + t * t * s.p2v.x;
+    return x > p.x ? dir : 0;
+}
+
+int segment_winding( Segment s, vec2 p ) {
+    // Rays outside of the bounding box in y or to the right of it don't cross the segment
+    float ylo = min( min( s.p01.y, s.p01.w ), s.p2v.y );
+    float yhi = max( max( s.p01.y, s.p01.w ), s.p2v.y );
+    float xhi = max( max( s.p01.x, s.p01.z ), s.p2v.x );
+    if ( p.y < ylo || p.y > yhi || p.x >= xhi ) return 0;
+
+    if ( s.par.w == 0.0 ) return line_winding( s.p01.xy, s.p2v.xy, p );
+
+    // Splitting at the y extremum
+    float den = s.p01.y - 2.0 * s.p01.w + s.p2v.y;
+    float te  = den != 0.0 ? ( s.p01.y - s.p01.w ) / den : -1.0;
+    if ( te > 0.0 && te < 1.0 ) {
+        return monotonic_winding( s, 0.0, te, p ) + monotonic_winding( s, te, 1.0, p );
+    }
+    return monotonic_winding( s, 0.0, 1.0, p );
+}
+
+
+void main() {
+    int tile_id = int( gl_WorkGroupID.y ) * groups_x + int( gl_WorkGroupID.x );
+    if ( tile_id >= tile_count ) return;
+
+    uvec4 tile = tiles[ tile_id ];
+    ivec2 texel = ivec2( tile.xy ) * TILE_SIZE + ivec2( gl_LocalInvocationID.xy );
+    vec2  p = vec2( texel ) + 0.5;
+
+    float min_dist = sdf_size;
+    int   winding = row_windings[ tile_id * TILE_SIZE + int( gl_LocalInvocationID.y ) ];
+
+    for ( uint ie = tile.z; ie < tile.w; ++ie ) {
+        uint flags = entries[ ie ];
+        Segment s = segments[ flags & SEGMENT_MASK ];
+        if ( ( flags & WIND_BIT ) != 0u ) winding += segment_winding( s, p );
+        if ( ( flags & DIST_BIT ) != 0u ) min_dist = segment_dist( s, p, min_dist );
+    }
+
+    if ( texel.x >= tex_width || texel.y >= tex_height ) return;
+
+    bool  inside = even_odd > 0.5 ? ( winding & 1 ) != 0 : winding != 0;
+    float pdist  = min_dist / sdf_size;
+    image[ texel.y * tex_width + texel.x ] = inside ? 0.5 + 0.5 * pdist : 0.5 - 0.5 * pdist;
+}
+
+)"; // "
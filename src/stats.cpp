@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "stats.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment( lib, "psapi.lib" )
+#else
+#include <sys/resource.h>
+#endif
+
+
+Stats stats;
+
+static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+int64_t stats_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start_time ).count();
+}
+
+int64_t peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if ( !GetProcessMemoryInfo( GetCurrentProcess(), &pmc, sizeof( pmc ) ) ) return 0;
+    return pmc.PeakWorkingSetSize;
+#else
+    struct rusage ru;
+    if ( getrusage( RUSAGE_SELF, &ru ) != 0 ) return 0;
+#ifdef __APPLE__
+    return ru.ru_maxrss;                // bytes
+#else
+    return (int64_t) ru.ru_maxrss * 1024; // kilobytes
+#endif
+#endif
+}
+
+
+int Stats::begin( const char *name ) {
+    spans.push_back( Span { name, stats_time_us(), 0, depth++ } );
+    return spans.size() - 1;
+}
+
+void Stats::end( int span ) {
+    spans[ span ].duration_us = stats_time_us() - spans[ span ].start_us;
+    depth--;
+}
+
+void Stats::count( const char *name, int64_t value ) {
+    for ( Counter& c : counters ) {
+        if ( strcmp( c.name, name ) == 0 ) {
+            c.value += value;
+            return;
+        }
+    }
+    counters.push_back( Counter { name, value } );
+}
+
+void Stats::print_summary( std::ostream& os ) const {
+    int64_t total = stats_time_us();
+    char line[128];
+
+    os << "Stage                              ms       %\n";
+    for ( const Span& s : spans ) {
+        std::string name = std::string( s.depth * 2, ' ' ) + s.name;
+        snprintf( line, sizeof( line ), "%-28s %9.2f %7.1f\n", name.c_str(),
+                  s.duration_us * 1e-3, total > 0 ? 100.0 * s.duration_us / total : 0.0 );
+        os << line;
+    }
+    snprintf( line, sizeof( line ), "%-28s %9.2f\n", "total", total * 1e-3 );
+    os << line;
+
+    os << "Counter\n";
+    for ( const Counter& c : counters ) {
+        snprintf( line, sizeof( line ), "%-28s %12lld\n", c.name, (long long) c.value );
+        os << line;
+    }
+    snprintf( line, sizeof( line ), "%-28s %12.1f\n", "peak RSS, MB", peak_rss_bytes() / ( 1024.0 * 1024.0 ) );
+    os << line;
+}
+
+bool Stats::write_trace( const std::string& filename ) const {
+    FILE *f = fopen( filename.c_str(), "w" );
+    if ( !f ) return false;
+
+    fprintf( f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+    fprintf( f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"sdf_atlas\"}}" );
+
+    for ( const Span& s : spans ) {
+        fprintf( f, ",\n{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":1}",
+                 s.name, (long long) s.start_us, (long long) s.duration_us );
+    }
+
+    // Counters as of the end of the run
+    int64_t now = stats_time_us();
+    for ( const Counter& c : counters ) {
+        fprintf( f, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%lld,\"pid\":1,\"tid\":1,\"args\":{\"value\":%lld}}",
+                 c.name, (long long) now, (long long) c.value );
+    }
+    fprintf( f, ",\n{\"name\":\"peak RSS\",\"ph\":\"C\",\"ts\":%lld,\"pid\":1,\"tid\":1,\"args\":{\"bytes\":%lld}}",
+             (long long) now, (long long) peak_rss_bytes() );
+
+    fprintf( f, "\n]}\n" );
+    return fclose( f ) == 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Pipeline instrumentation: nested wall-clock stage timers and named counters.
+// Stages are timed around whole loops, so recording is always on, it's only
+// reported with --stats (summary) and --trace (Chrome trace-event JSON,
+// viewable in chrome://tracing or Perfetto).
+
+struct Stats {
+    struct Span {
+        const char *name;
+        int64_t     start_us;
+        int64_t     duration_us;
+        int         depth;
+    };
+
+    struct Counter {
+        const char *name;
+        int64_t     value;
+    };
+
+    std::vector<Span>    spans;
+    std::vector<Counter> counters;
+    int                  depth = 0;
+
+    int  begin( const char *name );
+    void end( int span );
+
+    // Adds value to the counter, creating it on first use
+    void count( const char *name, int64_t value );
+
+    void print_summary( std::ostream& os ) const;
+
+    bool write_trace( const std::string& filename ) const;
+};
+
+extern Stats stats;
+
+// Microseconds since program start
+int64_t stats_time_us();
+
+// Peak resident set size of the process in bytes, 0 if unknown
+int64_t peak_rss_bytes();
+
+
+struct StatsTimer {
+    int span;
+
+    explicit StatsTimer( const char *name ) : span( stats.begin( name ) ) {}
+    ~StatsTimer() { stats.end( span ); }
+
+    StatsTimer( const StatsTimer& ) = delete;
+    StatsTimer& operator=( const StatsTimer& ) = delete;
+};
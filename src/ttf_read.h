@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Convert high-endian TTF values to low-endian
+// TODO support for high-endian architectures
+
+inline uint16_t ttf_u16( const uint8_t *p ) { return p[0] * 256 + p[1]; }
+inline uint32_t ttf_u32( const uint8_t *p ) { return ( p[0] << 24 ) + ( p[1] << 16 ) + ( p[2] << 8 ) + p[3]; }
+
+inline int16_t ttf_i16( const uint8_t *p ) { return p[0] * 256 + p[1]; }
+inline int32_t ttf_i32( const uint8_t *p ) { return ( p[0] << 24 ) + ( p[1] << 16 ) + ( p[2] << 8 ) + p[3]; }
+
+
+// Range of font data. Parsers check the ranges they are about to read with has() and read
+// inside them with the unchecked functions above, so loops over validated arrays stay as fast
+// as before. The checked reads return 0 out of range, for single header and record fields.
+// A missing table is a span with no data, a table may also be present but empty.
+
+struct TtfSpan {
+    const uint8_t *data = nullptr;
+    size_t         size = 0;
+
+    TtfSpan() {}
+    TtfSpan( const uint8_t *data, size_t size ) : data( data ), size( data ? size : 0 ) {}
+
+    explicit operator bool() const { return data != nullptr; }
+
+    const uint8_t* end() const { return data + size; }
+
+    // [offset, offset + len) is inside the span
+    bool has( size_t offset, size_t len ) const { return offset <= size && len <= size - offset; }
+
+    // Subrange to the end of the span or of the given length, no data if out of range
+    TtfSpan sub( size_t offset ) const { return offset <= size ? TtfSpan( data + offset, size - offset ) : TtfSpan(); }
+    TtfSpan sub( size_t offset, size_t len ) const { return has( offset, len ) ? TtfSpan( data + offset, len ) : TtfSpan(); }
+
+    uint8_t  u8( size_t offset ) const  { return offset < size ? data[ offset ] : 0; }
+    uint16_t u16( size_t offset ) const { return has( offset, 2 ) ? ttf_u16( data + offset ) : 0; }
+    int16_t  i16( size_t offset ) const { return has( offset, 2 ) ? ttf_i16( data + offset ) : 0; }
+    uint32_t u32( size_t offset ) const { return has( offset, 4 ) ? ttf_u32( data + offset ) : 0; }
+    int32_t  i32( size_t offset ) const { return has( offset, 4 ) ? ttf_i32( data + offset ) : 0; }
+};
+
+
+inline bool check_tag( const uint8_t *d, const char *tag ) {
+    bool match = d[0] == tag[0] &&
+                 d[1] == tag[1] &&
+                 d[2] == tag[2] &&
+                 d[3] == tag[3];
+    return match;
+}
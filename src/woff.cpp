@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "woff.h"
+#include "ttf_read.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include <brotli/decode.h>
+#include <zlib.h>
+
+
+// Bounded big-endian reader for WOFF2 directories and glyph streams
+
+struct WoffStream {
+    const uint8_t *p   = nullptr;
+    const uint8_t *end = nullptr;
+    bool           ok  = true;
+
+    WoffStream() {}
+    WoffStream( const uint8_t *p, const uint8_t *end ) : p( p ), end( end ) {}
+
+    bool has( size_t n ) {
+        if ( (size_t) ( end - p ) >= n ) return true;
+        ok = false;
+        p = end;
+        return false;
+    }
+
+    uint8_t  u8()  { return has( 1 ) ? *p++ : 0; }
+    uint16_t u16() { if ( !has( 2 ) ) return 0; uint16_t v = ttf_u16( p ); p += 2; return v; }
+    uint32_t u32() { if ( !has( 4 ) ) return 0; uint32_t v = ttf_u32( p ); p += 4; return v; }
+    void     skip( size_t n ) { if ( has( n ) ) p += n; }
+
+    // 255UInt16 variable length encoding
+    uint16_t u255() {
+        uint8_t code = u8();
+        if ( code == 253 ) return u16();
+        if ( code == 254 ) return u8() + 506;
+        if ( code == 255 ) return u8() + 253;
+        return code;
+    }
+
+    // UIntBase128 variable length encoding
+    uint32_t base128() {
+        uint32_t v = 0;
+        for ( int i = 0; i < 5; ++i ) {
+            uint8_t b = u8();
+            if ( ( i == 0 && b == 0x80 ) || ( v & 0xfe000000 ) ) break;
+            v = ( v << 7 ) | ( b & 0x7f );
+            if ( !( b & 0x80 ) ) return v;
+        }
+        ok = false;
+        return 0;
+    }
+};
+
+
+// Assembling sfnt from the table data, a collection gets the "ttcf" header.
+// Offsets of the tables in sfnt are returned in offsets
+
+struct SfntTable {
+    uint32_t       tag    = 0;
+    const uint8_t *data   = nullptr;
+    uint32_t       length = 0;
+};
+
+struct SfntFace {
+    uint32_t         flavor = 0;
+    std::vector<int> tables;
+};
+
+static void put_u16( uint8_t *p, uint16_t v ) { p[0] = v >> 8; p[1] = v & 0xff; }
+static void put_u32( uint8_t *p, uint32_t v ) { put_u16( p, v >> 16 ); put_u16( p + 2, v & 0xffff ); }
+
+static void build_sfnt( const std::vector<SfntTable>& tables, const std::vector<SfntFace>& faces,
+                        bool is_collection, std::vector<uint8_t>& sfnt, std::vector<uint32_t>& offsets ) {
+    size_t header_size = is_collection ? 12 + 4 * faces.size() : 0;
+    size_t size = header_size;
+    for ( const SfntFace& face : faces ) size += 12 + 16 * face.tables.size();
+
+    offsets.resize( tables.size() );
+    for ( size_t itable = 0; itable < tables.size(); ++itable ) {
+        offsets[ itable ] = size;
+        size += ( tables[ itable ].length + 3 ) & ~3u;
+    }
+
+    sfnt.assign( size, 0 );
+    uint8_t *out = sfnt.data();
+
+    if ( is_collection ) {
+        memcpy( out, "ttcf", 4 );
+        put_u32( out + 4, 0x00010000 );
+        put_u32( out + 8, faces.size() );
+    }
+
+    size_t dir_offset = header_size;
+    for ( size_t iface = 0; iface < faces.size(); ++iface ) {
+        const SfntFace& face = faces[ iface ];
+        if ( is_collection ) put_u32( out + 12 + iface * 4, dir_offset );
+
+        uint8_t *dir = out + dir_offset;
+        uint16_t num_tables = face.tables.size();
+        uint16_t entry_selector = 0;
+        while ( ( 2u << entry_selector ) <= num_tables ) entry_selector++;
+        put_u32( dir, face.flavor );
+        put_u16( dir + 4, num_tables );
+        put_u16( dir + 6, 16 << entry_selector );
+        put_u16( dir + 8, entry_selector );
+        put_u16( dir + 10, num_tables * 16 - ( 16 << entry_selector ) );
+
+        for ( size_t i = 0; i < face.tables.size(); ++i ) {
+            int itable = face.tables[ i ];
+            uint8_t *entry = dir + 12 + i * 16;
+            put_u32( entry, tables[ itable ].tag );
+            put_u32( entry + 8, offsets[ itable ] );
+            put_u32( entry + 12, tables[ itable ].length );
+        }
+        dir_offset += 12 + 16 * face.tables.size();
+    }
+
+    for ( size_t itable = 0; itable < tables.size(); ++itable ) {
+        if ( tables[ itable ].length == 0 ) continue;
+        memcpy( out + offsets[ itable ], tables[ itable ].data, tables[ itable ].length );
+    }
+}
+
+
+// Unpacked table data size limit, a few header bytes could ask for gigabytes otherwise
+static const uint64_t woff_max_sfnt_size = 1 << 28;
+
+
+// WOFF: tables compressed with zlib one by one
+
+bool woff_decode( const uint8_t *woff, size_t size, FontFile& file ) {
+    if ( size < 44 ) return false;
+    uint32_t flavor     = ttf_u32( woff + 4 );
+    uint32_t length     = ttf_u32( woff + 8 );
+    uint16_t num_tables = ttf_u16( woff + 12 );
+    if ( length > size || 44u + num_tables * 20u > length ) return false;
+    uint64_t sfnt_size = 0;
+
+    std::vector<SfntTable> tables( num_tables );
+    std::vector<std::vector<uint8_t>> inflated( num_tables );
+    SfntFace face;
+    face.flavor = flavor;
+
+    for ( uint32_t itable = 0; itable < num_tables; ++itable ) {
+        const uint8_t *entry = woff + 44 + itable * 20;
+        uint32_t offset      = ttf_u32( entry + 4 );
+        uint32_t comp_length = ttf_u32( entry + 8 );
+        uint32_t orig_length = ttf_u32( entry + 12 );
+        if ( offset > length || comp_length > length - offset || comp_length > orig_length ) return false;
+        sfnt_size += orig_length;
+        if ( sfnt_size > woff_max_sfnt_size ) return false;
+
+        SfntTable& table = tables[ itable ];
+        table.tag    = ttf_u32( entry );
+        table.length = orig_length;
+
+        if ( comp_length == orig_length ) {
+            table.data = woff + offset;
+        } else {
+            std::vector<uint8_t>& buf = inflated[ itable ];
+            buf.resize( orig_length );
+            uLongf buf_size = orig_length;
+            if ( uncompress( buf.data(), &buf_size, woff + offset, comp_length ) != Z_OK || buf_size != orig_length ) {
+                return false;
+            }
+            table.data = buf.data();
+        }
+        face.tables.push_back( itable );
+    }
+
+    std::vector<uint32_t> offsets;
+    build_sfnt( tables, { face }, false, file.sfnt, offsets );
+    return true;
+}
+
+
+
+// WOFF2: whole table data compressed with Brotli, "glyf", "loca" and "hmtx" may be transformed
+
+static const char *woff2_known_tags[63] = {
+    "cmap", "head", "hhea", "hmtx", "maxp", "name", "OS/2", "post", "cvt ", "fpgm", "glyf", "loca", "prep",
+    "CFF ", "VORG", "EBDT", "EBLC", "gasp", "hdmx", "kern", "LTSH", "PCLT", "VDMX", "vhea", "vmtx", "BASE",
+    "GDEF", "GPOS", "GSUB", "EBSC", "JSTF", "MATH", "CBDT", "CBLC", "COLR", "CPAL", "SVG ", "sbix", "acnt",
+    "avar", "bdat", "bloc", "bsln", "cvar", "fdsc", "feat", "fmtx", "fvar", "gvar", "hsty", "just", "lcar",
+    "mort", "morx", "opbd", "prop", "trak", "Zapf", "Silf", "Glat", "Gloc", "Feat", "Sill"
+};
+
+struct Woff2Table {
+    uint32_t tag           = 0;
+    uint32_t orig_length   = 0;
+    uint32_t length        = 0;     // Length in the decompressed stream
+    uint32_t offset        = 0;
+    bool     is_transformed = false;
+};
+
+// Point delta coded by the flag and 1-4 bytes of the glyph stream
+static F2 woff2_triplet( uint8_t flag, WoffStream& gs ) {
+    auto with_sign = []( int flag, int value ) { return ( flag & 1 ) ? value : -value; };
+    int dx, dy;
+
+    if ( flag < 10 ) {
+        dx = 0;
+        dy = with_sign( flag, ( ( flag & 14 ) << 7 ) + gs.u8() );
+    } else if ( flag < 20 ) {
+        dx = with_sign( flag, ( ( ( flag - 10 ) & 14 ) << 7 ) + gs.u8() );
+        dy = 0;
+    } else if ( flag < 84 ) {
+        int b0 = flag - 20;
+        int b1 = gs.u8();
+        dx = with_sign( flag, 1 + ( b0 & 0x30 ) + ( b1 >> 4 ) );
+        dy = with_sign( flag >> 1, 1 + ( ( b0 & 0x0c ) << 2 ) + ( b1 & 0x0f ) );
+    } else if ( flag < 120 ) {
+        int b0 = flag - 84;
+        int b1 = gs.u8();
+        int b2 = gs.u8();
+        dx = with_sign( flag, 1 + ( ( b0 / 12 ) << 8 ) + b1 );
+        dy = with_sign( flag >> 1, 1 + ( ( ( b0 % 12 ) >> 2 ) << 8 ) + b2 );
+    } else if ( flag < 124 ) {
+        int b1 = gs.u8();
+        int b2 = gs.u8();
+        int b3 = gs.u8();
+        dx = with_sign( flag, ( b1 << 4 ) + ( b2 >> 4 ) );
+        dy = with_sign( flag >> 1, ( ( b2 & 0x0f ) << 8 ) + b3 );
+    } else {
+        int b1 = gs.u8();
+        int b2 = gs.u8();
+        int b3 = gs.u8();
+        int b4 = gs.u8();
+        dx = with_sign( flag, ( b1 << 8 ) + b2 );
+        dy = with_sign( flag >> 1, ( b3 << 8 ) + b4 );
+    }
+
+    return F2 { (float) dx, (float) dy };
+}
+
+// Transformed "glyf" table to display lists, the same as decoding the rebuilt "glyf".
+// Composite glyphs are expanded by the caller
+bool woff2_decode_glyf( const uint8_t *data, uint32_t size, const GlyphVariations *var, FontOutlines& fo ) {
+    WoffStream header( data, data + size );
+    header.u16();   // Reserved
+    header.u16();   // Option flags
+    uint16_t num_glyphs = header.u16();
+    header.u16();   // Index format of the rebuilt "loca"
+
+    // nContour, nPoints, flag, glyph, composite, bbox and instruction streams
+    WoffStream streams[7];
+    const uint8_t *pos = data + 36;
+    for ( int istream = 0; istream < 7; ++istream ) {
+        uint32_t stream_size = header.u32();
+        if ( !header.ok || stream_size > (uint32_t) ( data + size - pos ) ) return false;
+        streams[ istream ] = WoffStream( pos, pos + stream_size );
+        pos += stream_size;
+    }
+    WoffStream& contour_stream     = streams[0];
+    WoffStream& points_stream      = streams[1];
+    WoffStream& flag_stream        = streams[2];
+    WoffStream& glyph_stream       = streams[3];
+    WoffStream& composite_stream   = streams[4];
+    WoffStream& bbox_stream        = streams[5];
+    WoffStream& instruction_stream = streams[6];
+
+    const uint8_t *bbox_bitmap = bbox_stream.p;
+    bbox_stream.skip( ( ( num_glyphs + 31 ) >> 5 ) << 2 );
+    if ( !bbox_stream.ok ) return false;
+
+    fo.glyphs.assign( num_glyphs, Glyph{} );
+    if ( var ) fo.metric_deltas.assign( num_glyphs, F2{ 0.0f } );
+
+    std::vector<F2>       points;
+    std::vector<uint8_t>  on_curve;
+    std::vector<uint16_t> end_pts;
+
+    for ( uint32_t iglyph = 0; iglyph < num_glyphs; ++iglyph ) {
+        Glyph& glyph = fo.glyphs[ iglyph ];
+        int  num_contours = (int16_t) contour_stream.u16();
+        bool has_bbox = bbox_bitmap[ iglyph >> 3 ] & ( 0x80 >> ( iglyph & 7 ) );
+
+        if ( num_contours == 0 ) continue;
+
+        if ( has_bbox ) {
+            float minx = (int16_t) bbox_stream.u16();
+            float miny = (int16_t) bbox_stream.u16();
+            float maxx = (int16_t) bbox_stream.u16();
+            float maxy = (int16_t) bbox_stream.u16();
+            glyph.min = F2{ minx, miny };
+            glyph.max = F2{ maxx, maxy };
+        }
+
+        if ( num_contours > 0 ) {
+            // Simple glyph
+            end_pts.resize( num_contours );
+            uint32_t num_points = 0;
+            for ( int icontour = 0; icontour < num_contours; ++icontour ) {
+                num_points += points_stream.u255();
+                if ( num_points == 0 || num_points > 0xffff ) return false;
+                end_pts[ icontour ] = num_points - 1;
+            }
+
+            points.resize( num_points );
+            on_curve.resize( num_points );
+            F2 point { 0.0f };
+            for ( uint32_t ipoint = 0; ipoint < num_points; ++ipoint ) {
+                uint8_t flag = flag_stream.u8();
+                on_curve[ ipoint ] = !( flag >> 7 );
+                point += woff2_triplet( flag & 0x7f, glyph_stream );
+                points[ ipoint ] = point;
+            }
+            instruction_stream.skip( glyph_stream.u255() );
+
+            if ( !has_bbox ) {
+                glyph.min = glyph.max = points[0];
+                for ( const F2& p : points ) {
+                    glyph.min = min( glyph.min, p );
+                    glyph.max = max( glyph.max, p );
+                }
+            }
+            glyf_simple_glyph( fo, iglyph, points, on_curve, end_pts, var );
+        } else {
+            // Composite glyph, the records are the same as in "glyf", the bounding box is explicit
+            if ( !has_bbox ) return false;
+            bool has_instructions;
+            composite_stream.p = glyf_components( composite_stream.p, composite_stream.end, glyph, fo.components,
+                                                  &has_instructions );
+            if ( !composite_stream.p ) return false;
+            if ( has_instructions ) instruction_stream.skip( glyph_stream.u255() );
+            if ( var ) glyf_vary_components( fo, iglyph, *var );
+        }
+    }
+
+    for ( const WoffStream& stream : streams ) {
+        if ( !stream.ok ) return false;
+    }
+    return true;
+}
+
+// Transformed "hmtx" table, left side bearings may be left out when they equal glyph xMin
+static bool woff2_decode_hmtx( const uint8_t *data, uint32_t size, const FontOutlines& fo,
+                               uint16_t num_hmetrics, std::vector<uint8_t>& hmtx ) {
+    uint32_t num_glyphs = fo.glyphs.size();
+    if ( num_hmetrics > num_glyphs || num_hmetrics == 0 ) return false;
+
+    WoffStream ws( data, data + size );
+    uint8_t flags = ws.u8();
+
+    hmtx.assign( num_hmetrics * 4 + ( num_glyphs - num_hmetrics ) * 2, 0 );
+    for ( uint32_t iglyph = 0; iglyph < num_hmetrics; ++iglyph ) {
+        put_u16( hmtx.data() + iglyph * 4, ws.u16() );
+    }
+    for ( uint32_t iglyph = 0; iglyph < num_glyphs; ++iglyph ) {
+        bool proportional = iglyph < num_hmetrics;
+        bool explicit_lsb = proportional ? !( flags & 1 ) : !( flags & 2 );
+        int16_t lsb = explicit_lsb ? (int16_t) ws.u16() : (int16_t) fo.glyphs[ iglyph ].min.x;
+        uint8_t *dst = proportional ? hmtx.data() + iglyph * 4 + 2
+                                    : hmtx.data() + num_hmetrics * 4 + ( iglyph - num_hmetrics ) * 2;
+        put_u16( dst, (uint16_t) lsb );
+    }
+    return ws.ok;
+}
+
+bool woff2_decode( const uint8_t *woff2, size_t size, FontFile& file ) {
+    if ( size < 48 ) return false;
+    uint32_t length = ttf_u32( woff2 + 8 );
+    if ( length > size || length < 48 ) return false;
+
+    WoffStream ws( woff2 + 48, woff2 + length );
+    uint32_t flavor           = ttf_u32( woff2 + 4 );
+    uint16_t num_tables       = ttf_u16( woff2 + 12 );
+    uint32_t compressed_size  = ttf_u32( woff2 + 20 );
+
+    // Table directory
+    std::vector<Woff2Table> tables( num_tables );
+    uint64_t stream_size = 0;
+    for ( Woff2Table& table : tables ) {
+        uint8_t flags = ws.u8();
+        int     itag = flags & 63;
+        int     transform = flags >> 6;
+        table.tag = itag == 63 ? ws.u32() : ttf_u32( (const uint8_t*) woff2_known_tags[ itag ] );
+        table.orig_length = ws.base128();
+
+        // glyf and loca transform version 0 is the glyph stream transform, 3 is none
+        uint8_t tag[4];
+        put_u32( tag, table.tag );
+        bool is_glyf_loca = check_tag( tag, "glyf" ) || check_tag( tag, "loca" );
+        table.is_transformed = is_glyf_loca ? transform == 0 : transform != 0;
+
+        table.length = table.is_transformed ? ws.base128() : table.orig_length;
+        table.offset = stream_size;
+        stream_size += table.length;
+    }
+
+    // Collection directory, a single font uses all tables
+    std::vector<SfntFace> faces;
+    bool is_collection = flavor == ttf_u32( (const uint8_t*) "ttcf" );
+    if ( is_collection ) {
+        ws.u32();   // Version
+        uint16_t num_fonts = ws.u255();
+        faces.resize( num_fonts );
+        for ( SfntFace& face : faces ) {
+            uint16_t face_tables = ws.u255();
+            face.flavor = ws.u32();
+            for ( uint32_t i = 0; i < face_tables && ws.ok; ++i ) {
+                uint16_t itable = ws.u255();
+                if ( itable >= num_tables ) return false;
+                face.tables.push_back( itable );
+            }
+        }
+    } else {
+        faces.resize( 1 );
+        faces[0].flavor = flavor;
+        for ( int itable = 0; itable < num_tables; ++itable ) faces[0].tables.push_back( itable );
+    }
+
+    if ( !ws.ok || compressed_size > (uint32_t) ( ws.end - ws.p ) || stream_size > woff_max_sfnt_size ) return false;
+
+    // Decompressing table data
+    std::vector<uint8_t> table_data( stream_size );
+    size_t decoded_size = stream_size;
+    BrotliDecoderResult res = BrotliDecoderDecompress( compressed_size, ws.p, &decoded_size, table_data.data() );
+    if ( res != BROTLI_DECODER_RESULT_SUCCESS || decoded_size != stream_size ) return false;
+
+    std::vector<SfntTable> sfnt_tables( num_tables );
+    for ( int itable = 0; itable < num_tables; ++itable ) {
+        sfnt_tables[ itable ].tag    = tables[ itable ].tag;
+        sfnt_tables[ itable ].data   = table_data.data() + tables[ itable ].offset;
+        sfnt_tables[ itable ].length = tables[ itable ].length;
+    }
+
+    // Transformed "glyf" tables are kept for the outline decoder, the empty "loca" is left out.
+    // Transformed "hmtx" needs the glyph bounding boxes, the decoded outlines are kept too.
+    std::map<int, FontOutlines>          glyf_outlines;
+    std::map<std::pair<int, int>, int>   hmtx_tables;   // ( hmtx, glyf ) -> rebuilt hmtx table
+    std::vector<std::vector<uint8_t>>    rebuilt( num_tables );
+
+    for ( SfntFace& face : faces ) {
+        int iglyf = -1, ihmtx = -1, ihhea = -1;
+        for ( int itable : face.tables ) {
+            uint8_t tag[4];
+            put_u32( tag, tables[ itable ].tag );
+            if ( check_tag( tag, "glyf" ) ) iglyf = itable;
+            if ( check_tag( tag, "hmtx" ) ) ihmtx = itable;
+            if ( check_tag( tag, "hhea" ) ) ihhea = itable;
+        }
+        bool glyf_transformed = iglyf >= 0 && tables[ iglyf ].is_transformed;
+        bool hmtx_transformed = ihmtx >= 0 && tables[ ihmtx ].is_transformed;
+        if ( hmtx_transformed && !glyf_transformed ) return false;
+
+        if ( glyf_transformed ) {
+            face.tables.erase( std::remove_if( face.tables.begin(), face.tables.end(), [&]( int itable ) {
+                uint8_t tag[4];
+                put_u32( tag, tables[ itable ].tag );
+                return check_tag( tag, "loca" );
+            } ), face.tables.end() );
+        }
+
+        // hmtx left side bearings derived from the decoded glyph bounding boxes
+        if ( hmtx_transformed ) {
+            if ( ihhea < 0 || tables[ ihhea ].length < 36 ) return false;
+
+            auto decoded = glyf_outlines.find( iglyf );
+            if ( decoded == glyf_outlines.end() ) {
+                FontOutlines fo;
+                if ( !woff2_decode_glyf( sfnt_tables[ iglyf ].data, tables[ iglyf ].length, nullptr, fo ) ) return false;
+                decoded = glyf_outlines.emplace( iglyf, std::move( fo ) ).first;
+            }
+
+            auto key = std::make_pair( ihmtx, iglyf );
+            auto hmtx = hmtx_tables.find( key );
+            if ( hmtx == hmtx_tables.end() ) {
+                int irebuilt = sfnt_tables.size();
+                rebuilt.emplace_back();
+                uint16_t num_hmetrics = ttf_u16( sfnt_tables[ ihhea ].data + 34 );
+                if ( !woff2_decode_hmtx( sfnt_tables[ ihmtx ].data, tables[ ihmtx ].length, decoded->second,
+                                         num_hmetrics, rebuilt.back() ) ) {
+                    return false;
+                }
+                SfntTable st;
+                st.tag    = tables[ ihmtx ].tag;
+                st.data   = rebuilt.back().data();
+                st.length = rebuilt.back().size();
+                sfnt_tables.push_back( st );
+                hmtx = hmtx_tables.emplace( key, irebuilt ).first;
+            }
+            std::replace( face.tables.begin(), face.tables.end(), ihmtx, hmtx->second );
+        }
+    }
+
+    std::vector<uint32_t> offsets;
+    build_sfnt( sfnt_tables, faces, is_collection, file.sfnt, offsets );
+
+    for ( int itable = 0; itable < num_tables; ++itable ) {
+        uint8_t tag[4];
+        put_u32( tag, tables[ itable ].tag );
+        if ( !check_tag( tag, "glyf" ) || !tables[ itable ].is_transformed ) continue;
+        file.woff2_glyf[ offsets[ itable ] ] = tables[ itable ].length;
+
+        // Outlines decoded for "hmtx" are the default instance ones
+        auto decoded = glyf_outlines.find( itable );
+        if ( decoded != glyf_outlines.end() ) {
+            glyf_expand_composites( decoded->second );
+            index_contours( decoded->second );
+            FontFile::OutlinesKey key = std::make_tuple( offsets[ itable ], 0u, (uint32_t) decoded->second.glyphs.size(),
+                                                         0.0f, std::vector<float>() );
+            file.outlines[ key ] = std::move( decoded->second );
+        }
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2019 Anton Stiopin astiopin@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "font.h"
+
+// WOFF and WOFF2 web font containers. Both are unpacked to sfnt in file.sfnt,
+// size is the input size, the length in the header has to fit in it.
+// WOFF2 transformed "glyf" tables are kept in sfnt and listed in file.woff2_glyf,
+// the outline decoder reads them with woff2_decode_glyf.
+
+bool woff_decode( const uint8_t *woff, size_t size, FontFile& file );
+
+bool woff2_decode( const uint8_t *woff2, size_t size, FontFile& file );
+
+// Display lists and components of a WOFF2 transformed "glyf" table, composites are not expanded.
+// var is nullptr for the default instance
+bool woff2_decode_glyf( const uint8_t *data, uint32_t size, const GlyphVariations *var, FontOutlines& fo );